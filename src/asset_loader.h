@@ -0,0 +1,132 @@
+#ifndef ASSET_LOADER_H
+#define ASSET_LOADER_H
+#include <SDL2/SDL.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <sstream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include "texel_store.h"
+
+//startup images are loaded in two halves. decodeAssetImage reads the BMP, converts it to RGBA32 and fills the cpu
+//texel copies and mips. it only touches its own Asset_Image, so any number of them can run on worker threads.
+//createAssetTexture then makes the SDL_Texture, which has to happen on the thread that owns the renderer
+struct Asset_Image{
+    std::string path; //full path. resolve it before any worker starts, getProjectPath isn't thread safe
+    bool texture = true; //make an SDL_Texture from it
+    bool colorKey = false; //key becomes transparent, in the texture and the texels
+    SDL_Color key = {0,0,0,0};
+    Texel_Image *texels = NULL; //cpu copy to fill, if wanted
+    int layout = TEXELS_ROWS;
+    Texel_Mips *mips = NULL; //mip chain to build from the cpu copy, if wanted
+    SDL_Surface *surface = NULL; //RGBA32, kept from decoding until the texture is made
+    bool decoded = false;
+};
+
+//what init hands the workers: every startup image, and the first level as one more job. done counts finished
+//jobs for the splash's progress bar
+struct Startup_Load{
+    std::vector<Asset_Image> images;
+    SDL_atomic_t done;
+};
+
+bool decodeAssetImage(Asset_Image &image)
+{
+    SDL_Surface *bmp = SDL_LoadBMP(image.path.c_str());
+    if (bmp == NULL)
+    {
+        printf("SDL_LoadBMP Error: %s\n", SDL_GetError());
+        return false;
+    }
+    image.surface = SDL_ConvertSurfaceFormat(bmp, SDL_PIXELFORMAT_RGBA32, 0);
+    SDL_FreeSurface(bmp);
+    if (image.surface == NULL)
+    {
+        printf("SDL_ConvertSurfaceFormat Error: %s\n", SDL_GetError());
+        return false;
+    }
+    Uint32 key = SDL_MapRGB(image.surface->format, image.key.r, image.key.g, image.key.b);
+    if(image.colorKey)
+        SDL_SetColorKey(image.surface, SDL_TRUE, key);
+    Texel_Image scratch; //mips without a kept copy
+    Texel_Image &texels = image.texels != NULL ? *image.texels : scratch;
+    if(image.texels != NULL || image.mips != NULL)
+        storeTexels(texels, image.surface, image.layout, image.colorKey, key);
+    if(image.mips != NULL)
+        buildMips(*image.mips, texels);
+    if(!image.texture)
+    {
+        SDL_FreeSurface(image.surface);
+        image.surface = NULL;
+    }
+    image.decoded = true;
+    return true;
+}
+
+//renderer thread only. frees the surface, NULL if there was none or the texture couldn't be made
+SDL_Texture *createAssetTexture(SDL_Renderer *renderer, Asset_Image &image)
+{
+    if(image.surface == NULL)
+        return NULL;
+    SDL_Texture *tex = NULL;
+    if(image.colorKey)
+        tex = SDL_CreateTextureFromSurface(renderer, image.surface);
+    else
+    {
+        //streaming so the pixels can be changed later, like the floor and wall textures
+        tex = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA32, SDL_TEXTUREACCESS_STREAMING, image.surface->w, image.surface->h);
+        if(tex != NULL)
+            SDL_UpdateTexture(tex, NULL, image.surface->pixels, image.surface->pitch);
+    }
+    if (tex == NULL)
+        printf("SDL_CreateTexture Error: %s\n", SDL_GetError());
+    SDL_FreeSurface(image.surface);
+    image.surface = NULL;
+    return tex;
+}
+
+//an XPM compiled into the program, like loading_splash.xpm. colors are "c #rrggbb" or "c None" for transparent
+SDL_Surface *surfaceFromXPM(const char *const *xpm)
+{
+    int w = 0, h = 0, colors = 0, chars = 0;
+    if(sscanf(xpm[0], "%d %d %d %d", &w, &h, &colors, &chars) != 4 || w <= 0 || h <= 0 || chars <= 0)
+        return NULL;
+    SDL_Surface *surface = SDL_CreateRGBSurfaceWithFormat(0, w, h, 32, SDL_PIXELFORMAT_RGBA32);
+    if(surface == NULL)
+        return NULL;
+    std::map<std::string, Uint32> palette;
+    for(int i = 1; i <= colors; i++)
+    {
+        std::string line = xpm[i];
+        std::istringstream values(line.substr(std::min(line.size(), (std::size_t)chars)));
+        std::string kind, value;
+        Uint32 color = SDL_MapRGBA(surface->format, 0, 0, 0, 0xff);
+        while(values >> kind >> value)
+        {
+            if(kind != "c")
+                continue;
+            if(value == "None")
+                color = SDL_MapRGBA(surface->format, 0, 0, 0, 0);
+            else if(value.size() == 7 && value[0] == '#')
+            {
+                unsigned long rgb = strtoul(value.c_str() + 1, NULL, 16);
+                color = SDL_MapRGBA(surface->format, (rgb >> 16) & 0xff, (rgb >> 8) & 0xff, rgb & 0xff, 0xff);
+            }
+            break;
+        }
+        palette[line.substr(0, chars)] = color;
+    }
+    SDL_LockSurface(surface);
+    for(int y = 0; y < h; y++)
+    {
+        const char *row = xpm[1 + colors + y];
+        Uint32 *pixels = (Uint32 *)((Uint8 *)surface->pixels + y * surface->pitch);
+        for(int x = 0; x < w; x++)
+            pixels[x] = palette[std::string(row + x * chars, chars)];
+    }
+    SDL_UnlockSurface(surface);
+    return surface;
+}
+#endif
@@ -0,0 +1,87 @@
+#ifndef AUX_BUFFERS_H
+#define AUX_BUFFERS_H
+#include <SDL2/SDL.h>
+#include <vector>
+#include <limits>
+#include <algorithm>
+#include "blocktypes.h"
+#include "texel_store.h"
+
+//extra per frame outputs for tools and agents, filled by the normal render passes as they go rather than by a
+//second render. all off unless asked for. the buffers can be smaller than the frame: aux pixel (x,y) holds
+//whatever frame pixel (x*scale, y*scale) shows
+enum AUX_CHANNEL{
+    AUX_COLUMN_DEPTH = 1, //one wall distance per column, straight from the raycast
+    AUX_DEPTH = 2, //distance to the wall, floor or ceiling under each pixel. sky is infinite
+    AUX_SURFACE = 4, //block id and face under each pixel, see auxSurface
+    AUX_SPRITE = 8 //index + 1 of the nearest sprite covering each pixel, 0 for none
+};
+
+//faces after the four wall directions in WALL_DIR
+enum AUX_FACE{
+    AUX_FACE_FLOOR = WEST + 1,
+    AUX_FACE_CEILING,
+    AUX_FACE_SKY
+};
+
+const float auxSkyDepth = std::numeric_limits<float>::infinity();
+
+struct Aux_Buffers{
+    int channels = 0; //AUX_CHANNEL bits
+    int scale = 1;
+    int width = 0;
+    int height = 0; //aux resolution, frame size divided by scale and rounded up
+    std::vector<float> columnDepth; //width entries
+    std::vector<float> depth; //width * height, distances are perpendicular to the camera plane like wallDist
+    std::vector<Uint32> surface;
+    std::vector<Uint32> sprite;
+};
+
+//block id in the high bits, face in the low byte
+inline Uint32 auxSurface(int blockID, int face)
+{
+    return ((Uint32)blockID << 8) | (Uint32)face;
+}
+
+void initAuxBuffers(Aux_Buffers &aux, int channels, int scale, int frameWidth, int frameHeight)
+{
+    aux.channels = channels;
+    aux.scale = std::max(1, scale);
+    aux.width = (frameWidth + aux.scale - 1) / aux.scale;
+    aux.height = (frameHeight + aux.scale - 1) / aux.scale;
+    std::size_t pixels = (std::size_t)aux.width * aux.height;
+    aux.columnDepth.assign((channels & AUX_COLUMN_DEPTH) ? aux.width : 0, 0.0f);
+    aux.depth.assign((channels & AUX_DEPTH) ? pixels : 0, auxSkyDepth);
+    aux.surface.assign((channels & AUX_SURFACE) ? pixels : 0, auxSurface(0, AUX_FACE_SKY));
+    aux.sprite.assign((channels & AUX_SPRITE) ? pixels : 0, 0);
+}
+
+//first aux row or column at or after frame coordinate n
+inline int auxCeil(const Aux_Buffers &aux, int n)
+{
+    return (n + aux.scale - 1) / aux.scale;
+}
+
+//mark a sprite's opaque pixels in the sprite channel. dest is where the whole image lands on screen and columns
+//where a wall is closer than depth are skipped, the same test the sprite draw uses. draw far to near so near sprites win
+void auxMarkSprite(Aux_Buffers &aux, const Texel_Image &atlas, SDL_Rect image, SDL_Rect dest, double depth, const std::vector<double> &wallDist, int frameWidth, int frameHeight, Uint32 id)
+{
+    if(aux.sprite.empty() || dest.w <= 0 || dest.h <= 0)
+        return;
+    int xEnd = std::min(frameWidth, dest.x + dest.w);
+    int yEnd = std::min(frameHeight, dest.y + dest.h);
+    for(int ax = auxCeil(aux, std::max(0, dest.x)); ax * aux.scale < xEnd; ax++)
+    {
+        int x = ax * aux.scale;
+        if(depth >= wallDist[x])
+            continue;
+        int texX = image.x + (x - dest.x) * image.w / dest.w;
+        for(int ay = auxCeil(aux, std::max(0, dest.y)); ay * aux.scale < yEnd; ay++)
+        {
+            int texY = image.y + (ay * aux.scale - dest.y) * image.h / dest.h;
+            if(texelAt(atlas, texX, texY) & texelAlphaMask)
+                aux.sprite[ay * aux.width + ax] = id;
+        }
+    }
+}
+#endif
@@ -1,4 +1,5 @@
 #ifndef BLOCKTYPES_H
+#define BLOCKTYPES_H
 #include <vector>
 
 const int totalBlocks = 64;
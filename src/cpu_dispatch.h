@@ -0,0 +1,83 @@
+#ifndef CPU_DISPATCH_H
+#define CPU_DISPATCH_H
+#include <SDL2/SDL.h>
+#include <string>
+
+//one binary for every x86 machine. pixel kernels whose loops vectorize are written once as inline bodies and
+//compiled again for each instruction set below, then main picks the best copy the cpu has at startup (or the one
+//--isa asks for). only generatefogMask is one so far: the floor, walls and ray casting are texel gathers and
+//branchy walks that timed the same in every copy, so they're built once like the rest of the engine.
+//the copies vectorize their loops for their own registers but never fuse a multiply and add, so every copy
+//draws exactly the same pixels as the baseline one. they ignore floating point exception flags, which nothing
+//reads, so comparisons can become vector min, max and blends
+enum CPU_LEVEL{
+    CPU_BASELINE, //whatever the build targets, SSE2 on x86-64
+    CPU_SSE42,
+    CPU_AVX2,
+    CPU_AVX512,
+    CPU_LEVEL_COUNT
+};
+
+//target attributes are gcc and clang only, other compilers just get the baseline copy
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define ISA_DISPATCH 1
+#define ISA_KERNEL inline __attribute__((always_inline))
+#if defined(__clang__)
+#define ISA_OPTIMIZE //clang has no optimize attribute. it vectorizes at -O2 anyway, build with -ffp-contract=off to keep the avx512 copy exact
+#else
+#define ISA_OPTIMIZE , optimize("fp-contract=off", "no-trapping-math", "tree-vectorize", "vect-cost-model=dynamic")
+#endif
+#define ISA_TARGET_SSE42 __attribute__((target("sse4.2,popcnt") ISA_OPTIMIZE))
+#define ISA_TARGET_AVX2 __attribute__((target("avx2,popcnt") ISA_OPTIMIZE))
+#define ISA_TARGET_AVX512 __attribute__((target("avx512f,avx2,popcnt") ISA_OPTIMIZE))
+#else
+#define ISA_DISPATCH 0
+#define ISA_KERNEL inline
+#endif
+
+//name##Kernel is the body. this defines name##Baseline, name##Sse42, name##Avx2 and name##Avx512 around it,
+//and name##Isa, the pointer to the copy in use. it starts out at the baseline copy
+#if ISA_DISPATCH
+#define ISA_VARIANTS(name, params, args) \
+    void name##Baseline params { name##Kernel args; } \
+    void (*name##Isa) params = name##Baseline; \
+    ISA_TARGET_SSE42 void name##Sse42 params { name##Kernel args; } \
+    ISA_TARGET_AVX2 void name##Avx2 params { name##Kernel args; } \
+    ISA_TARGET_AVX512 void name##Avx512 params { name##Kernel args; }
+#define ISA_PICK(name, level) ((level) == CPU_AVX512 ? name##Avx512 : (level) == CPU_AVX2 ? name##Avx2 : (level) == CPU_SSE42 ? name##Sse42 : name##Baseline)
+#else
+#define ISA_VARIANTS(name, params, args) \
+    void name##Baseline params { name##Kernel args; } \
+    void (*name##Isa) params = name##Baseline;
+#define ISA_PICK(name, level) name##Baseline
+#endif
+
+inline const char *cpuLevelName(int level)
+{
+    const char *names[CPU_LEVEL_COUNT] = {"baseline", "sse4.2", "avx2", "avx512"};
+    return level >= 0 && level < CPU_LEVEL_COUNT ? names[level] : "unknown";
+}
+
+//-1 for names that aren't a level
+inline int cpuLevelFromName(const std::string &name)
+{
+    for(int level = 0; level < CPU_LEVEL_COUNT; level++)
+        if(name == cpuLevelName(level))
+            return level;
+    return -1;
+}
+
+//best level both this build and the cpu support. SDL checks the os saves the wide registers too
+inline int detectCpuLevel()
+{
+#if ISA_DISPATCH
+    if(SDL_HasAVX512F() && SDL_HasAVX2())
+        return CPU_AVX512;
+    if(SDL_HasAVX2())
+        return CPU_AVX2;
+    if(SDL_HasSSE42())
+        return CPU_SSE42;
+#endif
+    return CPU_BASELINE;
+}
+#endif
@@ -0,0 +1,264 @@
+#ifndef FLOW_FIELD_H
+#define FLOW_FIELD_H
+#include <SDL2/SDL.h>
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include "blocktypes.h"
+#include "game_sprites.h"
+#include "memory_stats.h"
+
+//crowds of sprites chasing one target through the level. instead of every chaser finding its own path, one
+//breadth first search out from the target's cell gives every reachable cell the step that leads toward it,
+//and each chaser just reads the step for the cell it stands in. the cost of a chaser is one lookup and one move.
+//solid blocks, closed doors included, are walls to the search
+
+const int flowNoStep = 8; //at the target, or not reachable from it
+const int flowStepX[8] = {1, -1, 0, 0, 1, -1, 1, -1}; //4 straight steps first so they win ties against diagonals
+const int flowStepY[8] = {0, 0, 1, -1, 1, 1, -1, -1};
+const int flowBuildBudget = 1 << 16; //cells a build gets through per tick. big maps take a few ticks, the old field is used until then
+
+struct Flow_Field{
+    int width = 0;
+    int height = 0;
+    int targetCell = -1; //cell the finished field leads to
+    int wantedCell = -1; //cell the next build should lead to
+    bool stale = false; //level changed or the target moved since the last build started
+    std::vector<Uint8> next; //step toward the target for each cell. only cells with nextStamp == generation are valid
+    std::vector<Uint32> nextStamp;
+    Uint32 generation = 0;
+
+    //build in progress. fills the build arrays and swaps them with the finished ones at the end
+    bool building = false;
+    Uint32 buildGeneration = 0;
+    std::vector<Uint8> buildNext;
+    std::vector<Uint32> buildStamp; //buildGeneration marks cells reached by this build
+    std::vector<Uint32> dist; //steps from the target, valid where buildStamp is current
+    std::vector<int> queue; //every reached cell in search order
+    std::size_t searchHead = 0;
+    std::size_t stepHead = 0; //cells given their step so far, once the search is done
+    int buildCell = -1;
+};
+
+//structure of arrays so the update is one tight loop over plain numbers. sprite is the index of the
+//Game_Sprite each chaser drives
+struct Chaser_Crowd{
+    std::vector<float> x;
+    std::vector<float> y;
+    std::vector<float> speed; //cells per second
+    std::vector<int> sprite;
+};
+
+const float chaserReach = 0.6f; //chasers stop this close to the target
+const float chaserSpeed = 1.5f;
+
+//everything a field has allocated, the arrays of a build in progress included
+Uint64 flowFieldBytes(const Flow_Field &field)
+{
+    return vectorBytes(field.next) + vectorBytes(field.nextStamp) + vectorBytes(field.buildNext) + vectorBytes(field.buildStamp)
+           + vectorBytes(field.dist) + vectorBytes(field.queue);
+}
+
+Uint64 chaserBytes(const Chaser_Crowd &crowd)
+{
+    return vectorBytes(crowd.x) + vectorBytes(crowd.y) + vectorBytes(crowd.speed) + vectorBytes(crowd.sprite);
+}
+
+void resetFlowField(Flow_Field &field, int width, int height)
+{
+    field.width = width;
+    field.height = height;
+    field.targetCell = -1;
+    field.wantedCell = -1;
+    field.stale = false;
+    field.building = false;
+    std::size_t cells = (std::size_t)width * height;
+    field.next.assign(cells, flowNoStep);
+    field.buildNext.assign(cells, flowNoStep);
+    field.nextStamp.assign(cells, 0);
+    field.buildStamp.assign(cells, 0);
+    field.dist.assign(cells, 0);
+    field.generation = 0;
+    field.buildGeneration = 0;
+    field.queue.clear();
+}
+
+inline bool flowPassable(const std::vector<std::vector<Map_Block>> &level, int x, int y)
+{
+    return !level[x][y].solid;
+}
+
+void startFlowBuild(Flow_Field &field, int targetCell)
+{
+    field.building = true;
+    field.buildCell = targetCell;
+    field.buildGeneration = std::max(field.generation, field.buildGeneration) + 1;
+    field.queue.clear();
+    field.queue.push_back(targetCell);
+    field.buildStamp[targetCell] = field.buildGeneration;
+    field.dist[targetCell] = 0;
+    field.buildNext[targetCell] = flowNoStep;
+    field.searchHead = 0;
+    field.stepHead = 1; //the target has no step
+}
+
+//carry on the build for up to budget cells. true once it's finished and swapped in
+bool continueFlowBuild(Flow_Field &field, const std::vector<std::vector<Map_Block>> &level, int budget)
+{
+    const int width = field.width, height = field.height;
+    const Uint32 generation = field.buildGeneration;
+    while(budget > 0 && field.searchHead < field.queue.size())
+    {
+        int cell = field.queue[field.searchHead++];
+        int x = cell % width, y = cell / width;
+        for(int d = 0; d < 4; d++)
+        {
+            int nx = x + flowStepX[d], ny = y + flowStepY[d];
+            if(nx < 0 || ny < 0 || nx >= width || ny >= height)
+                continue;
+            int neighbor = nx + ny * width;
+            if(field.buildStamp[neighbor] == generation || !flowPassable(level, nx, ny))
+                continue;
+            field.buildStamp[neighbor] = generation;
+            field.dist[neighbor] = field.dist[cell] + 1;
+            field.queue.push_back(neighbor);
+        }
+        budget--;
+    }
+    //distances are done, point every cell at its nearest neighbor. diagonals only where both straight
+    //cells beside them are open so nothing cuts a wall corner
+    while(budget > 0 && field.searchHead == field.queue.size() && field.stepHead < field.queue.size())
+    {
+        int cell = field.queue[field.stepHead++];
+        int x = cell % width, y = cell / width;
+        int best = flowNoStep;
+        Uint32 bestDist = field.dist[cell];
+        bool open[4] = {false, false, false, false};
+        for(int d = 0; d < 8; d++)
+        {
+            int nx = x + flowStepX[d], ny = y + flowStepY[d];
+            if(nx < 0 || ny < 0 || nx >= width || ny >= height)
+                continue;
+            int neighbor = nx + ny * width;
+            if(field.buildStamp[neighbor] != generation)
+                continue;
+            if(d < 4)
+                open[d] = true;
+            else if(!open[flowStepX[d] > 0 ? 0 : 1] || !open[flowStepY[d] > 0 ? 2 : 3])
+                continue;
+            if(field.dist[neighbor] < bestDist)
+            {
+                best = d;
+                bestDist = field.dist[neighbor];
+            }
+        }
+        field.buildNext[cell] = best;
+        budget--;
+    }
+    if(field.searchHead < field.queue.size() || field.stepHead < field.queue.size())
+        return false;
+    std::swap(field.next, field.buildNext);
+    std::swap(field.nextStamp, field.buildStamp);
+    field.generation = field.buildGeneration;
+    field.targetCell = field.buildCell;
+    field.building = false;
+    return true;
+}
+
+//call every tick with the target's cell. levelChanged after a door opened or closed.
+//a new build starts whenever the target has moved to another cell, a running one is always finished first
+void updateFlowField(Flow_Field &field, const std::vector<std::vector<Map_Block>> &level, int targetX, int targetY, bool levelChanged)
+{
+    if(targetX < 0 || targetY < 0 || targetX >= field.width || targetY >= field.height)
+        return;
+    int cell = targetX + targetY * field.width;
+    if(cell != field.wantedCell || levelChanged)
+    {
+        field.wantedCell = cell;
+        field.stale = true;
+    }
+    if(!field.building && field.stale)
+    {
+        field.stale = false;
+        startFlowBuild(field, field.wantedCell);
+    }
+    if(field.building)
+        continueFlowBuild(field, level, flowBuildBudget);
+}
+
+//collect every sprite marked chases into the crowd
+void attachChasers(Chaser_Crowd &crowd, const std::vector<Game_Sprite> &sprites)
+{
+    crowd.x.clear();
+    crowd.y.clear();
+    crowd.speed.clear();
+    crowd.sprite.clear();
+    for(std::size_t i = 0; i < sprites.size(); i++)
+    {
+        if(!sprites[i].chases)
+            continue;
+        crowd.x.push_back(sprites[i].worldX);
+        crowd.y.push_back(sprites[i].worldY);
+        crowd.speed.push_back(chaserSpeed * (0.75f + 0.125f * (i % 5))); //a spread of speeds so a horde strings out
+        crowd.sprite.push_back(i);
+    }
+}
+
+//move every chaser one tick and write the new positions back to their sprites
+void stepChasers(Chaser_Crowd &crowd, const Flow_Field &field, std::vector<Game_Sprite> &sprites, const std::vector<std::vector<Map_Block>> &level, double targetX, double targetY, double dt)
+{
+    const int width = field.width, height = field.height;
+    const float goalX = targetX, goalY = targetY;
+    const std::size_t count = crowd.x.size();
+    if(count == 0)
+        return;
+    float *xs = &crowd.x[0];
+    float *ys = &crowd.y[0];
+    for(std::size_t i = 0; i < count; i++)
+    {
+        float x = xs[i], y = ys[i];
+        int cellX = (int)x, cellY = (int)y;
+        if(cellX < 0 || cellY < 0 || cellX >= width || cellY >= height)
+            continue;
+        int cell = cellX + cellY * width;
+        float toX, toY, stopAt = 0.0f;
+        int step = field.nextStamp[cell] == field.generation ? field.next[cell] : flowNoStep;
+        if(step != flowNoStep && !flowPassable(level, cellX + flowStepX[step], cellY + flowStepY[step]))
+            step = flowNoStep; //a door shut since the field was built
+        if(step != flowNoStep)
+        {
+            //aim for the middle of the next cell, the straight line there stays inside open cells
+            toX = cellX + flowStepX[step] + 0.5f - x;
+            toY = cellY + flowStepY[step] + 0.5f - y;
+        }
+        else
+        {
+            //in the target's cell, or the field hasn't caught up with it yet. head straight for it
+            toX = goalX - x;
+            toY = goalY - y;
+            stopAt = chaserReach;
+        }
+        float length = std::sqrt(toX * toX + toY * toY);
+        float move = std::min(crowd.speed[i] * (float)dt, length - stopAt);
+        if(move <= 0.0f)
+            continue;
+        float newX = x + toX / length * move, newY = y + toY / length * move;
+        if(step == flowNoStep)
+        {
+            //no field to keep it off walls here, so slide along them like the player does
+            if(newX < 0 || newX >= width || !flowPassable(level, (int)newX, cellY))
+                newX = x;
+            if(newY < 0 || newY >= height || !flowPassable(level, (int)newX, (int)newY))
+                newY = y;
+        }
+        xs[i] = newX;
+        ys[i] = newY;
+    }
+    for(std::size_t i = 0; i < count; i++)
+    {
+        Game_Sprite &sprite = sprites[crowd.sprite[i]];
+        sprite.worldX = xs[i];
+        sprite.worldY = ys[i];
+    }
+}
+#endif
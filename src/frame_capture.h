@@ -0,0 +1,223 @@
+#ifndef FRAME_CAPTURE_H
+#define FRAME_CAPTURE_H
+#include <SDL2/SDL.h>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <stdio.h>
+#include "memory_stats.h"
+
+//session recording. each finished frame is read back from the renderer into a free slot of a fixed ring
+//and a writer thread encodes it to disk. one producer (main thread) and one consumer (writer), so the ring
+//only needs two counters: head is only written by the producer, tail only by the consumer.
+//if the writer falls behind and the ring is full the frame is dropped, the main thread never waits on disk
+enum CAPTURE_FORMAT{
+    CAPTURE_Y4M, //one raw YUV 4:2:0 stream
+    CAPTURE_PPM //numbered image per frame
+};
+
+struct Capture_Frame{
+    std::vector<Uint8> pixels; //RGB24, width * 3 bytes per row
+    Uint64 frameNumber = 0; //counts every frame offered, dropped ones included
+};
+
+struct Frame_Capture{
+    int format = CAPTURE_Y4M;
+    std::string path; //y4m file, or name prefix for a ppm sequence
+    int width = 0;
+    int height = 0;
+    int fps = 60; //nominal rate written to the y4m header
+    std::vector<Capture_Frame> ring;
+    SDL_atomic_t head; //frames pushed. producer only
+    SDL_atomic_t tail; //frames written. consumer only
+    SDL_atomic_t quit;
+    SDL_sem *ready = NULL; //posted once per pushed frame so the writer can sleep
+    SDL_Thread *thread = NULL;
+    FILE *file = NULL; //y4m only
+    Uint64 offered = 0; //main thread only
+    Uint64 dropped = 0; //ring was full
+    Uint64 skipped = 0; //output size changed since the capture started, or readback failed
+    Uint64 written = 0; //writer thread only, read after it's joined
+    std::vector<Uint8> planes; //writer's Y, U and V planes
+};
+
+void captureWriteY4M(Frame_Capture &capture, const Capture_Frame &frame)
+{
+    //BT.601 limited range. chroma is averaged over each 2x2 block
+    int w = capture.width, h = capture.height;
+    int cw = (w + 1) / 2, ch = (h + 1) / 2;
+    capture.planes.resize(w * h + 2 * cw * ch);
+    Uint8 *planeY = &capture.planes[0];
+    Uint8 *planeU = planeY + w * h;
+    Uint8 *planeV = planeU + cw * ch;
+    const Uint8 *rgb = &frame.pixels[0];
+    for(int y = 0; y < h; y++)
+    {
+        for(int x = 0; x < w; x++)
+        {
+            const Uint8 *p = rgb + (y * w + x) * 3;
+            planeY[y * w + x] = (Uint8)(((66 * p[0] + 129 * p[1] + 25 * p[2] + 128) >> 8) + 16);
+        }
+    }
+    for(int y = 0; y < ch; y++)
+    {
+        for(int x = 0; x < cw; x++)
+        {
+            int r = 0, g = 0, b = 0;
+            for(int i = 0; i < 4; i++)
+            {
+                int sx = std::min(x * 2 + (i & 1), w - 1), sy = std::min(y * 2 + (i >> 1), h - 1);
+                const Uint8 *p = rgb + (sy * w + sx) * 3;
+                r += p[0];
+                g += p[1];
+                b += p[2];
+            }
+            r /= 4;
+            g /= 4;
+            b /= 4;
+            planeU[y * cw + x] = (Uint8)(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+            planeV[y * cw + x] = (Uint8)(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+        }
+    }
+    fputs("FRAME\n", capture.file);
+    fwrite(&capture.planes[0], 1, capture.planes.size(), capture.file);
+}
+
+void captureWritePPM(Frame_Capture &capture, const Capture_Frame &frame)
+{
+    char name[32];
+    snprintf(name, sizeof(name), "_%06llu.ppm", (unsigned long long)frame.frameNumber);
+    FILE *image = fopen((capture.path + name).c_str(), "wb");
+    if(image == NULL)
+        return;
+    fprintf(image, "P6\n%d %d\n255\n", capture.width, capture.height);
+    fwrite(&frame.pixels[0], 1, frame.pixels.size(), image);
+    fclose(image);
+}
+
+int captureThread(void *data)
+{
+    Frame_Capture &capture = *(Frame_Capture *)data;
+    int slots = capture.ring.size();
+    while(true)
+    {
+        SDL_SemWaitTimeout(capture.ready, 100);
+        int tail = SDL_AtomicGet(&capture.tail);
+        int head = SDL_AtomicGet(&capture.head);
+        while(tail != head)
+        {
+            Capture_Frame &frame = capture.ring[(unsigned)tail % slots];
+            if(capture.format == CAPTURE_Y4M)
+                captureWriteY4M(capture, frame);
+            else
+                captureWritePPM(capture, frame);
+            capture.written++;
+            SDL_AtomicSet(&capture.tail, ++tail); //slot is free again
+        }
+        if(SDL_AtomicGet(&capture.quit) && SDL_AtomicGet(&capture.head) == tail)
+            break; //everything pushed before stopCapture is on disk
+    }
+    return 0;
+}
+
+//the ring, allocated up front by startCapture. the writer's planes are left out, only its thread touches them
+Uint64 captureRingBytes(const Frame_Capture &capture)
+{
+    Uint64 bytes = vectorBytes(capture.ring);
+    for(std::size_t i = 0; i < capture.ring.size(); i++)
+        bytes += vectorBytes(capture.ring[i].pixels);
+    return bytes;
+}
+
+bool startCapture(Frame_Capture &capture, const std::string &path, int width, int height, int slots)
+{
+    capture.path = path;
+    capture.format = (path.size() > 4 && path.compare(path.size() - 4, 4, ".y4m") == 0) ? CAPTURE_Y4M : CAPTURE_PPM;
+    capture.width = width;
+    capture.height = height;
+    capture.ring.resize(slots);
+    for(int i = 0; i < slots; i++)
+        capture.ring[i].pixels.resize(width * height * 3); //all the memory capture needs, up front
+    SDL_AtomicSet(&capture.head, 0);
+    SDL_AtomicSet(&capture.tail, 0);
+    SDL_AtomicSet(&capture.quit, 0);
+    if(capture.format == CAPTURE_Y4M)
+    {
+        capture.file = fopen(path.c_str(), "wb");
+        if(capture.file == NULL)
+        {
+            printf("Capture: couldn't open %s\n", path.c_str());
+            std::vector<Capture_Frame>().swap(capture.ring);
+            return false;
+        }
+        fprintf(capture.file, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg\n", width, height, capture.fps);
+    }
+    capture.ready = SDL_CreateSemaphore(0);
+    if(capture.ready != NULL)
+        capture.thread = SDL_CreateThread(captureThread, "capture", &capture);
+    if(capture.thread == NULL)
+    {
+        //stopCapture does nothing without a thread, so undo everything here
+        printf("Capture: couldn't start writer thread: %s\n", SDL_GetError());
+        if(capture.ready != NULL)
+            SDL_DestroySemaphore(capture.ready);
+        capture.ready = NULL;
+        if(capture.file != NULL)
+            fclose(capture.file);
+        capture.file = NULL;
+        std::vector<Capture_Frame>().swap(capture.ring);
+        return false;
+    }
+    printf("Capture: recording %dx%d to %s\n", width, height, path.c_str());
+    return true;
+}
+
+//call after everything is drawn and before SDL_RenderPresent
+void captureFrame(Frame_Capture &capture, SDL_Renderer *renderer)
+{
+    if(capture.thread == NULL)
+        return;
+    capture.offered++;
+    int w = 0, h = 0;
+    SDL_GetRendererOutputSize(renderer, &w, &h);
+    if(w != capture.width || h != capture.height)
+    {
+        capture.skipped++;
+        return;
+    }
+    int head = SDL_AtomicGet(&capture.head);
+    if((unsigned)head - (unsigned)SDL_AtomicGet(&capture.tail) >= capture.ring.size())
+    {
+        capture.dropped++; //writer is behind. don't even read the frame back
+        return;
+    }
+    Capture_Frame &frame = capture.ring[(unsigned)head % capture.ring.size()];
+    SDL_Rect rect = {0, 0, w, h};
+    if(SDL_RenderReadPixels(renderer, &rect, SDL_PIXELFORMAT_RGB24, &frame.pixels[0], w * 3) != 0)
+    {
+        capture.skipped++;
+        return;
+    }
+    frame.frameNumber = capture.offered;
+    SDL_AtomicSet(&capture.head, head + 1); //hand the slot to the writer
+    SDL_SemPost(capture.ready);
+}
+
+void stopCapture(Frame_Capture &capture)
+{
+    if(capture.thread == NULL)
+        return;
+    SDL_AtomicSet(&capture.quit, 1);
+    SDL_SemPost(capture.ready);
+    SDL_WaitThread(capture.thread, NULL);
+    capture.thread = NULL;
+    SDL_DestroySemaphore(capture.ready);
+    capture.ready = NULL;
+    if(capture.file != NULL)
+        fclose(capture.file);
+    capture.file = NULL;
+    printf("Capture: %llu of %llu frames written, %llu dropped (writer behind), %llu skipped\n",
+           (unsigned long long)capture.written, (unsigned long long)capture.offered,
+           (unsigned long long)capture.dropped, (unsigned long long)capture.skipped);
+}
+#endif
@@ -0,0 +1,177 @@
+#ifndef FRAME_SLOT_H
+#define FRAME_SLOT_H
+#include <SDL2/SDL.h>
+#include <vector>
+#include "blocktypes.h"
+#include "game_sprites.h"
+#include "sim_state.h"
+#include "aux_buffers.h"
+#include "ray_query.h"
+#include "memory_stats.h"
+
+//how calcRaycast finds the wall behind each screen column
+enum RAYCAST_MODE{
+    RAYCAST_COLUMNS, //one DDA ray per column
+    RAYCAST_FACES, //walk the visible cells front to back and hand whole runs of columns from cell to cell
+    RAYCAST_SUBSAMPLE //a ray every few columns, the columns between filled in where both rays agree
+};
+
+//columns [start, end) whose rays all pass through one map cell. scratch for RAYCAST_FACES
+struct Cell_Span{
+    int cellX = 0;
+    int cellY = 0;
+    int start = 0;
+    int end = 0;
+};
+
+//one sprite in front of the camera, placed by projectSprites and cut against the walls by clipSprites
+struct Sprite_Draw{
+    int sprite = 0; //index into the frame's sprites
+    double depth = 0.0; //distance into the screen
+    SDL_Rect dest = {0,0,0,0}; //the whole sprite on screen
+    SDL_Rect clip = {0,0,0,0}; //the part of dest that gets drawn
+    bool visible = false; //any of it in front of the walls
+    bool fogged = false;
+    SDL_Color fog = {0,0,0,0}; //color and alpha of the fog mask drawn over it
+};
+
+//one frame in flight. the frame thread fills the raycast results and pixel buffers while the main thread
+//uploads and presents the previous slot. everything the main thread needs to draw a slot is copied in here
+//so it never has to read view state that already belongs to the next frame
+struct Frame_Slot{
+    Uint64 frameNumber = 0;
+    int width = 0;
+    int height = 0;
+
+    //view state captured when the frame was started
+    const std::vector<std::vector<Map_Block>> *level = NULL; //map the frame is cast against
+    Camera_State cam;
+    double hFOV = 90.0;
+    bool ceilingOn = false;
+    bool fogOn = false;
+    bool debugColors = false;
+    bool mipmapsOn = true;
+    double worldFog = 0.0;
+    double playerFog = 1.0;
+    double fogMultiplier = 1.0;
+    SDL_Color fogColor = {0,0,0,0};
+    Uint32 fogPixel = 0; //fogColor, opaque, in the frame buffer's format
+    double maxRayDist = rayNoLimit; //rays stop here and whatever is further is drawn as fog
+    int raycastMode = RAYCAST_COLUMNS;
+    bool floorInterlace = false; //cast half the floor rows and move the rest over from the previous frame
+    bool paletted = false; //draw palette indices into indexPixels and expand them at the end, see palette.h
+    Uint8 fogIndex = 0; //fogColor in the palette
+    SDL_Rect skySrcRect = {0,0,0,0};
+    SDL_Rect floorRect = {0,0,0,0};
+    std::vector<Game_Sprite> sprites;
+    std::vector<Sprite_Draw> spriteDraws; //sprites in front of the camera, far to near
+    Uint64 lookSeq = 0; //newest mouse look input this frame shows
+    Uint64 moveSeq = 0; //newest input the sim had applied when this frame was started
+
+    //raycast results, one entry per screen column
+    std::vector<double> wallDist; //dist to nearest wall
+    std::vector<int> side; //was a NS or a EW wall hit?
+    std::vector<int> mapX; //the x value on map of wall hit
+    std::vector<int> mapY; //the y value on map of wall hit
+    std::vector<int> blockID; //block_id of the wall hit. used by debug colors. -1 where the ray hit nothing before maxRayDist or the map edge
+    std::vector<int> wallTex; //index of the wall texture to draw
+    std::vector<int> wallFace; //which face of the block was hit, NORTH to WEST
+    std::vector<int> texX; //column of the wall texture to draw
+    std::vector<int> drawStart; //first screen row of the wall
+    std::vector<int> drawEnd; //last screen row of the wall
+    std::vector<int> raySteps; //cells each column's ray stepped through, 0 for columns filled in without a ray of their own
+    std::vector<Cell_Span> cellSpans; //RAYCAST_FACES work stack
+    std::vector<Trail_Cell> leftTrail, rightTrail; //RAYCAST_SUBSAMPLE cells the last two full rays went through
+    double blockAheadDist = 500;
+    int blockAheadX = 0, blockAheadY = 0;
+    int blockLeftX = 0, blockLeftY = 0;
+    int blockRightX = 0, blockRightY = 0;
+
+    //cpu pixel buffers. a row is only uploaded if it was written this frame and differs from what the texture holds
+    std::vector<double> floorDist; //floor/ceiling distance for each screen row
+    std::vector<Uint32> floorPixels;
+    std::vector<Uint32> fogPixels;
+    std::vector<Uint8> floorRowWritten;
+    std::vector<Uint8> floorRowDirty;
+    std::vector<Uint8> fogRowWritten;
+    std::vector<Uint8> fogRowDirty;
+    bool fullUpload = true; //texture contents are unknown, upload every written row
+
+    //8 bit path. fog and side shading are done by the colormaps, so fogPixels only fogs the sky when there's no ceiling
+    std::vector<Uint8> indexPixels;
+    std::vector<Uint8> colormaps; //built for colormapFog, rebuilt when the fog color changes
+    SDL_Color colormapFog = {0,0,0,0};
+
+    //floor and ceiling without walls on top, kept for the next frame to reproject when floorInterlace is on.
+    //only rows this frame actually cast are copied in: every row if floorParity is -1, else rows with y % 2 == floorParity
+    std::vector<Uint32> floorHistory;
+    bool floorHistoryValid = false;
+    int floorParity = -1;
+
+    //for telemetry
+    double renderMs = 0; //time renderFrame took
+    int spritesDrawn = 0; //sprites clipSprites found in front of the camera
+
+    Aux_Buffers aux; //optional depth, surface and sprite outputs, filled alongside the pixels. only batch observations ask for them
+};
+
+//everything a slot has allocated, its aux buffers included
+Uint64 frameSlotBytes(const Frame_Slot &frame)
+{
+    Uint64 bytes = vectorBytes(frame.sprites) + vectorBytes(frame.spriteDraws);
+    bytes += vectorBytes(frame.wallDist) + vectorBytes(frame.side) + vectorBytes(frame.mapX) + vectorBytes(frame.mapY);
+    bytes += vectorBytes(frame.blockID) + vectorBytes(frame.wallTex) + vectorBytes(frame.wallFace) + vectorBytes(frame.texX);
+    bytes += vectorBytes(frame.drawStart) + vectorBytes(frame.drawEnd) + vectorBytes(frame.raySteps) + vectorBytes(frame.cellSpans);
+    bytes += vectorBytes(frame.leftTrail) + vectorBytes(frame.rightTrail);
+    bytes += vectorBytes(frame.floorDist) + vectorBytes(frame.floorPixels) + vectorBytes(frame.fogPixels);
+    bytes += vectorBytes(frame.floorRowWritten) + vectorBytes(frame.floorRowDirty) + vectorBytes(frame.fogRowWritten) + vectorBytes(frame.fogRowDirty);
+    bytes += vectorBytes(frame.indexPixels) + vectorBytes(frame.colormaps) + vectorBytes(frame.floorHistory);
+    bytes += vectorBytes(frame.aux.columnDepth) + vectorBytes(frame.aux.depth) + vectorBytes(frame.aux.surface) + vectorBytes(frame.aux.sprite);
+    return bytes;
+}
+
+//what every fog row of a frame looks up, built once per frame by prepareFog
+struct Fog_Tables{
+    Uint32 clear = 0; //the fog color with no alpha. fog only changes in alpha across the screen
+    int alphaShift = 24; //where alpha sits in a pixel
+    std::vector<double> columnFog; //fogMultiplier * brightSin of each column
+    std::vector<Uint32> wallFog; //fog pixel over each column's wall
+};
+
+//what the tasks of one frame's graph share, each task works on one band of it
+struct Frame_Tasks{
+    Frame_Slot *frame = NULL;
+    const Frame_Slot *prev = NULL;
+    int columnBands = 1; //ray and wall column tasks split the width into this many
+    int rowBands = 1; //floor, wall and fog tasks split the height into this many
+    Fog_Tables fog;
+};
+
+void initFrameSlot(Frame_Slot &frame, int width, int height)
+{
+    frame.width = width;
+    frame.height = height;
+    frame.wallDist.assign(width, 0.0);
+    frame.side.assign(width, 0);
+    frame.mapX.assign(width, 0);
+    frame.mapY.assign(width, 0);
+    frame.blockID.assign(width, 0);
+    frame.wallTex.assign(width, 0);
+    frame.wallFace.assign(width, 0);
+    frame.texX.assign(width, 0);
+    frame.drawStart.assign(width, 0);
+    frame.drawEnd.assign(width, 0);
+    frame.raySteps.assign(width, 0);
+    frame.floorDist.assign(height, 0.0);
+    frame.floorPixels.assign(width * height, 0);
+    frame.fogPixels.assign(width * height, 0);
+    frame.floorRowWritten.assign(height, 0);
+    frame.floorRowDirty.assign(height, 0);
+    frame.fogRowWritten.assign(height, 0);
+    frame.fogRowDirty.assign(height, 0);
+    frame.fullUpload = true;
+    frame.floorHistory.assign(width * height, 0);
+    frame.floorHistoryValid = false;
+    frame.floorParity = -1;
+}
+#endif
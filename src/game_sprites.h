@@ -1,4 +1,5 @@
 #ifndef GAME_SPRITES_H
+#define GAME_SPRITES_H
 #include <SDL2/SDL.h>
 
 struct Game_Sprite{
@@ -9,9 +10,11 @@ struct Game_Sprite{
     int texID = 0; //index of sprite texture
     int frame = 0; //animation frame number
     int totalFrames = 0; //number of animation frames
+    double frameTime = 0; //how far into the current frame the animation is. 1.0 moves to the next frame
     SDL_Rect image{0, 0, 0, 0}; //information about its texture image
     bool visible = false; //can it be seen by player
     bool solid = false; //can player walk through it
     bool pickup = false; //should it destroy on collision with player    
+    bool chases = false; //follows the player around the level, see flow_field.h
 };
 #endif
\ No newline at end of file
@@ -0,0 +1,110 @@
+#ifndef GOLDEN_IMAGES_H
+#define GOLDEN_IMAGES_H
+#include <SDL2/SDL.h>
+#include <vector>
+#include <string>
+#include <map>
+#include <algorithm>
+#include <stdlib.h>
+#include <stdio.h>
+
+//rendering regression checks. fixed views of the shipped maps are drawn and read back, then compared against
+//reference images recorded earlier, and the time each view took is compared against the times recorded with them.
+//references are binary PPMs so any image viewer can show what changed, times are one "name ms" line per view
+const char goldenTimesFile[] = "golden_times.txt";
+
+struct Golden_Image{
+    int width = 0;
+    int height = 0;
+    std::vector<Uint8> pixels; //RGB24, width * 3 bytes per row
+};
+
+//what differs between a frame and its reference
+struct Golden_Diff{
+    bool sizeMismatch = false;
+    Uint64 differing = 0; //pixels with any channel further off than the tolerance
+    int maxDiff = 0; //largest difference of any channel of any pixel
+};
+
+//read back what the renderer has drawn so far. call before SDL_RenderPresent
+bool grabGoldenImage(SDL_Renderer *renderer, Golden_Image &image)
+{
+    SDL_GetRendererOutputSize(renderer, &image.width, &image.height);
+    image.pixels.resize(image.width * image.height * 3);
+    SDL_Rect rect = {0, 0, image.width, image.height};
+    return !image.pixels.empty() && SDL_RenderReadPixels(renderer, &rect, SDL_PIXELFORMAT_RGB24, &image.pixels[0], image.width * 3) == 0;
+}
+
+bool writeGoldenImage(const std::string &path, const Golden_Image &image)
+{
+    FILE *file = fopen(path.c_str(), "wb");
+    if(file == NULL)
+        return false;
+    fprintf(file, "P6\n%d %d\n255\n", image.width, image.height);
+    bool written = fwrite(&image.pixels[0], 1, image.pixels.size(), file) == image.pixels.size();
+    fclose(file);
+    return written;
+}
+
+//only reads what writeGoldenImage writes: P6, 8 bits per channel
+bool readGoldenImage(const std::string &path, Golden_Image &image)
+{
+    FILE *file = fopen(path.c_str(), "rb");
+    if(file == NULL)
+        return false;
+    int maxValue = 0;
+    bool read = fscanf(file, "P6 %d %d %d", &image.width, &image.height, &maxValue) == 3 && maxValue == 255 && image.width > 0 && image.height > 0;
+    if(read)
+    {
+        fgetc(file); //the one whitespace byte between the header and the pixels
+        image.pixels.resize(image.width * image.height * 3);
+        read = fread(&image.pixels[0], 1, image.pixels.size(), file) == image.pixels.size();
+    }
+    fclose(file);
+    return read;
+}
+
+Golden_Diff compareGoldenImages(const Golden_Image &frame, const Golden_Image &reference, int tolerance)
+{
+    Golden_Diff diff;
+    if(frame.width != reference.width || frame.height != reference.height)
+    {
+        diff.sizeMismatch = true;
+        return diff;
+    }
+    const Uint8 *a = frame.pixels.empty() ? NULL : &frame.pixels[0];
+    const Uint8 *b = reference.pixels.empty() ? NULL : &reference.pixels[0];
+    const int pixels = frame.width * frame.height;
+    for(int i = 0; i < pixels; i++, a += 3, b += 3)
+    {
+        int worst = std::max(std::abs(a[0] - b[0]), std::max(std::abs(a[1] - b[1]), std::abs(a[2] - b[2])));
+        diff.maxDiff = std::max(diff.maxDiff, worst);
+        diff.differing += worst > tolerance;
+    }
+    return diff;
+}
+
+bool writeGoldenTimes(const std::string &path, const std::map<std::string, double> &times)
+{
+    FILE *file = fopen(path.c_str(), "w");
+    if(file == NULL)
+        return false;
+    for(std::map<std::string, double>::const_iterator it = times.begin(); it != times.end(); ++it)
+        fprintf(file, "%s %.4f\n", it->first.c_str(), it->second);
+    fclose(file);
+    return true;
+}
+
+bool readGoldenTimes(const std::string &path, std::map<std::string, double> &times)
+{
+    FILE *file = fopen(path.c_str(), "r");
+    if(file == NULL)
+        return false;
+    char name[128];
+    double ms = 0;
+    while(fscanf(file, "%127s %lf", name, &ms) == 2)
+        times[name] = ms;
+    fclose(file);
+    return true;
+}
+#endif
@@ -0,0 +1,75 @@
+#ifndef INPUT_LATENCY_H
+#define INPUT_LATENCY_H
+#include <SDL2/SDL.h>
+#include <vector>
+#include <deque>
+#include <algorithm>
+#include <stdio.h>
+
+//input-to-present latency tracking. every input sample gets a sequence number and a timestamp when it's read.
+//each frame remembers the newest sequence number it reflects, and when that frame is presented every
+//sample up to that number gets its latency recorded. present time is when SDL_RenderPresent returns,
+//so scanout and display lag aren't included
+struct Input_Sample{
+    Uint64 seq = 0;
+    Uint64 time = 0; //performance counter time the input was read
+};
+
+struct Input_Latency{
+    const char *name = "";
+    std::deque<Input_Sample> pending; //read but not on screen yet
+    std::vector<double> period; //latencies in ms since the last report
+    std::vector<double> session; //every latency this run
+};
+
+void latencyInputSeen(Input_Latency &stats, Uint64 seq, Uint64 time)
+{
+    stats.pending.push_back(Input_Sample{seq, time});
+    if(stats.pending.size() > 4096) //nothing is presenting, don't grow forever
+        stats.pending.pop_front();
+}
+
+void latencyPresented(Input_Latency &stats, Uint64 seq, Uint64 time)
+{
+    double msPerCount = 1000.0 / SDL_GetPerformanceFrequency();
+    while(!stats.pending.empty() && stats.pending.front().seq <= seq)
+    {
+        double ms = (time - std::min(time, stats.pending.front().time)) * msPerCount;
+        stats.period.push_back(ms);
+        stats.session.push_back(ms);
+        stats.pending.pop_front();
+    }
+}
+
+double latencyPercentile(std::vector<double> &samples, double percent)
+{
+    if(samples.empty())
+        return 0;
+    std::size_t n = std::min(samples.size() - 1, (std::size_t)(percent / 100.0 * samples.size()));
+    std::nth_element(samples.begin(), samples.begin() + n, samples.end());
+    return samples[n];
+}
+
+void latencyPrint(const char *name, const char *label, std::vector<double> &samples)
+{
+    if(samples.empty())
+        return;
+    double p50 = latencyPercentile(samples, 50);
+    double p90 = latencyPercentile(samples, 90);
+    double p99 = latencyPercentile(samples, 99);
+    double worst = *std::max_element(samples.begin(), samples.end());
+    printf("Input latency (%s, %s): n=%u p50=%.2fms p90=%.2fms p99=%.2fms max=%.2fms\n",
+           name, label, (unsigned)samples.size(), p50, p90, p99, worst);
+}
+
+void latencyReport(Input_Latency &stats)
+{
+    latencyPrint(stats.name, "recent", stats.period);
+    stats.period.clear();
+}
+
+void latencyReportSession(Input_Latency &stats)
+{
+    latencyPrint(stats.name, "session", stats.session);
+}
+#endif
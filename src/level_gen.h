@@ -0,0 +1,327 @@
+#ifndef LEVEL_GEN_H
+#define LEVEL_GEN_H
+#include <SDL2/SDL.h>
+#include <vector>
+#include <string>
+#include <fstream>
+#include <algorithm>
+#include "blocktypes.h"
+
+//seeded random level generator. the map is cut into square regions with one room each. a region is built only
+//from a hash of the seed and its own coordinates, so regions can be built in parallel in any order and the same
+//seed always gives the same map whatever the thread count. neighbouring rooms are joined by a corridor through an
+//opening in their shared edge. the opening is hashed from the edge itself, so both sides carve to the same spot
+//without having to look at each other's cells
+
+struct Level_Gen_Params{
+    Uint64 seed = 1;
+    int width = 64;
+    int height = 64; //map size in cells, 8 to 8192
+    int regionSize = 24; //cells per region side
+    double doorChance = 0.5; //chance a corridor enters its room through a door
+    double exitChance = 0.02; //chance a room gets an exit panel. the last room always gets one
+    int maxSpritesPerRoom = 3;
+    int spriteTypes = 4; //sprites get a texID from 0 to spriteTypes-1
+    int threads = 0; //0 uses every cpu
+};
+
+struct Sprite_Spawn{
+    int texID = 0;
+    double x = 0;
+    double y = 0;
+};
+
+struct Generated_Level{
+    int width = 0;
+    int height = 0;
+    int startX = 0;
+    int startY = 0;
+    std::vector<Uint8> cells; //block ids, x + y * width
+    std::vector<Sprite_Spawn> sprites;
+};
+
+//splitmix64, used both to hash coordinates into seeds and as the generator itself
+inline Uint64 levelGenMix(Uint64 h)
+{
+    h += 0x9E3779B97F4A7C15ull;
+    h = (h ^ (h >> 30)) * 0xBF58476D1CE4E5B9ull;
+    h = (h ^ (h >> 27)) * 0x94D049BB133111EBull;
+    return h ^ (h >> 31);
+}
+
+inline Uint64 levelGenHash(Uint64 seed, Uint64 a, Uint64 b, Uint64 c)
+{
+    return levelGenMix(levelGenMix(levelGenMix(levelGenMix(seed) ^ a) ^ b) ^ c);
+}
+
+struct Level_Gen_Rng{
+    Uint64 state;
+    Uint64 next()
+    {
+        state += 0x9E3779B97F4A7C15ull;
+        return levelGenMix(state);
+    }
+    int range(int lo, int hi) //inclusive
+    {
+        return hi <= lo ? lo : lo + (int)(next() % (Uint64)(hi - lo + 1));
+    }
+    double unit()
+    {
+        return (next() >> 11) * (1.0 / 9007199254740992.0);
+    }
+};
+
+struct Level_Gen_Room{
+    bool exists = false;
+    int x0 = 0, y0 = 0, x1 = 0, y1 = 0; //interior, inclusive
+};
+
+struct Level_Gen_Job{
+    const Level_Gen_Params *params = NULL;
+    Generated_Level *level = NULL;
+    int regionsX = 0;
+    int regionsY = 0;
+    int exitRegion = 0; //always gets an exit panel
+    SDL_atomic_t nextRegion;
+    std::vector<std::vector<Sprite_Spawn>> regionSprites; //merged in region order afterwards so thread timing can't reorder them
+};
+
+void levelRegionBounds(const Level_Gen_Params &params, int rx, int ry, int &x0, int &y0, int &w, int &h)
+{
+    x0 = rx * params.regionSize;
+    y0 = ry * params.regionSize;
+    w = std::min(params.regionSize, params.width - x0);
+    h = std::min(params.regionSize, params.height - y0);
+}
+
+bool levelRegionHasRoom(const Level_Gen_Params &params, int rx, int ry)
+{
+    int x0, y0, w, h;
+    levelRegionBounds(params, rx, ry, x0, y0, w, h);
+    return w >= 6 && h >= 6;
+}
+
+//the room is rolled from the region's own hash, so any region can work out any other's room if it needs to
+Level_Gen_Room levelRegionRoom(const Level_Gen_Params &params, int rx, int ry)
+{
+    Level_Gen_Room room;
+    if(!levelRegionHasRoom(params, rx, ry))
+        return room;
+    int x0, y0, w, h;
+    levelRegionBounds(params, rx, ry, x0, y0, w, h);
+    Level_Gen_Rng rng = {levelGenHash(params.seed, rx, ry, 0)};
+    //keep one wall cell around the room inside the region, so two regions always have two walls between them
+    int roomW = rng.range(std::max(2, (w - 2) / 3), w - 2);
+    int roomH = rng.range(std::max(2, (h - 2) / 3), h - 2);
+    room.x0 = x0 + 1 + rng.range(0, w - 2 - roomW);
+    room.y0 = y0 + 1 + rng.range(0, h - 2 - roomH);
+    room.x1 = room.x0 + roomW - 1;
+    room.y1 = room.y0 + roomH - 1;
+    room.exists = true;
+    return room;
+}
+
+//where the corridor crosses the edge between a region and its right (vertical edge) or lower neighbour
+int levelEdgeOpening(const Level_Gen_Params &params, int rx, int ry, bool vertical)
+{
+    int x0, y0, w, h;
+    levelRegionBounds(params, rx, ry, x0, y0, w, h);
+    Level_Gen_Rng rng = {levelGenHash(params.seed, rx, ry, vertical ? 1 : 2)};
+    if(vertical)
+        return y0 + rng.range(2, h - 3);
+    return x0 + rng.range(2, w - 3);
+}
+
+bool levelInRoom(const Level_Gen_Room &room, int x, int y)
+{
+    return x >= room.x0 && x <= room.x1 && y >= room.y0 && y <= room.y1;
+}
+
+//L shaped corridor from inside the room to a cell on the region border. vertical edges move along y first
+//so the last leg runs straight into the edge, horizontal edges move along x first
+void levelCarveCorridor(Generated_Level &level, const Level_Gen_Room &room, Level_Gen_Rng &rng, double doorChance, int edgeX, int edgeY, bool verticalEdge)
+{
+    int x = std::min(std::max(edgeX, room.x0), room.x1);
+    int y = std::min(std::max(edgeY, room.y0), room.y1);
+    bool doorPlaced = false;
+    bool wantDoor = rng.unit() < doorChance;
+    for(int leg = 0; leg < 2; leg++)
+    {
+        bool alongY = (leg == 0) == verticalEdge;
+        while(alongY ? (y != edgeY) : (x != edgeX))
+        {
+            if(alongY)
+                y += (edgeY > y) ? 1 : -1;
+            else
+                x += (edgeX > x) ? 1 : -1;
+            Uint8 &cell = level.cells[x + y * level.width];
+            if(!doorPlaced && !levelInRoom(room, x, y))
+            {
+                //first cell past the room is the room's wall, put the door there
+                doorPlaced = true;
+                if(wantDoor && cell == BLOCK_WALL)
+                {
+                    cell = BLOCK_DOOR;
+                    continue;
+                }
+            }
+            if(cell != BLOCK_DOOR)
+                cell = BLOCK_AIR;
+        }
+    }
+}
+
+void levelBuildRegion(Level_Gen_Job &job, int index)
+{
+    const Level_Gen_Params &params = *job.params;
+    Generated_Level &level = *job.level;
+    int rx = index % job.regionsX;
+    int ry = index / job.regionsX;
+    int x0, y0, w, h;
+    levelRegionBounds(params, rx, ry, x0, y0, w, h);
+
+    for(int y = y0; y < y0 + h; y++)
+        std::fill(level.cells.begin() + y * level.width + x0, level.cells.begin() + y * level.width + x0 + w, (Uint8)BLOCK_WALL);
+
+    Level_Gen_Room room = levelRegionRoom(params, rx, ry);
+    if(!room.exists)
+        return;
+    for(int y = room.y0; y <= room.y1; y++)
+        std::fill(level.cells.begin() + y * level.width + room.x0, level.cells.begin() + y * level.width + room.x1 + 1, (Uint8)BLOCK_AIR);
+
+    //corridors to every neighbour that also has a room. the map edge never gets one, so the border stays solid
+    Level_Gen_Rng rng = {levelGenHash(params.seed, rx, ry, 3)};
+    if(rx + 1 < job.regionsX && levelRegionHasRoom(params, rx + 1, ry))
+        levelCarveCorridor(level, room, rng, params.doorChance, x0 + w - 1, levelEdgeOpening(params, rx, ry, true), true);
+    if(rx > 0)
+        levelCarveCorridor(level, room, rng, params.doorChance, x0, levelEdgeOpening(params, rx - 1, ry, true), true);
+    if(ry + 1 < job.regionsY && levelRegionHasRoom(params, rx, ry + 1))
+        levelCarveCorridor(level, room, rng, params.doorChance, levelEdgeOpening(params, rx, ry, false), y0 + h - 1, false);
+    if(ry > 0)
+        levelCarveCorridor(level, room, rng, params.doorChance, levelEdgeOpening(params, rx, ry - 1, false), y0, false);
+
+    //exit panel in a random spot of the room's top wall. if a corridor opened that spot up, walk on around the wall
+    //ring (top, right, bottom, left, corners left out since they can't be faced) to the next cell still solid
+    if(index == job.exitRegion || rng.unit() < params.exitChance)
+    {
+        int px = rng.range(room.x0, room.x1);
+        int roomW = room.x1 - room.x0 + 1, roomH = room.y1 - room.y0 + 1;
+        int ring = 2 * (roomW + roomH);
+        for(int i = 0; i < ring; i++)
+        {
+            int step = (px - room.x0 + i) % ring;
+            int x, y;
+            if(step < roomW)
+                x = room.x0 + step, y = room.y0 - 1;
+            else if((step -= roomW) < roomH)
+                x = room.x1 + 1, y = room.y0 + step;
+            else if((step -= roomH) < roomW)
+                x = room.x1 - step, y = room.y1 + 1;
+            else
+                x = room.x0 - 1, y = room.y1 - (step - roomW);
+            Uint8 &cell = level.cells[x + y * level.width];
+            if(cell == BLOCK_WALL)
+            {
+                cell = BLOCK_PANEL;
+                break;
+            }
+        }
+    }
+
+    std::vector<Sprite_Spawn> &sprites = job.regionSprites[index];
+    int spriteCount = rng.range(0, params.maxSpritesPerRoom);
+    for(int i = 0; i < spriteCount; i++)
+    {
+        Sprite_Spawn spawn;
+        spawn.texID = rng.range(0, std::max(0, params.spriteTypes - 1));
+        spawn.x = room.x0 + rng.unit() * (room.x1 - room.x0 + 1);
+        spawn.y = room.y0 + rng.unit() * (room.y1 - room.y0 + 1);
+        sprites.push_back(spawn);
+    }
+}
+
+int levelGenThread(void *data)
+{
+    Level_Gen_Job &job = *(Level_Gen_Job *)data;
+    int total = job.regionsX * job.regionsY;
+    int index;
+    while((index = SDL_AtomicAdd(&job.nextRegion, 1)) < total)
+        levelBuildRegion(job, index);
+    return 0;
+}
+
+void generateLevel(Level_Gen_Params params, Generated_Level &level)
+{
+    params.width = std::min(8192, std::max(8, params.width));
+    params.height = std::min(8192, std::max(8, params.height));
+    params.regionSize = std::max(6, params.regionSize);
+
+    level.width = params.width;
+    level.height = params.height;
+    level.cells.assign((std::size_t)level.width * level.height, BLOCK_WALL);
+    level.sprites.clear();
+
+    Level_Gen_Job job;
+    job.params = &params;
+    job.level = &level;
+    job.regionsX = (params.width + params.regionSize - 1) / params.regionSize;
+    job.regionsY = (params.height + params.regionSize - 1) / params.regionSize;
+    job.regionSprites.resize(job.regionsX * job.regionsY);
+    SDL_AtomicSet(&job.nextRegion, 0);
+    for(int i = job.regionsX * job.regionsY - 1; i >= 0; i--)
+    {
+        if(levelRegionHasRoom(params, i % job.regionsX, i / job.regionsX))
+        {
+            job.exitRegion = i; //furthest room from the start
+            break;
+        }
+    }
+
+    int threadCount = params.threads > 0 ? params.threads : SDL_GetCPUCount();
+    threadCount = std::max(1, std::min(threadCount, job.regionsX * job.regionsY));
+    std::vector<SDL_Thread *> threads;
+    for(int i = 1; i < threadCount; i++)
+    {
+        SDL_Thread *thread = SDL_CreateThread(levelGenThread, "levelgen", &job);
+        if(thread != NULL)
+            threads.push_back(thread);
+    }
+    levelGenThread(&job); //this thread helps too, and finishes everything alone if no threads started
+    for(std::size_t i = 0; i < threads.size(); i++)
+        SDL_WaitThread(threads[i], NULL);
+
+    //start in the middle of the first room
+    Level_Gen_Room first = levelRegionRoom(params, 0, 0);
+    level.startX = (first.x0 + first.x1) / 2;
+    level.startY = (first.y0 + first.y1) / 2;
+    for(std::size_t i = 0; i < job.regionSprites.size(); i++)
+        level.sprites.insert(level.sprites.end(), job.regionSprites[i].begin(), job.regionSprites[i].end());
+}
+
+//same layout loadLevel reads: start x, start y, width, height, then the block ids row by row.
+//sprites go in an optional trailing section that older loaders never read
+bool writeLevelFile(const Generated_Level &level, const std::string &path)
+{
+    std::ofstream mapFile(path.c_str());
+    if(!mapFile)
+        return false;
+    mapFile << level.startX << "\n" << level.startY << "\n" << level.width << "\n" << level.height << "\n";
+    std::string row;
+    for(int y = 0; y < level.height; y++)
+    {
+        row.clear();
+        for(int x = 0; x < level.width; x++)
+        {
+            if(x > 0)
+                row += ' ';
+            row += std::to_string(level.cells[x + y * level.width]);
+        }
+        row += '\n';
+        mapFile << row;
+    }
+    mapFile << "sprites " << level.sprites.size() << "\n";
+    for(std::size_t i = 0; i < level.sprites.size(); i++)
+        mapFile << level.sprites[i].texID << " " << level.sprites[i].x << " " << level.sprites[i].y << "\n";
+    return (bool)mapFile;
+}
+#endif
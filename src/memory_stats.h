@@ -0,0 +1,139 @@
+#ifndef MEMORY_STATS_H
+#define MEMORY_STATS_H
+#include <SDL2/SDL.h>
+#include <vector>
+#include <algorithm>
+#include <stdio.h>
+#if defined(__linux__)
+#include <unistd.h>
+#endif
+
+//bytes held by each part of the game, so an instance's resident size can be split into textures, map data and
+//so on. textures are counted as they're created and destroyed, everything kept in containers is measured from
+//the containers whenever the owner asks. whatever the process holds beyond the total is SDL, the driver, the
+//heap's own overhead and the code itself
+enum MEMORY_TAG{
+    MEMORY_MAP, //leveldata and the sim's copy of it
+    MEMORY_BLOCK_TYPES,
+    MEMORY_TEXTURES, //SDL_Textures, at their pixel size. the renderer may keep more on its side
+    MEMORY_TEXELS, //cpu copies of the images, mips and palette indices included
+    MEMORY_SPRITES, //sprite lists and the arrays sorted alongside them
+    MEMORY_TABLES, //fog and floor lookup tables and the palette
+    MEMORY_FRAMES, //frame slot buffers, their colormaps and aux buffers, observation buffers and other per frame scratch
+    MEMORY_SNAPSHOTS, //saved worlds and the sim's published ticks
+    MEMORY_TAG_COUNT
+};
+
+struct Memory_Stats{
+    SDL_SpinLock lock = 0; //textures can be made off the main thread
+    Uint64 current[MEMORY_TAG_COUNT] = {};
+    Uint64 peak[MEMORY_TAG_COUNT] = {};
+    Uint64 peakTotal = 0;
+};
+
+inline const char *memoryTagName(int tag)
+{
+    const char *names[MEMORY_TAG_COUNT] = {"map", "block types", "textures", "texels", "sprites", "tables", "frames", "snapshots"};
+    return tag >= 0 && tag < MEMORY_TAG_COUNT ? names[tag] : "unknown";
+}
+
+//call with stats.lock held
+inline void memoryUpdatePeaks(Memory_Stats &stats, int tag)
+{
+    stats.peak[tag] = std::max(stats.peak[tag], stats.current[tag]);
+    Uint64 total = 0;
+    for(int i = 0; i < MEMORY_TAG_COUNT; i++)
+        total += stats.current[i];
+    stats.peakTotal = std::max(stats.peakTotal, total);
+}
+
+void memoryAdd(Memory_Stats &stats, int tag, Uint64 bytes)
+{
+    SDL_AtomicLock(&stats.lock);
+    stats.current[tag] += bytes;
+    memoryUpdatePeaks(stats, tag);
+    SDL_AtomicUnlock(&stats.lock);
+}
+
+void memoryRemove(Memory_Stats &stats, int tag, Uint64 bytes)
+{
+    SDL_AtomicLock(&stats.lock);
+    stats.current[tag] -= std::min(bytes, stats.current[tag]);
+    SDL_AtomicUnlock(&stats.lock);
+}
+
+//for tags measured from their containers, replaces whatever was counted before
+void memorySet(Memory_Stats &stats, int tag, Uint64 bytes)
+{
+    SDL_AtomicLock(&stats.lock);
+    stats.current[tag] = bytes;
+    memoryUpdatePeaks(stats, tag);
+    SDL_AtomicUnlock(&stats.lock);
+}
+
+//what a vector has allocated, not just what it's using
+template<typename T> Uint64 vectorBytes(const std::vector<T> &v)
+{
+    return (Uint64)v.capacity() * sizeof(T);
+}
+
+template<typename T> Uint64 vectorBytes(const std::vector<std::vector<T>> &v)
+{
+    Uint64 bytes = (Uint64)v.capacity() * sizeof(std::vector<T>);
+    for(std::size_t i = 0; i < v.size(); i++)
+        bytes += vectorBytes(v[i]);
+    return bytes;
+}
+
+//pixel bytes of a texture, 0 for NULL
+Uint64 textureBytes(SDL_Texture *tex)
+{
+    Uint32 format = 0;
+    int w = 0, h = 0;
+    if(tex == NULL || SDL_QueryTexture(tex, &format, NULL, &w, &h) != 0)
+        return 0;
+    return (Uint64)w * h * SDL_BYTESPERPIXEL(format);
+}
+
+//resident set size of the whole process from /proc/self/statm. 0 where there's no such file
+Uint64 residentBytes()
+{
+#if defined(__linux__)
+    FILE *file = fopen("/proc/self/statm", "r");
+    if(file == NULL)
+        return 0;
+    unsigned long long size = 0, resident = 0;
+    int read = fscanf(file, "%llu %llu", &size, &resident);
+    fclose(file);
+    return read == 2 ? resident * (Uint64)sysconf(_SC_PAGESIZE) : 0;
+#else
+    return 0;
+#endif
+}
+
+void printMemoryReport(Memory_Stats &stats)
+{
+    SDL_AtomicLock(&stats.lock);
+    Memory_Stats copy;
+    for(int tag = 0; tag < MEMORY_TAG_COUNT; tag++)
+    {
+        copy.current[tag] = stats.current[tag];
+        copy.peak[tag] = stats.peak[tag];
+    }
+    copy.peakTotal = stats.peakTotal;
+    SDL_AtomicUnlock(&stats.lock);
+
+    Uint64 total = 0;
+    printf("Memory: %-12s %10s %10s\n", "", "current KB", "peak KB");
+    for(int tag = 0; tag < MEMORY_TAG_COUNT; tag++)
+    {
+        printf("Memory: %-12s %10llu %10llu\n", memoryTagName(tag), (unsigned long long)(copy.current[tag] / 1024), (unsigned long long)(copy.peak[tag] / 1024));
+        total += copy.current[tag];
+    }
+    printf("Memory: %-12s %10llu %10llu\n", "tracked", (unsigned long long)(total / 1024), (unsigned long long)(copy.peakTotal / 1024));
+    printf("Memory: frame peaks are sampled every frame, the rest at level loads, saves, capture and batch setup\n");
+    Uint64 resident = residentBytes();
+    if(resident > 0)
+        printf("Memory: resident %llu KB, %llu KB of it untracked (SDL, driver, heap overhead, code)\n", (unsigned long long)(resident / 1024), (unsigned long long)(resident > total ? (resident - total) / 1024 : 0));
+}
+#endif
@@ -0,0 +1,249 @@
+#ifndef PALETTE_H
+#define PALETTE_H
+#include <SDL2/SDL.h>
+#include <vector>
+#include <algorithm>
+#include "texel_store.h"
+
+//8 bit rendering. wall, floor and ceiling textures are quantized once at load time to one shared 256 color palette,
+//the frame is drawn as palette indices and turned back into RGBA32 once at the end. side shading and fog become one
+//table lookup: colormap (dark, level) maps every palette color to the palette color nearest to it after darkening
+//like texelDarken and blending level / (paletteFogLevels - 1) of the way to the fog color
+
+const Uint8 paletteTransparent = 0; //never a texture color, it's where the sky shows through
+const int paletteFogLevels = 32;
+const int paletteCubeBits = 5; //bits per channel of the nearest color table
+const int paletteShades = 4; //brightness steps each texel is counted at when picking the palette
+
+struct Palette{
+    Uint32 colors[256]; //RGBA32, opaque except paletteTransparent
+    Uint8 r[256];
+    Uint8 g[256];
+    Uint8 b[256];
+    int count = 0; //colors in use, paletteTransparent included
+    std::vector<Uint8> nearest; //palette index nearest to each 15 bit color, see paletteCell
+};
+
+//RGBA32 is R,G,B,A in memory whatever the byte order, so read and write the bytes
+inline Uint32 packRGBA(Uint8 r, Uint8 g, Uint8 b, Uint8 a)
+{
+    Uint32 color;
+    Uint8 *bytes = (Uint8 *)&color;
+    bytes[0] = r;
+    bytes[1] = g;
+    bytes[2] = b;
+    bytes[3] = a;
+    return color;
+}
+
+inline int paletteCell(int r, int g, int b)
+{
+    const int drop = 8 - paletteCubeBits;
+    return ((r >> drop) << (2 * paletteCubeBits)) | ((g >> drop) << paletteCubeBits) | (b >> drop);
+}
+
+inline Uint8 paletteIndex(const Palette &palette, Uint32 color)
+{
+    const Uint8 *bytes = (const Uint8 *)&color;
+    if(bytes[3] == 0)
+        return paletteTransparent;
+    return palette.nearest[paletteCell(bytes[0], bytes[1], bytes[2])];
+}
+
+//box of histogram cells for the median cut
+struct Palette_Box{
+    std::vector<int> cells;
+    Uint64 count = 0;
+    int longest = 0; //channel with the widest spread, 0 r 1 g 2 b
+    int spread = 0;
+};
+
+inline int paletteChannel(int cell, int channel)
+{
+    const int mask = (1 << paletteCubeBits) - 1;
+    return (cell >> ((2 - channel) * paletteCubeBits)) & mask;
+}
+
+void measurePaletteBox(Palette_Box &box, const std::vector<Uint32> &histogram)
+{
+    int low[3] = {255, 255, 255}, high[3] = {0, 0, 0};
+    box.count = 0;
+    for(std::size_t i = 0; i < box.cells.size(); i++)
+    {
+        box.count += histogram[box.cells[i]];
+        for(int c = 0; c < 3; c++)
+        {
+            low[c] = std::min(low[c], paletteChannel(box.cells[i], c));
+            high[c] = std::max(high[c], paletteChannel(box.cells[i], c));
+        }
+    }
+    box.spread = -1;
+    for(int c = 0; c < 3; c++)
+    {
+        if(high[c] - low[c] > box.spread)
+        {
+            box.spread = high[c] - low[c];
+            box.longest = c;
+        }
+    }
+}
+
+//median cut over every texel of the full size images, then a nearest color table over the whole 15 bit cube.
+//fog and the dark side of walls need darker colors than the textures have, so each texel is also counted at
+//paletteShades steps down towards black
+void buildPalette(Palette &palette, const std::vector<const Texel_Mips *> &images)
+{
+    const int cells = 1 << (3 * paletteCubeBits);
+    std::vector<Uint32> histogram(cells, 0);
+    Uint32 texels = 0;
+    for(std::size_t i = 0; i < images.size(); i++)
+    {
+        const Texel_Image &image = images[i]->levels[0];
+        for(std::size_t t = 0; t < image.texels.size(); t++)
+        {
+            const Uint8 *bytes = (const Uint8 *)&image.texels[t];
+            if(bytes[3] == 0)
+                continue;
+            texels++;
+            for(int shade = paletteShades; shade > 0; shade--)
+                histogram[paletteCell(bytes[0] * shade / paletteShades, bytes[1] * shade / paletteShades, bytes[2] * shade / paletteShades)]++;
+        }
+    }
+    histogram[0] += texels; //and black itself, where fog is thickest
+
+    std::vector<Palette_Box> boxes(1);
+    for(int cell = 0; cell < cells; cell++)
+        if(histogram[cell] > 0)
+            boxes[0].cells.push_back(cell);
+    measurePaletteBox(boxes[0], histogram);
+    //split the box with the most texels times spread at its median along its widest channel
+    while(boxes.size() < 255)
+    {
+        int split = -1;
+        Uint64 best = 0;
+        for(std::size_t i = 0; i < boxes.size(); i++)
+        {
+            Uint64 score = boxes[i].count * (Uint64)boxes[i].spread;
+            if(boxes[i].cells.size() > 1 && boxes[i].spread > 0 && score >= best)
+            {
+                best = score;
+                split = i;
+            }
+        }
+        if(split < 0)
+            break;
+        Palette_Box &box = boxes[split];
+        const int channel = box.longest;
+        std::sort(box.cells.begin(), box.cells.end(), [channel](int a, int b) { return paletteChannel(a, channel) < paletteChannel(b, channel); });
+        Uint64 half = 0;
+        std::size_t cut = 0;
+        while(cut < box.cells.size() - 1 && half + histogram[box.cells[cut]] <= box.count / 2)
+            half += histogram[box.cells[cut++]];
+        cut = std::max<std::size_t>(cut, 1);
+        Palette_Box upper;
+        upper.cells.assign(box.cells.begin() + cut, box.cells.end());
+        box.cells.resize(cut);
+        measurePaletteBox(box, histogram);
+        measurePaletteBox(upper, histogram);
+        boxes.push_back(upper);
+    }
+
+    const int drop = 8 - paletteCubeBits;
+    palette.colors[paletteTransparent] = packRGBA(0, 0, 0, 0);
+    palette.r[paletteTransparent] = palette.g[paletteTransparent] = palette.b[paletteTransparent] = 0;
+    palette.count = 1;
+    for(std::size_t i = 0; i < boxes.size(); i++)
+    {
+        if(boxes[i].count == 0)
+            continue;
+        //texel weighted average, from the middle of each cell
+        Uint64 sum[3] = {0, 0, 0};
+        for(std::size_t c = 0; c < boxes[i].cells.size(); c++)
+            for(int channel = 0; channel < 3; channel++)
+                sum[channel] += (Uint64)histogram[boxes[i].cells[c]] * ((paletteChannel(boxes[i].cells[c], channel) << drop) + (1 << drop) / 2);
+        int index = palette.count++;
+        palette.r[index] = sum[0] / boxes[i].count;
+        palette.g[index] = sum[1] / boxes[i].count;
+        palette.b[index] = sum[2] / boxes[i].count;
+        palette.colors[index] = packRGBA(palette.r[index], palette.g[index], palette.b[index], 0xFF);
+    }
+    for(int index = palette.count; index < 256; index++)
+    {
+        palette.r[index] = palette.g[index] = palette.b[index] = 0;
+        palette.colors[index] = packRGBA(0, 0, 0, 0xFF);
+    }
+
+    palette.nearest.resize(cells);
+    for(int cell = 0; cell < cells; cell++)
+    {
+        int r = (paletteChannel(cell, 0) << drop) + (1 << drop) / 2;
+        int g = (paletteChannel(cell, 1) << drop) + (1 << drop) / 2;
+        int b = (paletteChannel(cell, 2) << drop) + (1 << drop) / 2;
+        int best = 1, bestDist = 1 << 30;
+        for(int index = 1; index < palette.count; index++)
+        {
+            int dr = r - palette.r[index], dg = g - palette.g[index], db = b - palette.b[index];
+            int dist = dr * dr + dg * dg + db * db;
+            if(dist < bestDist)
+            {
+                bestDist = dist;
+                best = index;
+            }
+        }
+        palette.nearest[cell] = best;
+    }
+}
+
+//fill the indices of every level of an image. same layout as its texels so the same index tables find them
+void paletteTexels(Texel_Mips &mips, const Palette &palette)
+{
+    for(std::size_t level = 0; level < mips.levels.size(); level++)
+    {
+        Texel_Image &image = mips.levels[level];
+        image.indices.resize(image.texels.size());
+        for(std::size_t t = 0; t < image.texels.size(); t++)
+            image.indices[t] = paletteIndex(palette, image.texels[t]);
+    }
+}
+
+//start of one texture column of indices, only valid for TEXELS_COLUMNS images
+inline const Uint8 *indexColumn(const Texel_Image &image, int x)
+{
+    return &image.indices[image.xIndex[x]];
+}
+
+//colormaps for one fog color, 2 * paletteFogLevels maps of 256 entries. transparent stays transparent
+void buildColormaps(std::vector<Uint8> &maps, const Palette &palette, SDL_Color fog)
+{
+    maps.resize(2 * paletteFogLevels * 256);
+    for(int dark = 0; dark < 2; dark++)
+    {
+        for(int level = 0; level < paletteFogLevels; level++)
+        {
+            Uint8 *map = &maps[(dark * paletteFogLevels + level) * 256];
+            const int fogWeight = level * 256 / (paletteFogLevels - 1);
+            map[paletteTransparent] = paletteTransparent;
+            for(int index = 1; index < 256; index++)
+            {
+                int r = palette.r[index] >> dark, g = palette.g[index] >> dark, b = palette.b[index] >> dark;
+                r = (r * (256 - fogWeight) + fog.r * fogWeight) >> 8;
+                g = (g * (256 - fogWeight) + fog.g * fogWeight) >> 8;
+                b = (b * (256 - fogWeight) + fog.b * fogWeight) >> 8;
+                map[index] = palette.nearest[paletteCell(r, g, b)];
+            }
+        }
+    }
+}
+
+inline const Uint8 *colormap(const std::vector<Uint8> &maps, int dark, int level)
+{
+    return &maps[(dark * paletteFogLevels + level) * 256];
+}
+
+//expand a row of indices to RGBA32
+inline void expandIndices(const Palette &palette, const Uint8 *indices, Uint32 *pixels, int count)
+{
+    for(int i = 0; i < count; i++)
+        pixels[i] = palette.colors[indices[i]];
+}
+#endif
@@ -0,0 +1,110 @@
+#ifndef RAY_PRECISION_H
+#define RAY_PRECISION_H
+#include <SDL2/SDL.h>
+#include <cmath>
+#include <climits>
+
+//number type of the hot loops, picked at compile time. RAY_PRECISION covers the DDA and wall texture coordinates,
+//FLOOR_PRECISION the floor and ceiling stepping. build with -DRAY_PRECISION=PRECISION_FLOAT and so on.
+//everything around them stays double, the loops convert at their edges. --precision-report measures what the
+//narrower types get wrong against double whatever this build uses
+#define PRECISION_DOUBLE 0
+#define PRECISION_FLOAT 1
+#define PRECISION_FIXED 2 //16.16 fixed point, see Fixed16
+
+#ifndef RAY_PRECISION
+#define RAY_PRECISION PRECISION_DOUBLE
+#endif
+#ifndef FLOOR_PRECISION
+#define FLOOR_PRECISION PRECISION_FLOAT
+#endif
+
+//signed 16.16 fixed point. range is about +-32767, results that don't fit saturate instead of wrapping,
+//so the 1e30 "never" distances of the DDA become 32767 and still compare as far
+struct Fixed16{
+    Sint32 raw = 0;
+
+    Fixed16() {}
+    Fixed16(int value) : raw(saturate((Sint64)value * 65536)) {}
+    Fixed16(double value) : raw(saturate(value * 65536.0)) {}
+
+    static Sint32 saturate(Sint64 value)
+    {
+        return value > INT_MAX ? INT_MAX : value < INT_MIN ? INT_MIN : (Sint32)value;
+    }
+    static Sint32 saturate(double value)
+    {
+        return value >= (double)INT_MAX ? INT_MAX : value <= (double)INT_MIN ? INT_MIN : (Sint32)value;
+    }
+    static Fixed16 fromRaw(Sint64 value)
+    {
+        Fixed16 result;
+        result.raw = saturate(value);
+        return result;
+    }
+};
+
+inline Fixed16 operator+(Fixed16 a, Fixed16 b) { return Fixed16::fromRaw((Sint64)a.raw + b.raw); }
+inline Fixed16 operator-(Fixed16 a, Fixed16 b) { return Fixed16::fromRaw((Sint64)a.raw - b.raw); }
+inline Fixed16 operator-(Fixed16 a) { return Fixed16::fromRaw(-(Sint64)a.raw); }
+inline Fixed16 operator*(Fixed16 a, Fixed16 b) { return Fixed16::fromRaw(((Sint64)a.raw * b.raw) >> 16); }
+inline Fixed16 operator/(Fixed16 a, Fixed16 b)
+{
+    if(b.raw == 0)
+        return Fixed16::fromRaw(a.raw < 0 ? INT_MIN : INT_MAX);
+    return Fixed16::fromRaw(((Sint64)a.raw * 65536) / b.raw);
+}
+inline Fixed16 &operator+=(Fixed16 &a, Fixed16 b) { return a = a + b; }
+inline Fixed16 &operator-=(Fixed16 &a, Fixed16 b) { return a = a - b; }
+inline bool operator<(Fixed16 a, Fixed16 b) { return a.raw < b.raw; }
+inline bool operator>(Fixed16 a, Fixed16 b) { return a.raw > b.raw; }
+inline bool operator<=(Fixed16 a, Fixed16 b) { return a.raw <= b.raw; }
+inline bool operator>=(Fixed16 a, Fixed16 b) { return a.raw >= b.raw; }
+inline bool operator==(Fixed16 a, Fixed16 b) { return a.raw == b.raw; }
+inline bool operator!=(Fixed16 a, Fixed16 b) { return a.raw != b.raw; }
+
+//the few functions the loops need, for every type
+inline double realToDouble(double value) { return value; }
+inline double realToDouble(float value) { return value; }
+inline double realToDouble(Fixed16 value) { return value.raw / 65536.0; }
+inline int realToInt(double value) { return (int)value; } //truncates, like the casts it replaces
+inline int realToInt(float value) { return (int)value; }
+inline int realToInt(Fixed16 value) { return value.raw < 0 ? -(int)((-(Sint64)value.raw) >> 16) : value.raw >> 16; }
+inline double realAbs(double value) { return std::abs(value); }
+inline float realAbs(float value) { return std::abs(value); }
+inline Fixed16 realAbs(Fixed16 value) { return value.raw < 0 ? -value : value; }
+inline double realFloor(double value) { return std::floor(value); }
+inline float realFloor(float value) { return std::floor(value); }
+inline Fixed16 realFloor(Fixed16 value) { return Fixed16::fromRaw((Sint64)(value.raw & ~0xFFFF)); }
+inline double realLength(double x, double y) { return std::sqrt(x * x + y * y); }
+inline double realLength(float x, float y) { return std::sqrt(x * x + y * y); }
+inline double realLength(Fixed16 x, Fixed16 y) { return std::sqrt(realToDouble(x) * realToDouble(x) + realToDouble(y) * realToDouble(y)); }
+
+template<int precision> struct Precision_Type { typedef double type; };
+template<> struct Precision_Type<PRECISION_FLOAT> { typedef float type; };
+template<> struct Precision_Type<PRECISION_FIXED> { typedef Fixed16 type; };
+
+typedef Precision_Type<RAY_PRECISION>::type Ray_Real;
+typedef Precision_Type<FLOOR_PRECISION>::type Floor_Real;
+
+//what --precision-report counts for one type against the double reference
+struct Precision_Stats{
+    Uint64 columns = 0;
+    Uint64 wrongCell = 0; //ray stopped in another cell
+    Uint64 wrongSide = 0; //right cell, other face
+    Uint64 wrongSpan = 0; //wall drawn over different rows
+    Uint64 wrongTexX = 0; //right wall, other texture column
+    Uint64 seams = 0; //single columns wrong between two right ones, the kind that shows as a line
+    Uint64 doorColumns = 0; //columns whose reference ray stopped on a part open door. kept out of the counts above
+    Uint64 wrongDoor = 0; //door columns with another cell, side or texture column
+    double maxDistError = 0; //wallDist, blocks
+    double maxRelError = 0;
+    Uint64 floorPixels = 0;
+    Uint64 wrongFloor = 0; //floor or ceiling texel differs
+};
+
+inline const char *precisionName(int precision)
+{
+    return precision == PRECISION_FLOAT ? "float" : precision == PRECISION_FIXED ? "16.16 fixed" : "double";
+}
+#endif
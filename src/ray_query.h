@@ -0,0 +1,366 @@
+#ifndef RAY_QUERY_H
+#define RAY_QUERY_H
+#include <SDL2/SDL.h>
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include "blocktypes.h"
+#include "game_sprites.h"
+#include "worker_pool.h"
+#include "ray_precision.h"
+
+//grid ray casting. castRay is the DDA the renderer uses for every screen column, the rest of this file runs
+//the same traversal for arbitrary rays in batches: line of sight, hitscan, anything that asks what a ray hits first
+
+const double rayNoLimit = 1e30; //maxDist for rays that only stop at a wall
+
+//result of a single DDA ray through the map
+struct Ray_Hit{
+    double dist = 0; //perpendicular distance to the wall that was hit, or how far the ray got if nothing was
+    int side = 0; //0 for a NS wall, 1 for an EW wall
+    int mapX = 0;
+    int mapY = 0; //map block that was hit
+    int face = 0; //WALL_DIR of the face that was hit, same as the wall texture that gets drawn
+    bool found = false; //false if the ray ran past maxDist or off the map first
+    int steps = 0; //cells the walk stepped through
+};
+
+struct No_Cell_Visitor{
+    void operator()(int mapX, int mapY) {}
+};
+
+struct Trail_Cell{
+    int x = 0;
+    int y = 0;
+    bool operator==(const Trail_Cell &other) const { return x == other.x && y == other.y; }
+};
+
+//keeps every cell a ray passes through, in order
+struct Cell_Trail{
+    std::vector<Trail_Cell> &cells;
+    Cell_Trail(std::vector<Trail_Cell> &cells) : cells(cells) {}
+    void operator()(int mapX, int mapY)
+    {
+        Trail_Cell cell;
+        cell.x = mapX;
+        cell.y = mapY;
+        cells.push_back(cell);
+    }
+};
+
+//dist is measured in multiples of the ray direction, so it's the perpendicular wall distance for screen rays
+//and the real distance for unit length directions. visit is called with the start cell and every cell the ray
+//enters, the hit cell included, so callers can look for things that live in cells along the way
+template<typename Real, typename Cell_Visitor>
+void castRayAs(const std::vector<std::vector<Map_Block>> &level, double startX, double startY, double dirX, double dirY, Ray_Hit &hit, double maxDistance, Cell_Visitor &visit)
+{
+    //the whole walk runs in Real, see ray_precision.h
+    const Real originX = startX, originY = startY, rayDirX = dirX, rayDirY = dirY, maxDist = maxDistance;
+    Real sideDistX, sideDistY, deltaDistX, deltaDistY, perpWallDist = 0;
+    int stepX, stepY, mapX, mapY, side = 0, steps = 0;
+    bool found = false;
+    const int width = level.size();
+    const int height = width > 0 ? level[0].size() : 0;
+
+    //which box of the map we're in
+    mapX = int(std::floor(startX));
+    mapY = int(std::floor(startY));
+
+    //length of ray from one x or y-side to next x or y-side
+    //a ray parallel to an axis never crosses that axis' sides
+    deltaDistX = (rayDirX == Real(0)) ? Real(1e30) : realAbs(Real(1) / rayDirX); //the x component of a vector in the player's viewing direction that spans exactly across 1 map block side to side
+    deltaDistY = (rayDirY == Real(0)) ? Real(1e30) : realAbs(Real(1) / rayDirY); //y component of that vector
+
+    //calculate step and initial sideDist
+    if (rayDirX < Real(0))
+    {
+        stepX = -1; //facing left, step left (decrement) through map matrix x
+        sideDistX = (originX - mapX) * deltaDistX; // x component of viewing distance vector to nearest wall
+                                                //calculated by getting our fractional perpendicular offset from the closest wall, times the x component
+                                                //of the length of the vector in our viewing direction that spans exactly 1 whole map block side-to-side
+    }
+    else
+    {
+        stepX = 1; //step right (increment) through map matrix x
+        sideDistX = (mapX + Real(1.0) - originX) * deltaDistX; // x component of distance vector to nearest wall
+    }
+    if (rayDirY < Real(0))
+    {
+        stepY = -1; //facing up, step up (decrement) through map matrix y
+        sideDistY = (originY - mapY) * deltaDistY; //y component of distance vector to nearest wall
+    }
+    else
+    {
+        stepY = 1; //facing down, step down (increment) through map matrix y
+        sideDistY = (mapY + Real(1.0) - originY) * deltaDistY; //y component of distance to nearest wall
+    }
+
+    if(mapX >= 0 && mapY >= 0 && mapX < width && mapY < height)
+        visit(mapX, mapY);
+
+    //perform DDA
+    while (!found)
+    {
+        //jump to next map square in x-direction, OR in y-direction
+        if (sideDistX < sideDistY)
+        {
+            perpWallDist = sideDistX; //how far the ray has got, in case it stops here
+            sideDistX += deltaDistX;
+            mapX += stepX;
+            side = 0;
+        }
+        else
+        {
+            perpWallDist = sideDistY;
+            sideDistY += deltaDistY;
+            mapY += stepY;
+            side = 1;
+        }
+        steps++;
+        if(perpWallDist > maxDist || mapX < 0 || mapY < 0 || mapX >= width || mapY >= height)
+        {
+            perpWallDist = std::min(perpWallDist, maxDist);
+            break;
+        }
+        visit(mapX, mapY);
+        //Check if ray has hit a wall
+        const Map_Block &block = level[mapX][mapY];
+        if (block.visible)
+        {
+            if(block.isDoor) //sliding door, so check if the door is blocking or not
+            {
+                Real wallX, checkDist;
+
+                if (side == 0) //NS wall
+                {
+                    perpWallDist = (mapX + (Real(stepX) * Real(0.5)) - originX + (1 - stepX) / 2) / rayDirX;
+
+                    checkDist = (mapY + stepY - originY + (1 - stepY) / 2) / rayDirY;
+
+                    wallX = originY + perpWallDist * rayDirY;
+                }
+                else  //EW wall
+                {
+                    perpWallDist = (mapY + (Real(stepY) * Real(0.5)) - originY + (1 - stepY) / 2) / rayDirY;
+
+                    checkDist = (mapX + stepX - originX + (1 - stepX) / 2) / rayDirX;
+
+                    wallX = originX + perpWallDist * rayDirX;
+                }
+                wallX -= realFloor(wallX); //we've determined the where (0 to 1) across the wall that we hit
+                                        //compare that to this wall's timer to see if we hit or keep going
+
+                if(checkDist > perpWallDist)
+                if(wallX <= Real(block.timer))
+                {
+                    found = perpWallDist <= maxDist;
+                    if(!found)
+                    {
+                        perpWallDist = maxDist;
+                        break;
+                    }
+                }
+            }
+            else //not a sliding door, definitely a hit
+            {
+                found = true;
+
+                //Calculate distance to wall projected on camera direction (Euclidean distance will give fisheye effect!)
+                if (side == 0)
+                {
+                    perpWallDist = (mapX - originX + (1 - stepX) / 2);
+                    perpWallDist = perpWallDist / rayDirX;
+                }
+                else
+                {
+                    perpWallDist = (mapY - originY + (1 - stepY) / 2);
+                    perpWallDist = perpWallDist / rayDirY;
+                }
+            }
+        }
+    }
+    hit.dist = realToDouble(perpWallDist);
+    hit.side = side;
+    hit.mapX = mapX;
+    hit.mapY = mapY;
+    hit.found = found;
+    hit.steps = steps;
+    if (side == 1)
+        hit.face = stepY > 0 ? NORTH : SOUTH;
+    else
+        hit.face = stepX < 0 ? EAST : WEST;
+}
+
+template<typename Cell_Visitor>
+void castRay(const std::vector<std::vector<Map_Block>> &level, double originX, double originY, double rayDirX, double rayDirY, Ray_Hit &hit, double maxDist, Cell_Visitor &visit)
+{
+    castRayAs<Ray_Real>(level, originX, originY, rayDirX, rayDirY, hit, maxDist, visit);
+}
+
+inline void castRay(const std::vector<std::vector<Map_Block>> &level, double originX, double originY, double rayDirX, double rayDirY, Ray_Hit &hit, double maxDist = rayNoLimit)
+{
+    No_Cell_Visitor visit;
+    castRay(level, originX, originY, rayDirX, rayDirY, hit, maxDist, visit);
+}
+
+struct Ray_Query{
+    double originX = 0;
+    double originY = 0;
+    double dirX = 1;
+    double dirY = 0; //doesn't need to be normalized, results are in world units either way
+    double maxDist = rayNoLimit;
+    int ignoreSprite = -1; //sprite the ray starts from, so a sprite's own line of sight doesn't hit itself
+};
+
+struct Ray_Query_Hit{
+    Ray_Hit wall; //wall.found is false when nothing blocks the ray before maxDist
+    int sprite = -1; //index of the first sprite in front of the wall, -1 for none or when sprites weren't asked for
+    double spriteDist = 0;
+};
+
+//a batch of rays cast against one level. reuse the same batch every tick so nothing gets reallocated:
+//fill queries, call castRayBatch, read hits in the same order
+struct Ray_Query_Batch{
+    const std::vector<std::vector<Map_Block>> *level = NULL;
+    const std::vector<Game_Sprite> *sprites = NULL; //NULL skips sprite tests
+    std::vector<Ray_Query> queries;
+    std::vector<Ray_Query_Hit> hits;
+
+    //sprites bucketed by the cells they overlap, rebuilt once per castRayBatch. a ray only tests sprites in cells it walks
+    //through. cellFirst stays -1 everywhere between batches, only the touched cells get reset
+    int width = 0;
+    int height = 0;
+    std::vector<int> cellFirst; //first entry for each cell, -1 for none
+    std::vector<int> touchedCells;
+    std::vector<int> entrySprite; //sprite index of each entry
+    std::vector<int> entryNext; //next entry in the same cell, -1 ends the list
+};
+
+const int rayQueryChunk = 256; //rays per worker job. small batches run on the calling thread only
+
+//finds the nearest sprite a ray passes through. sprites are billboards that always face the viewer,
+//so from any angle each one covers a disc of its width around its position
+struct Ray_Sprite_Visitor{
+    const Ray_Query_Batch &batch;
+    const Ray_Query &query;
+    double dirX, dirY; //normalized
+    int sprite = -1;
+    double spriteDist = rayNoLimit;
+
+    Ray_Sprite_Visitor(const Ray_Query_Batch &batch, const Ray_Query &query, double dirX, double dirY)
+        : batch(batch), query(query), dirX(dirX), dirY(dirY) {}
+
+    void operator()(int mapX, int mapY)
+    {
+        for(int entry = batch.cellFirst[mapX + mapY * batch.width]; entry >= 0; entry = batch.entryNext[entry])
+        {
+            int index = batch.entrySprite[entry];
+            if(index == query.ignoreSprite)
+                continue;
+            const Game_Sprite &target = (*batch.sprites)[index];
+            double radius = target.width * 0.5;
+            double toX = target.worldX - query.originX;
+            double toY = target.worldY - query.originY;
+            double along = toX * dirX + toY * dirY;
+            double missSq = toX * toX + toY * toY - along * along;
+            if(missSq > radius * radius)
+                continue;
+            double enter = std::max(0.0, along - std::sqrt(radius * radius - missSq));
+            if(along >= 0 && enter < spriteDist)
+            {
+                sprite = index;
+                spriteDist = enter;
+            }
+        }
+    }
+};
+
+void castRayQuery(const Ray_Query_Batch &batch, const Ray_Query &query, Ray_Query_Hit &result)
+{
+    double length = std::sqrt(query.dirX * query.dirX + query.dirY * query.dirY);
+    result.sprite = -1;
+    result.spriteDist = 0;
+    if(length == 0)
+    {
+        result.wall = Ray_Hit();
+        return;
+    }
+    double dirX = query.dirX / length;
+    double dirY = query.dirY / length;
+    if(batch.sprites == NULL || batch.entrySprite.empty())
+    {
+        castRay(*batch.level, query.originX, query.originY, dirX, dirY, result.wall, query.maxDist);
+        return;
+    }
+    Ray_Sprite_Visitor visit(batch, query, dirX, dirY);
+    castRay(*batch.level, query.originX, query.originY, dirX, dirY, result.wall, query.maxDist, visit);
+    //cells are visited whole, so a sprite straddling the hit wall or maxDist can still turn up past it
+    if(visit.sprite >= 0 && visit.spriteDist <= result.wall.dist)
+    {
+        result.sprite = visit.sprite;
+        result.spriteDist = visit.spriteDist;
+    }
+}
+
+void bucketRaySprites(Ray_Query_Batch &batch)
+{
+    const std::vector<std::vector<Map_Block>> &level = *batch.level;
+    int width = level.size();
+    int height = width > 0 ? level[0].size() : 0;
+    if(width != batch.width || height != batch.height)
+    {
+        batch.width = width;
+        batch.height = height;
+        batch.cellFirst.assign((std::size_t)width * height, -1);
+        batch.touchedCells.clear();
+    }
+    for(std::size_t i = 0; i < batch.touchedCells.size(); i++)
+        batch.cellFirst[batch.touchedCells[i]] = -1;
+    batch.touchedCells.clear();
+    batch.entrySprite.clear();
+    batch.entryNext.clear();
+    if(batch.sprites == NULL)
+        return;
+    for(std::size_t i = 0; i < batch.sprites->size(); i++)
+    {
+        const Game_Sprite &target = (*batch.sprites)[i];
+        double radius = target.width * 0.5;
+        int x0 = std::max(0, (int)std::floor(target.worldX - radius)), x1 = std::min(width - 1, (int)std::floor(target.worldX + radius));
+        int y0 = std::max(0, (int)std::floor(target.worldY - radius)), y1 = std::min(height - 1, (int)std::floor(target.worldY + radius));
+        for(int y = y0; y <= y1; y++)
+        {
+            for(int x = x0; x <= x1; x++)
+            {
+                int cell = x + y * width;
+                if(batch.cellFirst[cell] < 0)
+                    batch.touchedCells.push_back(cell);
+                batch.entryNext.push_back(batch.cellFirst[cell]);
+                batch.entrySprite.push_back(i);
+                batch.cellFirst[cell] = batch.entrySprite.size() - 1;
+            }
+        }
+    }
+}
+
+void rayQueryJob(void *data, int index)
+{
+    Ray_Query_Batch &batch = *(Ray_Query_Batch *)data;
+    int end = std::min<int>(batch.queries.size(), (index + 1) * rayQueryChunk);
+    for(int i = index * rayQueryChunk; i < end; i++)
+        castRayQuery(batch, batch.queries[i], batch.hits[i]);
+}
+
+//cast every query in the batch. with a pool, large batches are split across its threads. the level and sprites
+//must not change until this returns
+void castRayBatch(Ray_Query_Batch &batch, Worker_Pool *pool)
+{
+    batch.hits.resize(batch.queries.size());
+    bucketRaySprites(batch);
+    int chunks = (batch.queries.size() + rayQueryChunk - 1) / rayQueryChunk;
+    if(pool != NULL && !pool->threads.empty() && chunks > 1)
+        runWorkerPool(*pool, rayQueryJob, &batch, chunks);
+    else
+        for(int i = 0; i < chunks; i++)
+            rayQueryJob(&batch, i);
+}
+#endif
@@ -1,5 +1,6 @@
 #include <SDL2/SDL.h> //SDL main library functions
 #include <cmath>
+#include <cstdlib>
 #include <algorithm>
 #include <vector>
 #include <string>
@@ -10,16 +11,37 @@
 #include <iomanip>
 #include "blocktypes.h" //world map blocks
 #include "game_sprites.h" //objects
+#include "sim_state.h" //fixed tick simulation state and snapshots
+#include "frame_slot.h" //per frame buffers for the render pipeline
+#include "input_latency.h" //input to present latency stats
+#include "texel_store.h" //cpu copies of image pixels
+#include "sprite_atlas.h" //all sprite images in one texture
+#include "level_gen.h" //seeded random maps
+#include "world_snapshot.h" //in memory world save and reset
+#include "frame_capture.h" //session recording
+#include "world_context.h" //many worlds stepped together for agents
+#include "ray_query.h" //grid ray casts, single and batched
+#include "palette.h" //8 bit textures and light colormaps
+#include "cpu_dispatch.h" //per instruction set copies of the fog kernel
+#include "task_graph.h" //work stealing scheduler for the passes of a frame
+#include "memory_stats.h" //bytes held per subsystem
+#include "telemetry.h" //live stats in shared memory for outside monitors
+#include "golden_images.h" //reference frames and times for regression checks
+#include "asset_loader.h" //image decoding split from texture creation
+#include "loading_splash.xpm" //shown while the assets load
 
 //some constants for handling files on different operating systems
 #ifdef _WIN32
+    #include <windows.h> //FindFirstFile for listing maps
     const char PATH_SYM = '\\';
 #else
+    #include <dirent.h> //opendir for listing maps
     const char PATH_SYM = '/';
 #endif
 
 //some const values for our screen resolution
 bool debugColors = false; //toggle rendering textures or just draw world geometry with plain colors
+bool mipmapsOn = true; //sample smaller copies of wall and floor textures for far away surfaces
 bool ceilingOn = false; //toggle drawing ceiling tiles or skybox when textures are turned on
 bool enableInput = false; //can temporarily turn off player input (does not affect most debug hotkeys)
 
@@ -39,7 +61,19 @@ double playerFog = 1.0; // 0 - 1. 0 is thickest, 1 is non-existent. Fog density
 double fogMultiplier = 1; // Multiplied by distance from player. Adjusts the distance at which the fog transitions from player to global levels
 SDL_Color fogColor = {0,0,0,0}; // RGBA values for fog. Alpha is ignored and determined by the above values
 bool fogOn = false; //toggled fog effect on/off for performance
+int graycastMode = RAYCAST_COLUMNS; //set with --raycast
+const int raycastStride = 8; //columns between full rays in RAYCAST_SUBSAMPLE
+bool floorInterlaceOn = false; //set with --floor-interlace
+const double floorReprojectMaxMove = 0.25; //blocks the camera can move between frames before the floor is cast in full again
+const double floorReprojectMaxTurn = 0.035; //radians the camera can turn between frames before the floor is cast in full again, about 2 degrees
+const int floorReprojectSpan = 32; //columns of a reprojected row that share one source row
+bool gpaletteOn = false; //8 bit rendering, set with --palette
+Palette gpalette; //shared by every wall, floor and ceiling texture when gpaletteOn
+double maxRayDist = rayNoLimit; //furthest a ray is cast, set with --max-ray-dist. fog can bring it closer, see fogClipDist
+const double fogClipBrightness = 1.0 / 255; //fog brightness where a wall no longer changes a pixel
+const double minClipDist = 0.25; //keeps walls at the clip distance a sane height on screen
 double brightSin[gscreenWidth]; //fog distance is in relation to viewing plane
+double invBrightSin[gscreenWidth]; //1 / brightSin, for the per pixel fog of the 8 bit path
                                 //this lookup table is used to curve it and give better effect
 
 //some color values for convenience
@@ -99,8 +133,6 @@ double planeX = 0, planeY = 1;
 double posX = 2, posY = 2;         //x and y start position, overridden during map load
 double dirX = std::tan((hFOV * degToRad)/2), dirY = 0;         //initial direction vector is east (0 degrees)
 
-double moveSpeed = 0; //multiplier for frame rate independent movement speed
-
 double viewTrip = 0.0; //fun effect to stretch and curve floor/ceiling. totally useless. fun side effect of trying to get floor casting math right
 
 double blockAheadDist = 500; //distance to the nearest block straight ahead of player. reset durign each raycast calculation loop
@@ -110,6 +142,7 @@ int blockRightX = 0, blockRightY = 0; //block furthest right that's on screen. u
 
 double mouseSense = 0.25; //horizontal mouse sensitivity multiplier
 double mouseVertSense = 0.75; //vertical mouse sensitivity multiplier
+const double mouseTurnScale = 1.0 / 30.0; //radians turned per mouse count at mouseSense 1. matches the old per frame turn rate at 60fps
 
 //some numbers for frame time calculation. used for frame rate independence and performance calculations
 Uint64 oldtime = 0;
@@ -117,6 +150,33 @@ Uint64 gtime = 0;
 Uint64 gDeltaTimer = 0;
 unsigned int framecounter = 0;
 
+//fixed tick simulation. player movement, collision, doors and sprites are stepped on their own thread
+//and published as snapshots. the render side interpolates between the last two and never touches gsim
+int simTickRate = 120; //sim ticks per second
+Sim_World gsim; //owned by the sim thread while it runs. hold gsimWorldLock to touch it from anywhere else
+Sim_Input gsimInput; //input collected since the last tick
+Sim_Snapshot gsimPrev; //second newest published tick
+Sim_Snapshot gsimCurr; //newest published tick
+std::vector<Door_State> gsimPendingDoors; //door changes published but not yet applied to leveldata
+bool gsimExitPending = false; //sim saw the player use an exit panel
+SDL_Thread *gsimThread = NULL;
+SDL_mutex *gsimWorldLock = NULL; //held by the sim thread for the duration of each tick
+SDL_mutex *gsimInputLock = NULL; //guards gsimInput
+SDL_mutex *gsimSnapLock = NULL; //guards gsimPrev, gsimCurr, gsimPendingDoors and gsimExitPending
+SDL_atomic_t gsimQuit; //set to 1 to stop the sim thread
+
+//late latch and latency tracking. mouse look the sim hasn't consumed yet is applied to the camera right before
+//each frame is raycast, so turning doesn't wait for the next tick plus a tick of interpolation
+bool lateLatchOn = true;
+Uint64 ginputSeq = 0; //sequence number of the newest input read on the main thread
+Uint64 gsimViewSeq = 0; //newest input reflected by the snapshot the view was built from
+Sint64 gsimViewMouseX = 0;
+Sint64 gsimViewMouseY = 0; //mouse totals reflected by that snapshot's camera. lateLatchView adds anything past them
+Input_Latency glookLatency; //mouse look. on screen as soon as a latched frame is presented
+Input_Latency gmoveLatency; //keys and buttons. on screen once the sim has applied them
+Uint64 glatencyReportTime = 0;
+const double latencyReportInterval = 10.0; //seconds between latency printouts
+
 //game window
 SDL_Window *gwindow = NULL;
 
@@ -130,12 +190,34 @@ SDL_Texture *gceilTex = NULL; //ceiling texture
 SDL_Texture *gfloorBuffer = NULL; //buffer texture. calculated perspective mapping of the floor and ceiling will be plotted onto this buffer
 SDL_Texture *gfogTex = NULL; //buffer texture. calculated fog will be plotted onto this texture
 SDL_Texture *weaponTex = NULL; //current player weapon (from first person perspective)
-SDL_Texture **pickupTex = NULL;
-SDL_Texture **maskTex = NULL;
+Sprite_Atlas gspriteAtlas; //every pickup image and its fog mask
 
 const int totalWallTextures = 3; //number of unique wall textures. needs to be read from a config or dynamically calculated
 const int totalPickupTextures = 4;
 
+//cpu side copies of every image the frame thread samples, so it never has to call into the renderer
+Texel_Mips gwallTexels[totalWallTextures]; //column major
+Texel_Mips gfloorTexels; //z-order
+Texel_Mips gceilTexels; //z-order
+SDL_PixelFormat *gpixelFormat = NULL; //RGBA32 format, used to build fog colors
+
+//frame pipeline. the frame thread raycasts and fills the pixel buffers of one slot
+//while the main thread uploads, draws and presents the other
+Frame_Slot gframes[2];
+int gframeReady = -1; //slot that's finished and waiting to be presented. -1 if none
+int gframeJob = -1; //slot the frame thread is filling. -1 when it's idle
+bool gframeForceFull = true; //texture rows don't match either slot, next frame uploads every row
+bool gframeQuit = false;
+Uint64 gframeCount = 0;
+SDL_Thread *gframeThread = NULL;
+SDL_mutex *gframeLock = NULL; //guards gframeJob and gframeQuit
+SDL_cond *gframeCond = NULL; //signalled whenever a job starts or finishes
+Task_Scheduler gframeScheduler; //threads renderFrame spreads its passes over. none with --frame-threads 1
+Task_Graph gframeGraph;
+Frame_Tasks gframeTasks;
+int gframeThreads = 0; //threads in gframeScheduler, the frame thread included. 0 uses every cpu
+const int frameTaskBands = 16; //column and row bands per pass, enough that a slow band can be evened out
+
 SDL_Rect gskyDestRect; //used for skybox. where (on screen) to draw the skybox
 SDL_Rect gskySrcRect; //used for skybox. where (on skybox texture) to grab current skybox from
 SDL_Rect gfloorRect; //only used for debug colors. determines where to draw floor color on screen
@@ -146,52 +228,216 @@ SDL_Rect weaponDestRect; //where (on screen) to draw weapon
 std::stringstream ssFPS; //string for window title. currently used for debug info (FPS, FOV, etc)
 
 std::vector<std::vector<Map_Block>> leveldata; //current map information as a 2d dynamic size array
+Level_Gen_Params glevelGen; //size and seed for generated levels, set from the command line
+bool glevelGenOn = false; //generate levels instead of loading the map files
+int glevelsGenerated = 0; //added to the seed so every new level is different
+std::shared_ptr<const Level_Geometry> glevelGeometry; //the loaded level as captured by the first snapshot of it. empty until then
+World_Snapshot gworldSnapshot; //F1 saves, F2 restores
+Frame_Capture gcapture; //records every presented frame when started with --capture
+std::string gcapturePath;
+const int captureSlots = 8; //frames that can wait for the writer before new ones get dropped
+World_Batch gworldBatch; //worlds stepped together with --worlds instead of playing
+int gbatchWorldCount = 0;
+int gbatchObsWidth = 160;
+int gbatchObsHeight = 90;
+int gbatchSteps = 1000; //steps the --worlds benchmark runs for
+int gbatchThreads = 0; //0 uses every cpu, also used by --rays
+int grayBenchCount = 0; //rays per batch for the --rays benchmark
+bool gprecisionReportOn = false; //set with --precision-report
+int gcpuLevel = -1; //CPU_LEVEL of the pixel kernel copies to run, set with --isa. -1 picks the best the cpu has
+int gchaserCount = 0; //sprites spawned on every level that chase the player, set with --chasers
+int gauxChannels = 0; //AUX_CHANNEL bits to fill for every batch observation, set with --aux. game frames never fill them
+int gauxScale = 1; //aux buffers are this many times smaller than the frame on each side
+Memory_Stats gmemory; //M prints it while playing
+bool gmemoryReportOn = false; //also print it on the way out, set with --memory-report
+Telemetry_Writer gtelemetry; //published after every presented frame when started with --telemetry
+std::string gtelemetryName; //shared memory segment name, empty for no telemetry
+std::string ggoldenDir; //reference images and times, set with --golden or --golden-record
+bool ggoldenRecord = false; //write the references instead of checking against them
+int ggoldenTolerance = 0; //largest per channel difference a pixel may have from its reference
+double ggoldenSlowdown = 10.0; //percent the total render time may grow over the recorded one
+std::string gmapName; //map file or generator settings of the current level
+int glevelsLoaded = 0;
+bool glevelPreloaded = false; //init already loaded the first level on a worker, the first newlevel only sets up around it
 
 std::vector<Game_Sprite> allSprites;
-std::vector<double> spriteDistances;
-std::vector<int> spriteOrder;
+std::vector<Sprite_Spawn> glevelSprites; //sprites placed by the current map. empty means spawn the test sprites
 
 bool init(); //basic start-SDL stuff
 bool initWindow(); //get window and hardware accelerated (if possible) renderer
-bool initTextures(); //load in assets and make textures from them all
+bool initAssets(); //decode every image and load the first level on worker threads behind the splash, then make the textures
+void startupLoadJob(void *data, int index); //one image of a Startup_Load, or the first level for index 0
+void drawLoadingSplash(SDL_Texture *splash, double progress); //splash and a progress bar, presented straight away
 void initAllSprites();
 void newlevel(bool warpView); //reset some basic settings and load another level
+void loadNextLevel(); //pick and load the next map file or generated level, nothing else
 void loadLevel(std::string path); //read in map data and populate leveldata array with it
+void loadGeneratedLevel(const Generated_Level &level); //populate leveldata straight from the level generator
+bool parseArgs(int argc, char **argv); //read command line options. false means don't start the game
+void captureWorld(World_Snapshot &snapshot); //copy the current world state into a snapshot
+Game_Sprite makeSprite(int texID, double x, double y); //pickup sprite at a random animation frame
+void spawnChasers(std::vector<Game_Sprite> &sprites, const std::vector<std::vector<Map_Block>> &level, int width, int height, int count, double playerX, double playerY);
+void levelFromGenerated(const Generated_Level &level, std::vector<std::vector<Map_Block>> &blocks);
+void initWorldBatch(World_Batch &batch, int count, int obsWidth, int obsHeight, int threads); //every world gets its own copy of a level
+void stepWorldBatch(World_Batch &batch); //apply batch.actions to every world and render every observation
+void stepWorldJob(void *data, int index); //step and render one world of a batch
+void stopWorldBatch(World_Batch &batch);
+void renderObservation(World_Context &context, Uint32 *pixels); //raycast one world into an obsWidth x obsHeight buffer
+void drawSpritesToBuffer(Frame_Slot &frame, Uint32 *pixels); //cpu sprite pass for observations, no fog
+void runWorldBatchBenchmark(); //--worlds: step random actions and report environment frames per second
+void runRayQueryBenchmark(); //--rays: cast batches of random line of sight rays and report rays per second
+void runPrecisionReport(); //--precision-report: compare float and fixed point kernels against double on the shipped maps
+int runGoldenHarness(); //--golden: draw fixed views of every map and check them against reference images and times. nonzero on failure
+double timeGoldenView(Frame_Slot &frame, Frame_Slot &prev, int runs); //median ms renderFrame takes for the current view
+template<typename Real> void precisionColumns(const Camera_State &cam, int width, int height, std::vector<Ray_Hit> &hits, std::vector<int> &texX, std::vector<int> &spans); //wall results of one view in Real
+template<typename Real> void precisionFloorRow(const Camera_State &cam, double rowDist, int width, int texWidth, int texHeight, std::vector<Sint64> &texels); //floor texel of each x, stepped like drawFloor
+void comparePrecision(Precision_Stats &stats, const std::vector<Ray_Hit> &refHits, const std::vector<int> &refTexX, const std::vector<int> &refSpans,
+                      const std::vector<Ray_Hit> &hits, const std::vector<int> &texX, const std::vector<int> &spans);
+void restoreWorld(const World_Snapshot &snapshot); //put the world back the way it was when the snapshot was taken
 bool update(); //update world 1 tick
 void calcDeltaTime();
 void updateWindowTitle();
+void updateTelemetry(const Frame_Slot &frame, const double stageMs[TELEMETRY_STAGE_COUNT]); //fill gtelemetry from the frame just presented and publish it
 bool handleInput(); //react to player input.
 void updateScreen(); //draw stuff
-void updateBlockTimers(int x, int y, int radius, double percent);
-void calcRaycast(); //calculate all raytracing. calls draw world when it's done
-void calcFloorDist();
-void drawWorldGeoFlat(double* wallDist, int* side, int* mapX, int* mapY); //draw world with debug colors
-void drawWorldGeoTex(double* wallDist, int* side, int* mapX, int* mapY); //draw world with textures
+void updateBlockTimers(Sim_World &world, int x, int y, int radius, double percent);
+bool initSim(); //create the locks shared between the sim and render sides
+void startSimThread();
+void stopSimThread();
+int simThread(void *data); //fixed tick loop. steps gsim and publishes snapshots
+void simStep(Sim_World &world, const Sim_Input &input, double dt); //advance the world by one tick
+void simPublish(Sim_World &world, Uint64 tick, Uint64 time); //hand the finished tick over to the render side
+void simResetFromView(bool copyLevel = true); //copy the level, camera and sprites into the sim. without copyLevel only doors are copied
+void syncSimView(); //apply published door changes and interpolate the camera and sprites for this frame
+void updateVerticalView(); //recalculate floor distances, sky and floor rects after vertLook or vertHeight changed
+void lateLatchView(); //read the mouse one last time and add look input the sim hasn't applied yet to the view
+void updateLatencyReport(); //print input latency percentiles every so often
+bool initFrames(); //allocate frame slots and the locks for the frame thread
+void startFrameThread();
+void stopFrameThread();
+int frameThread(void *data); //fills whichever slot startFrameJob hands it
+void startFrameJob(int slot); //hand a slot to the frame thread
+void finishFrameJob(); //wait until the frame thread is idle
+void beginFrame(Frame_Slot &frame); //capture the current view state into a slot. main thread only
+void renderFrame(Frame_Slot &frame, const Frame_Slot &prev); //raycast and fill pixel buffers. prev is the slot presented before this one
+void presentFrame(Frame_Slot &frame); //upload, draw and present a finished slot. main thread only
+void drawFrame(Frame_Slot &frame); //upload and draw a finished slot without presenting it
+void uploadDirtyRows(SDL_Texture *tex, const std::vector<Uint32> &pixels, const std::vector<Uint8> &dirty, int width, int height);
+void markRow(std::vector<Uint32> &pixels, std::vector<Uint8> &written, std::vector<Uint8> &dirty, const std::vector<Uint32> &prevPixels, const std::vector<Uint8> &prevWritten, int y, int width, bool full);
+void calcRaycast(Frame_Slot &frame); //calculate all raytracing for a frame
+void fillColumnDepth(Frame_Slot &frame, int start, int end); //aux column depth for the columns from start to end
+double fogClipDist(const Frame_Slot &frame); //distance past which the frame's fog hides everything
+void storeColumnHit(Frame_Slot &frame, int x, Ray_Hit &hit, double rayDirX, double rayDirY); //fill one column of raycast results
+void castColumn(Frame_Slot &frame, int x); //full DDA for one column
+template<typename Cell_Visitor> void castColumn(Frame_Slot &frame, int x, Cell_Visitor &visit); //same, reporting the cells the ray passes through
+void castColumns(Frame_Slot &frame, int start, int end); //castColumn for each x from start to end
+void calcRaycastFaces(Frame_Slot &frame); //RAYCAST_FACES version of calcRaycast
+int spanExit(const Frame_Slot &frame, int cellX, int cellY, int x); //edge of a cell column x's ray leaves through
+bool cellBeyondClip(const Frame_Slot &frame, int cellX, int cellY); //is the whole cell past maxRayDist
+void fillFaceColumns(Frame_Slot &frame, int wallX, int wallY, int exit, int start, int end); //columns that all hit one wall face
+void calcRaycastSubsampled(Frame_Slot &frame); //RAYCAST_SUBSAMPLE version of calcRaycast
+void calcWallColumns(Frame_Slot &frame, int start, int end); //work out which wall texture column and screen span each x from start to end draws
+template<typename Real> int wallTexColumn(double posX, double posY, double wallDist, double rayDirX, double rayDirY, int side, double slide, int texWidth); //unflipped texture column a wall hit lands in
+void drawWalls(Frame_Slot &frame, int rowStart, int rowEnd); //fill the rows from rowStart to rowEnd of the textured wall columns into the frame's buffer
+void calcFloorDist(double *rowDist, int screenHeight, double look, double height);
+void drawWorldGeoFlat(const Frame_Slot &frame); //draw world with debug colors
+void drawWorldGeoTex(const Frame_Slot &frame); //draw world with textures
 void drawFloor(double* wallDist, int* drawStart, int* drawEnd, int* side, int* mapX, int* mapY); //calculate and draw perspective floor and ceiling
-void drawFloor();
-void drawMiniMap(); //draw little debug color minimap
-void drawSkyBox(); //paste a skybox
-void drawSprites(double* wallDist);
+void prepareFloor(Frame_Slot &frame, const Frame_Slot &prev); //pick the rows drawFloor casts this frame, before any of them are drawn
+void drawFloor(Frame_Slot &frame, const Frame_Slot &prev, int rowStart, int rowEnd); //fill rows of the floor and ceiling buffer for a frame
+bool floorReprojectable(const Frame_Slot &frame, const Frame_Slot &prev); //can prev's floor rows be moved into this frame
+int floorSourceRow(const Frame_Slot &source, int start, bool ceiling, double dist, int horizon, int rowStep); //row of the previous frame nearest to dist
+int paletteFogLevel(const Frame_Slot &frame, double fog); //colormap level for a fog term
+void drawMiniMap(const Frame_Slot &frame); //draw little debug color minimap
+void drawSkyBox(const Frame_Slot &frame); //paste a skybox
+void projectSprites(Frame_Slot &frame); //sort the sprites far to near and place them on screen, needs only the camera
+void clipSprites(Frame_Slot &frame); //cut the projected sprites down to what's in front of the walls
+void drawSprites(Frame_Slot &frame);
 void close(); //prepare to quit game
 SDL_Texture *loadTexture(const std::string &file, SDL_Renderer *ren); // loads a BMP image into a texture on the rendering device
 void renderTexture(SDL_Texture *tex, SDL_Renderer *ren, SDL_Rect dst, SDL_Rect *clip); // draw an SDL_texture to an SDL_renderer at position x,y
 void renderTexture(SDL_Texture *tex, SDL_Renderer *ren, int x, int y, SDL_Rect *clip);
 std::string getProjectPath(const std::string &subDir);//get working directory, account for different folder symbol in windows paths
-SDL_Texture *loadImage(std::string path);//load BMP, return texture
-SDL_Texture *loadImageColorKey(std::string path, SDL_Color transparent);//load BMP with color key transparency, return texture
-void generatefogMask(SDL_Texture* tex, int* drawStart, int* drawEnd, double* wallDist); //calculate fog using current settings and populate texture with results
-void drawHud(); //just calls the various HUD related draw commands
+std::vector<std::string> listMapFiles(); //names of the .txt maps in resources/maps without the extension, map2 before map10
+SDL_Texture *loadImage(std::string path, Texel_Image *texels = NULL, int layout = TEXELS_ROWS);//load BMP, return texture. optionally keep a cpu copy
+SDL_Texture *loadImageColorKey(std::string path, SDL_Color transparent, Texel_Image *texels = NULL);//load BMP with color key transparency, return texture
+SDL_Texture *trackTexture(SDL_Texture *tex); //count a new texture's bytes in gmemory, returns tex
+void destroyTexture(SDL_Texture *&tex); //uncount, destroy and clear a texture
+void measureMemory(); //refresh the gmemory tags that are measured from their containers
+void measureFrameMemory(); //just MEMORY_FRAMES. the frame thread has to be idle
+void measureSnapshotMemory(); //just MEMORY_SNAPSHOTS
+bool loadImageTexels(std::string path, SDL_Color transparent, Texel_Image &texels);//load BMP straight into the texel store, color key becomes alpha
+void prepareFog(const Frame_Slot &frame, Fog_Tables &fog); //fog colors for the whole frame, once its rays are cast
+void generatefogMask(Frame_Slot &frame, const Frame_Slot &prev, const Fog_Tables &fog, int rowStart, int rowEnd); //calculate fog using the frame's settings and fill rows of its fog buffer
+bool fogPassNeeded(const Frame_Slot &frame); //does the frame draw its fog buffer over the world
+void markFloorRows(Frame_Slot &frame, const Frame_Slot &prev, int rowStart, int rowEnd); //finished floor and wall rows to RGBA and into the dirty row list
+void buildFrameGraph(Task_Graph &graph, Frame_Tasks &tasks); //renderFrame's passes as bands of tasks for the frame scheduler
+void frameRayTask(void *data, int band); //tasks of the frame graph, data is the Frame_Tasks
+void frameColumnsTask(void *data, int band);
+void frameFloorTask(void *data, int band);
+void frameWallsTask(void *data, int band);
+void frameFogTask(void *data, int band);
+void frameFogTablesTask(void *data, int band);
+void frameSpritesTask(void *data, int band);
+void frameSpriteClipTask(void *data, int band);
+void selectCpuKernels(int level); //point generatefogMask at its copy for one CPU_LEVEL
+void drawHud(const Frame_Slot &frame); //just calls the various HUD related draw commands
 void drawWeap(); //paste current player weapon on screen
 void changeFOV(bool rel, double newFOV); //alters player camera FOV by changing length of direction vector
 void resizeWindow(bool letterbox);
 
 int main(int argc, char **argv)
 {
+    if(!parseArgs(argc, argv))
+        return 0;
+
+    int bestCpuLevel = detectCpuLevel();
+    if(gcpuLevel > bestCpuLevel)
+        printf("CPU: %s kernels asked for but this cpu or build can't run them\n", cpuLevelName(gcpuLevel));
+    if(gcpuLevel < 0 || gcpuLevel > bestCpuLevel)
+        gcpuLevel = bestCpuLevel;
+    selectCpuKernels(gcpuLevel);
+    printf("CPU: using %s fog kernel, best available %s\n", cpuLevelName(gcpuLevel), cpuLevelName(bestCpuLevel));
 
     //init SDL
     if (init())
     {
         newlevel(false);   
+        if(!ggoldenDir.empty())
+        {
+            int result = runGoldenHarness();
+            close();
+            return result;
+        }
+        if(gbatchWorldCount > 0 || grayBenchCount > 0 || gprecisionReportOn)
+        {
+            if(gbatchWorldCount > 0)
+                runWorldBatchBenchmark();
+            if(grayBenchCount > 0)
+                runRayQueryBenchmark();
+            if(gprecisionReportOn)
+                runPrecisionReport();
+            close();
+            return 0;
+        }
+        if(gauxChannels != 0)
+            printf("Aux: only --worlds observations have aux buffers, --aux does nothing in the game\n");
+        if(!gcapturePath.empty())
+        {
+            int outputW = 0, outputH = 0;
+            SDL_GetRendererOutputSize(gRenderer, &outputW, &outputH);
+            startCapture(gcapture, gcapturePath, outputW, outputH, captureSlots);
+            measureMemory(); //the ring is all allocated now
+        }
+        if(!gtelemetryName.empty())
+        {
+            if(openTelemetry(gtelemetry, gtelemetryName))
+                printf("Telemetry: publishing to shared memory %s\n", gtelemetryName.c_str());
+            else
+                printf("Telemetry: couldn't open shared memory %s\n", gtelemetryName.c_str());
+        }
+        startSimThread();
+        startFrameThread();
         //Main loop flag
         bool quit = false;
         while (!quit)
@@ -199,6 +445,12 @@ int main(int argc, char **argv)
             quit = update();
         }
 
+        latencyReportSession(glookLatency);
+        latencyReportSession(gmoveLatency);
+        stopCapture(gcapture);
+        stopFrameThread();
+        stopSimThread();
+        closeTelemetry(gtelemetry);
         close();
     }
     else
@@ -228,11 +480,21 @@ bool init()
             success = false;
         }
     }
-    if (!initTextures())
+    initBlockTypes(); //the first level is loaded alongside the textures and needs these
+    if (!initAssets())
+    {
+        success = false;
+    }
+    if (!initFrames())
     {
+        printf("Frame buffers failed to initialize. SDL Error: %s\n", SDL_GetError());
+        success = false;
+    }
+    if (!initSim())
+    {
+        printf("Sim locks failed to initialize. SDL Error: %s\n", SDL_GetError());
         success = false;
     }
-    initBlockTypes();
 
     return success;
 }
@@ -289,15 +551,83 @@ bool initWindow()
     return success;
 }
 
-bool initTextures()
+bool initAssets()
 {
     bool success = true;
+    Uint64 loadStart = SDL_GetPerformanceCounter();
+
+    //every image the game needs, decoded on worker threads. the textures are made here afterwards
+    const std::string projectPath = getProjectPath(""); //resolved once here, workers only read it
+    const std::string textures = projectPath + "resources" + PATH_SYM + "textures" + PATH_SYM;
+    const std::string sprites = projectPath + "resources" + PATH_SYM + "sprites" + PATH_SYM;
+    Startup_Load load;
+    std::vector<Texel_Image> pickupTexels(totalPickupTextures);
+    std::vector<Texel_Image> maskTexels(totalPickupTextures);
+    load.images.resize(4 + totalWallTextures + totalPickupTextures * 2);
+    Asset_Image &skyImage = load.images[0];
+    skyImage.path = textures + "sky.bmp";
+    Asset_Image &floorImage = load.images[1];
+    floorImage.path = textures + "floor0.bmp";
+    floorImage.layout = TEXELS_MORTON;
+    floorImage.mips = &gfloorTexels;
+    Asset_Image &ceilImage = load.images[2];
+    ceilImage.path = textures + "ceil0.bmp";
+    ceilImage.layout = TEXELS_MORTON;
+    ceilImage.mips = &gceilTexels;
+    Asset_Image &weaponImage = load.images[3];
+    weaponImage.path = sprites + "shotgun1.bmp";
+    weaponImage.colorKey = true;
+    weaponImage.key = cMagenta;
+    Asset_Image *walls = &load.images[4];
+    for(int i = 0; i < totalWallTextures; i++)
+    {
+        walls[i].path = textures + "wall" + std::to_string(i) + ".bmp";
+        walls[i].layout = TEXELS_COLUMNS;
+        walls[i].mips = &gwallTexels[i];
+    }
+    Asset_Image *pickups = &load.images[4 + totalWallTextures];
+    for(int i = 0; i < totalPickupTextures; i++)
+    {
+        //sprites only need cpu copies, they all get packed into one atlas texture
+        Asset_Image &pickup = pickups[i * 2], &mask = pickups[i * 2 + 1];
+        pickup.path = sprites + "pickup" + std::to_string(i) + ".bmp";
+        mask.path = sprites + "mask" + std::to_string(i) + ".bmp";
+        pickup.texels = &pickupTexels[i];
+        mask.texels = &maskTexels[i];
+        pickup.texture = mask.texture = false;
+        pickup.colorKey = mask.colorKey = true;
+        pickup.key = mask.key = cMagenta;
+    }
+
+    //this thread only draws the splash, so there's a worker for every cpu
+    const int jobs = load.images.size() + 1;
+    Worker_Pool pool;
+    startWorkerPool(pool, SDL_GetCPUCount() + 1);
+    SDL_AtomicSet(&load.done, 0);
+    beginWorkerPool(pool, startupLoadJob, &load, jobs);
+    SDL_Texture *splash = NULL;
+    if(SDL_Surface *splashImage = surfaceFromXPM(loading_splash_xpm))
+    {
+        splash = trackTexture(SDL_CreateTextureFromSurface(gRenderer, splashImage));
+        SDL_FreeSurface(splashImage);
+    }
+    do
+    {
+        drawLoadingSplash(splash, SDL_AtomicGet(&load.done) / (double)jobs);
+        SDL_Delay(5);
+    } while(!workerPoolIdle(pool));
+    finishWorkerPool(pool);
+    const int loadThreads = pool.threads.size() + 1;
+    stopWorkerPool(pool);
+    destroyTexture(splash);
+    glevelPreloaded = true;
+    for(std::size_t i = 0; i < load.images.size(); i++)
+    {
+        if(!load.images[i].decoded)
+            success = false;
+    }
 
-    // loading in the textures
-    std::stringstream texFileName;
-    texFileName << "resources" << PATH_SYM << "textures" << PATH_SYM << "sky.bmp"; 
-    gskyTex = loadImage(texFileName.str());
-    texFileName.str(std::string());
+    gskyTex = trackTexture(createAssetTexture(gRenderer, skyImage));
     if (gskyTex == NULL)
     {
         success = false;
@@ -313,61 +643,48 @@ bool initTextures()
         gskySrcRect.y = skyh/4;  // adjust down 220 sky bmp height - the 137 pixels for viewing. bottom of sky bmp is horizon, top is out of view
 
     }
-    
-    
-    texFileName << "resources" << PATH_SYM << "textures" << PATH_SYM << "floor0.bmp"; 
-    gfloorTex = loadImage(texFileName.str());
-    texFileName.str(std::string());
-    if (gfloorTex == NULL)
-    {
-        success = false;
-    }
-    texFileName << "resources" << PATH_SYM << "textures" << PATH_SYM << "ceil0.bmp";
-    gceilTex = loadImage(texFileName.str());
-    texFileName.str(std::string());
-    if (gceilTex == NULL)
+    gfloorTex = trackTexture(createAssetTexture(gRenderer, floorImage));
+    gceilTex = trackTexture(createAssetTexture(gRenderer, ceilImage));
+    if (gfloorTex == NULL || gceilTex == NULL)
     {
         success = false;
     }
     gwallTex = new SDL_Texture *[totalWallTextures];
     for(int i = 0; i < totalWallTextures; i++)
     {
-        texFileName.str(std::string());
-        texFileName << "resources" << PATH_SYM << "textures" << PATH_SYM << "wall" << i << ".bmp";
-        gwallTex[i] = loadImage(texFileName.str());
+        gwallTex[i] = trackTexture(createAssetTexture(gRenderer, walls[i]));
         if (gwallTex[i] == NULL)
         {
             success = false;
         }
     }
 
-    pickupTex = new SDL_Texture *[totalPickupTextures];
-    for(int i = 0; i < totalPickupTextures; i++)
+    if(success && gpaletteOn)
     {
-        texFileName.str(std::string());
-        texFileName << "resources" << PATH_SYM << "sprites" << PATH_SYM << "pickup" << i << ".bmp";
-        pickupTex[i] = loadImageColorKey(texFileName.str(), cMagenta);
-        if (pickupTex[i] == NULL)
-        {
-            success = false;
-        }
+        //sprites keep their own colors, they're drawn by the gpu on top
+        std::vector<const Texel_Mips *> images;
+        images.push_back(&gfloorTexels);
+        images.push_back(&gceilTexels);
+        for(int i = 0; i < totalWallTextures; i++)
+            images.push_back(&gwallTexels[i]);
+        buildPalette(gpalette, images);
+        paletteTexels(gfloorTexels, gpalette);
+        paletteTexels(gceilTexels, gpalette);
+        for(int i = 0; i < totalWallTextures; i++)
+            paletteTexels(gwallTexels[i], gpalette);
+        printf("Palette: %d colors\n", gpalette.count - 1);
     }
 
-    maskTex = new SDL_Texture *[totalPickupTextures];
-    for(int i = 0; i < totalPickupTextures; i++)
+    //sprites and their fog masks all get packed into one atlas texture
+    packSpriteAtlas(gspriteAtlas, pickupTexels, maskTexels);
+    if (!createAtlasTexture(gspriteAtlas, gRenderer))
     {
-        texFileName.str(std::string());
-        texFileName << "resources" << PATH_SYM << "sprites" << PATH_SYM << "mask" << i << ".bmp";
-        maskTex[i] = loadImageColorKey(texFileName.str(), cMagenta);
-        if (maskTex[i] == NULL)
-        {
-            success = false;
-        }
+        printf("Sprite atlas texture failed. SDL Error: %s\n", SDL_GetError());
+        success = false;
     }
+    trackTexture(gspriteAtlas.tex);
 
-    texFileName.str(std::string());
-    texFileName << "resources" << PATH_SYM << "sprites" << PATH_SYM << "shotgun1.bmp";
-    weaponTex = loadImageColorKey(texFileName.str(), cMagenta);
+    weaponTex = trackTexture(createAssetTexture(gRenderer, weaponImage));
     if (weaponTex == NULL)
     {
         success = false;
@@ -386,65 +703,191 @@ bool initTextures()
     
     SDL_RendererInfo info;
     SDL_GetRendererInfo(gRenderer,&info);
-    gfloorBuffer = SDL_CreateTexture(gRenderer, SDL_PIXELFORMAT_RGBA32, SDL_TEXTUREACCESS_STREAMING, gscreenWidth, gscreenHeight);
+    gfloorBuffer = trackTexture(SDL_CreateTexture(gRenderer, SDL_PIXELFORMAT_RGBA32, SDL_TEXTUREACCESS_STREAMING, gscreenWidth, gscreenHeight));
     if (gfloorBuffer == NULL)
     {
         success = false;
     }
-    gfogTex = SDL_CreateTexture(gRenderer, SDL_PIXELFORMAT_RGBA32, SDL_TEXTUREACCESS_STREAMING, gscreenWidth, gscreenHeight);
+    gfogTex = trackTexture(SDL_CreateTexture(gRenderer, SDL_PIXELFORMAT_RGBA32, SDL_TEXTUREACCESS_STREAMING, gscreenWidth, gscreenHeight));
     if(gfogTex == NULL)
     {
         success = false;
     }
     else
     {
-        calcFloorDist();
+        calcFloorDist(floorDist, gscreenHeight, vertLook, vertHeight);
         for(int x = 0; x < gscreenWidth; x++) //setup a sin lookup table for the fog mask for later
         {
             brightSin[x] = 1/sin((M_PI / 2.0)-(hFOV / 2.0 * degToRad)+(((double)x/(double)gscreenWidth)*(hFOV * degToRad)));
+            invBrightSin[x] = 1 / brightSin[x];
             //brightSin[x] *= brightSin[x]; // squared to get stronger curve effect
         }
     }
+    printf("Startup: %d images and the first level loaded in %.1fms on %d threads\n", (int)load.images.size(),
+           (SDL_GetPerformanceCounter() - loadStart) * 1000.0 / SDL_GetPerformanceFrequency(), loadThreads);
     return success;
 }
 
+
+void startupLoadJob(void *data, int index)
+{
+    Startup_Load &load = *(Startup_Load *)data;
+    if(index == 0)
+        loadNextLevel(); //likely the longest job when the level is generated, so it starts first
+    else
+        decodeAssetImage(load.images[index - 1]);
+    SDL_AtomicAdd(&load.done, 1);
+}
+
+void drawLoadingSplash(SDL_Texture *splash, double progress)
+{
+    SDL_PumpEvents(); //keep the window responsive. the events stay queued for the game
+    int outputW = 0, outputH = 0;
+    SDL_GetRendererOutputSize(gRenderer, &outputW, &outputH);
+    SDL_SetRenderDrawColor(gRenderer, 0x00, 0x00, 0x00, 0xff);
+    SDL_RenderClear(gRenderer);
+    int w = 0, h = 0;
+    if(splash != NULL && SDL_QueryTexture(splash, NULL, NULL, &w, &h) == 0 && w > 0 && h > 0)
+    {
+        //whole steps of scale up to about half the window, it's pixel art
+        int scale = std::max(1, std::min(outputW / 2 / w, outputH / 2 / h));
+        SDL_Rect dst = {(outputW - w * scale) / 2, (outputH - h * scale) / 2, w * scale, h * scale};
+        SDL_RenderCopy(gRenderer, splash, NULL, &dst);
+    }
+    SDL_Rect bar = {outputW / 4, outputH * 13 / 16, outputW / 2, std::max(2, outputH / 60)};
+    SDL_SetRenderDrawColor(gRenderer, 0x40, 0x40, 0x40, 0xff);
+    SDL_RenderFillRect(gRenderer, &bar);
+    bar.w = (int)(bar.w * std::min(1.0, progress));
+    SDL_SetRenderDrawColor(gRenderer, 0xe0, 0xe0, 0xe0, 0xff);
+    SDL_RenderFillRect(gRenderer, &bar);
+    SDL_RenderPresent(gRenderer);
+}
+
 void initAllSprites() //just a shitty test function to spawn 20 of the same object. this is just to varify we CAN draw sprites
 {
     int totalSprites = 20;
     int eachType = 5;
     allSprites.clear();
+    if(!glevelSprites.empty()) //the map says where its sprites go
+    {
+        for(std::size_t i = 0; i < glevelSprites.size(); i++)
+            allSprites.push_back(makeSprite(glevelSprites[i].texID, glevelSprites[i].x, glevelSprites[i].y));
+        spawnChasers(allSprites, leveldata, mapWidth, mapHeight, gchaserCount, posX, posY);
+        return;
+    }
     for(int n = 0; n < totalPickupTextures; n++)
     {
         for(int i = n*eachType; i < std::min((n+1)*eachType, totalSprites); i++)
         {
-            allSprites.push_back(Game_Sprite());
-            allSprites[i].texID = n;
-            allSprites[i].worldX = posX - 2.5 + 5.0 * ((double) rand() / (RAND_MAX));
-            allSprites[i].worldY = posY - 2.5 + 5.0 * ((double) rand() / (RAND_MAX));
-            SDL_QueryTexture(pickupTex[allSprites[i].texID], NULL, NULL, & allSprites[i].image.w, & allSprites[i].image.h);
-            allSprites[i].width = 0.1*(n+1);
-            allSprites[i].height = std::min(1.0, allSprites[i].width * (allSprites[i].image.h / allSprites[i].image.w));
-            allSprites[i].image.x = 0;
-            allSprites[i].image.y = 0;
-            
+            double x = posX - 2.5 + 5.0 * ((double) rand() / (RAND_MAX));
+            double y = posY - 2.5 + 5.0 * ((double) rand() / (RAND_MAX));
+            allSprites.push_back(makeSprite(n, x, y));
         }
     }
+    spawnChasers(allSprites, leveldata, mapWidth, mapHeight, gchaserCount, posX, posY);
+}
 
+void spawnChasers(std::vector<Game_Sprite> &sprites, const std::vector<std::vector<Map_Block>> &level, int width, int height, int count, double playerX, double playerY)
+{
+    //anywhere open that isn't right next to the player
+    std::vector<int> open;
+    for(int y = 0; y < height; y++)
+        for(int x = 0; x < width; x++)
+            if(!level[x][y].solid && std::abs(x + 0.5 - playerX) + std::abs(y + 0.5 - playerY) > 4)
+                open.push_back(x + y * width);
+    if(open.empty())
+        return;
+    for(int i = 0; i < count; i++)
+    {
+        int cell = open[rand() % open.size()];
+        Game_Sprite sprite = makeSprite(rand() % totalPickupTextures, cell % width + 0.2 + 0.6 * rand() / RAND_MAX, cell / width + 0.2 + 0.6 * rand() / RAND_MAX);
+        sprite.chases = true;
+        sprites.push_back(sprite);
+    }
+}
 
-    spriteDistances.resize(totalSprites);
-    spriteOrder.resize(totalSprites);    
+Game_Sprite makeSprite(int texID, double x, double y)
+{
+    Game_Sprite sprite;
+    sprite.texID = std::min(std::max(texID, 0), totalPickupTextures - 1);
+    sprite.worldX = x;
+    sprite.worldY = y;
+    setSpriteFrame(gspriteAtlas, sprite, rand()); //random start frame so a crowd isn't animating in lockstep
+    sprite.width = 0.1*(sprite.texID+1);
+    sprite.height = std::min(1.0, sprite.width * (sprite.image.h / sprite.image.w));
+    return sprite;
 }
 
 bool update()
 {
-    updateScreen();
+    const double msPerCount = 1000.0 / SDL_GetPerformanceFrequency();
+    double stageMs[TELEMETRY_STAGE_COUNT] = {};
+    Uint64 start = SDL_GetPerformanceCounter();
+    finishFrameJob(); //frame thread is idle now, safe to change leveldata and the view
+    measureFrameMemory(); //the slots grow as the view changes, so their peak is taken every frame
+    Uint64 waited = SDL_GetPerformanceCounter();
+    bool quit = handleInput(); //collect input for the sim thread
+    syncSimView(); //pick up the latest sim ticks
+    Uint64 synced = SDL_GetPerformanceCounter();
+
+    //start the next frame on the frame thread, then present the one it just finished
+    //throughput is bounded by whichever side is slower rather than the two added together
+    int readySlot = gframeReady;
+    int nextSlot = (readySlot == 0) ? 1 : 0;
+    beginFrame(gframes[nextSlot]);
+    startFrameJob(nextSlot);
+    Uint64 presentStart = SDL_GetPerformanceCounter();
+    if(readySlot >= 0)
+        presentFrame(gframes[readySlot]);
+    gframeReady = nextSlot;
+
+    updateLatencyReport();
     calcDeltaTime();
-    bool quit = handleInput();
-    updateBlockTimers(int(posX), int(posY), 2, -2.0 * (gDeltaTimer / (double)SDL_GetPerformanceFrequency())); //tell nearby doors to open
     updateWindowTitle();
+    if(readySlot >= 0 && gtelemetry.block != NULL)
+    {
+        stageMs[STAGE_RENDER] = gframes[readySlot].renderMs;
+        stageMs[STAGE_WAIT] = (waited - start) * msPerCount;
+        stageMs[STAGE_INPUT] = (synced - waited) * msPerCount;
+        stageMs[STAGE_PRESENT] = (gtime - presentStart) * msPerCount;
+        stageMs[STAGE_FRAME] = gDeltaTimer * msPerCount;
+        updateTelemetry(gframes[readySlot], stageMs);
+    }
     return quit;
 }
 
+void updateTelemetry(const Frame_Slot &frame, const double stageMs[TELEMETRY_STAGE_COUNT])
+{
+    Telemetry_Block &values = gtelemetry.values;
+    telemetryFrameTime(gtelemetry, stageMs);
+    SDL_LockMutex(gsimSnapLock);
+    values.simTick = gsimCurr.tick;
+    SDL_UnlockMutex(gsimSnapLock);
+    values.raySteps = 0;
+    values.maxRaySteps = 0;
+    for(int x = 0; x < frame.width; x++)
+    {
+        values.raySteps += frame.raySteps[x];
+        values.maxRaySteps = std::max(values.maxRaySteps, (Uint32)frame.raySteps[x]);
+    }
+    values.rayColumns = frame.width;
+    values.sprites = frame.sprites.size();
+    values.spritesDrawn = frame.spritesDrawn;
+    values.mapWidth = mapWidth;
+    values.mapHeight = mapHeight;
+    values.levelsLoaded = glevelsLoaded;
+    values.flags = (frame.fogOn ? TELEMETRY_FOG : 0) | (frame.ceilingOn ? TELEMETRY_CEILING : 0) | (vertSyncOn ? TELEMETRY_VSYNC : 0) | (frame.paletted ? TELEMETRY_PALETTE : 0);
+    SDL_strlcpy(values.mapName, gmapName.c_str(), telemetryNameSize);
+    values.posX = frame.cam.posX;
+    values.posY = frame.cam.posY;
+    values.dirX = frame.cam.dirX;
+    values.dirY = frame.cam.dirY;
+    values.hFOV = frame.hFOV;
+    values.vertLook = frame.cam.vertLook;
+    values.vertHeight = frame.cam.vertHeight;
+    publishTelemetry(gtelemetry);
+}
+
 void calcDeltaTime()
 {
     gtime = SDL_GetPerformanceCounter();
@@ -469,558 +912,1725 @@ void updateWindowTitle()
 
 void updateScreen()
 {
-    //clear screen with a dark grey
-    SDL_SetRenderDrawColor(gRenderer, 0x20, 0x20, 0x20, 0xff);
-    SDL_RenderClear(gRenderer);
-    calcRaycast(); //calculates and draws all raycast related screen updates
-    drawHud();
-    //Update screen
-    SDL_RenderFlush(gRenderer); //draw all batched commands
-    SDL_RenderPresent(gRenderer); //blit back-buffer to screen
+    //draw one frame start to finish on this thread. used outside the main loop, like the level warp effect
+    finishFrameJob();
+    int slot = (gframeReady == 0) ? 1 : 0;
+    beginFrame(gframes[slot]);
+    gframes[slot].fullUpload = true;
+    renderFrame(gframes[slot], gframes[1 - slot]);
+    presentFrame(gframes[slot]);
+    gframeReady = -1; //anything that was waiting to be presented is stale now
+    gframeForceFull = true; //and the textures no longer hold what the next frame will compare against
+}
+
+bool initFrames()
+{
+    gframeLock = SDL_CreateMutex();
+    gframeCond = SDL_CreateCond();
+    gpixelFormat = SDL_AllocFormat(SDL_PIXELFORMAT_RGBA32);
+    initFrameSlot(gframes[0], gscreenWidth, gscreenHeight);
+    initFrameSlot(gframes[1], gscreenWidth, gscreenHeight);
+    measureFrameMemory();
+    return gframeLock != NULL && gframeCond != NULL && gpixelFormat != NULL;
 }
 
-void updateBlockTimers(int inX, int inY, int radius, double percent)
+void startFrameThread()
 {
-    for(int y = std::max(inY - radius, 0); y < std::min(mapHeight, inY + radius + 1); ++y)
+    gframeQuit = false;
+    int threads = gframeThreads > 0 ? gframeThreads : SDL_GetCPUCount();
+    if(threads > 1)
     {
-        for(int x = std::max(inX - radius, 0); x < std::min(mapWidth, inX + radius + 1); ++x)
-        {
-            if(leveldata[x][y].timerOn)
-            {
-                leveldata[x][y].timer += percent;
-                if(leveldata[x][y].timer < 0.0)
-                {
-                    leveldata[x][y].timer = 0.0;
-                    leveldata[x][y].timerOn = false;
-                    leveldata[x][y].visible = false;
-                    leveldata[x][y].solid = false;
-                }
-                else if(leveldata[x][y].timer > 1.0)
-                {
-                    leveldata[x][y].timer = 1.0;
-                    leveldata[x][y].timerOn = false;
-                }
-            }
-        }
+        startTaskScheduler(gframeScheduler, threads);
+        gframeTasks.columnBands = frameTaskBands;
+        gframeTasks.rowBands = frameTaskBands;
+        printf("Frame: passes spread over %d threads\n", (int)gframeScheduler.threads.size() + 1);
+    }
+    gframeThread = SDL_CreateThread(frameThread, "frame", NULL);
+    if(gframeThread == NULL)
+    {
+        printf("Frame thread failed to start, rendering on the main thread. SDL Error: %s\n", SDL_GetError());
     }
 }
 
-void calcRaycast()
+void stopFrameThread()
 {
-    //buffers to hold some results from raycasting for each x across screen
-    double wallDist[gscreenWidth]; //dist to nearest wall
-    int side[gscreenWidth];    //was a NS or a EW wall hit?
-    int mapX[gscreenWidth];    //the x value on map of wall hit
-    int mapY[gscreenWidth];    //the y value on map of wall hit
+    if(gframeThread != NULL)
+    {
+        SDL_LockMutex(gframeLock);
+        gframeQuit = true;
+        SDL_CondBroadcast(gframeCond);
+        SDL_UnlockMutex(gframeLock);
+        SDL_WaitThread(gframeThread, NULL);
+        gframeThread = NULL;
+    }
+    if(!gframeScheduler.threads.empty())
+        printf("Frame: %d tasks stolen between threads\n", SDL_AtomicGet(&gframeScheduler.steals));
+    stopTaskScheduler(gframeScheduler);
+}
 
-    double cameraX, rayDirX, rayDirY, sideDistX, sideDistY, deltaDistX = 0, deltaDistY = 0, perpWallDist;
-    int stepX, stepY, hit;    
-    //ACTUAL RAYCAST LOGIC
-    for (int x = 0; x < gscreenWidth; x++)
+int frameThread(void *data)
+{
+    SDL_LockMutex(gframeLock);
+    while(true)
     {
+        while(gframeJob < 0 && !gframeQuit)
+            SDL_CondWait(gframeCond, gframeLock);
+        if(gframeQuit)
+            break;
+        int slot = gframeJob;
+        SDL_UnlockMutex(gframeLock);
 
-        //calculate ray position and direction
-        cameraX = 2 * x / double(gscreenWidth) - 1; //x-coordinate in camera space, or along the x of the camera plane itself
-                                                    //cameraX ranges from -1 to 1, with 0 being center of camera screen
-        
-        rayDirX = dirX + planeX * cameraX; //the XY coord where the vector of this ray crosses the camera plane
-        rayDirY = dirY + planeY * cameraX; //
-        //which box of the map we're in
-        mapX[x] = int(posX);
-        mapY[x] = int(posY);
+        Uint64 start = SDL_GetPerformanceCounter();
+        renderFrame(gframes[slot], gframes[1 - slot]);
+        gframes[slot].renderMs = (SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency();
 
+        SDL_LockMutex(gframeLock);
+        gframeJob = -1;
+        SDL_CondBroadcast(gframeCond);
+    }
+    SDL_UnlockMutex(gframeLock);
+    return 0;
+}
 
-        //length of ray from one x or y-side to next x or y-side
-        if(rayDirX != 0)
-        {
-            deltaDistX = std::abs(1 / rayDirX); //the x component of a vector in the player's viewing direction that spans exactly across 1 map block side to side
-        }
-        
-        
-        if(rayDirY != 0)
-        {
-            deltaDistY = std::abs(1 / rayDirY); //y component of that vector
-        }
-        
+void startFrameJob(int slot)
+{
+    if(gframeThread == NULL) //no frame thread, just do it here
+    {
+        Uint64 start = SDL_GetPerformanceCounter();
+        renderFrame(gframes[slot], gframes[1 - slot]);
+        gframes[slot].renderMs = (SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency();
+        return;
+    }
+    SDL_LockMutex(gframeLock);
+    gframeJob = slot;
+    SDL_CondBroadcast(gframeCond);
+    SDL_UnlockMutex(gframeLock);
+}
 
-        //calculate step and initial sideDist
-        if (rayDirX < 0)
-        {
-            stepX = -1; //facing left, step left (decrement) through map matrix x
-            sideDistX = (posX - mapX[x]) * deltaDistX; // x component of viewing distance vector to nearest wall
-                                                    //calculated by getting our fractional perpendicular offset from the closest wall, times the x component 
-                                                    //of the length of the vector in our viewing direction that spans exactly 1 whole map block side-to-side
-        }
-        else
-        {
-            stepX = 1; //step right (increment) through map matrix x
-            sideDistX = (mapX[x] + 1.0 - posX) * deltaDistX; // x component of distance vector to nearest wall
-        }
-        if (rayDirY < 0)
-        {
-            stepY = -1; //facing up, step up (decrement) through map matrix y
-            sideDistY = (posY - mapY[x]) * deltaDistY; //y component of distance vector to nearest wall
-        }
-        else
+void finishFrameJob()
+{
+    SDL_LockMutex(gframeLock);
+    while(gframeJob >= 0)
+        SDL_CondWait(gframeCond, gframeLock);
+    SDL_UnlockMutex(gframeLock);
+}
+
+void beginFrame(Frame_Slot &frame)
+{
+    lateLatchView();
+    frame.frameNumber = ++gframeCount;
+    frame.lookSeq = lateLatchOn ? ginputSeq : gsimViewSeq;
+    frame.moveSeq = gsimViewSeq;
+    frame.level = &leveldata;
+    frame.cam.posX = posX;
+    frame.cam.posY = posY;
+    frame.cam.dirX = dirX;
+    frame.cam.dirY = dirY;
+    frame.cam.planeX = planeX;
+    frame.cam.planeY = planeY;
+    frame.cam.vertLook = vertLook;
+    frame.cam.vertHeight = vertHeight;
+    frame.hFOV = hFOV;
+    frame.ceilingOn = ceilingOn;
+    frame.fogOn = fogOn;
+    frame.debugColors = debugColors;
+    frame.mipmapsOn = mipmapsOn;
+    frame.worldFog = worldFog;
+    frame.playerFog = playerFog;
+    frame.fogMultiplier = fogMultiplier;
+    frame.fogColor = fogColor;
+    frame.fogPixel = SDL_MapRGBA(gpixelFormat, fogColor.r, fogColor.g, fogColor.b, 0xff);
+    frame.maxRayDist = std::max(minClipDist, std::min(maxRayDist, fogClipDist(frame)));
+    frame.raycastMode = graycastMode;
+    frame.floorInterlace = floorInterlaceOn && !gpaletteOn; //reprojection only knows RGBA rows
+    frame.paletted = gpaletteOn;
+    if(frame.paletted)
+    {
+        frame.indexPixels.resize(frame.width * frame.height);
+        SDL_Color &built = frame.colormapFog;
+        if(frame.colormaps.empty() || built.r != fogColor.r || built.g != fogColor.g || built.b != fogColor.b)
         {
-            stepY = 1; //facing down, step down (increment) through map matrix y
-            sideDistY = (mapY[x] + 1.0 - posY) * deltaDistY; //y component of distance to nearest wall
+            buildColormaps(frame.colormaps, gpalette, fogColor);
+            built = fogColor;
         }
+        frame.fogIndex = gpalette.nearest[paletteCell(fogColor.r, fogColor.g, fogColor.b)];
+    }
+    frame.skySrcRect = gskySrcRect;
+    frame.floorRect = gfloorRect;
+    frame.sprites = allSprites;
+    frame.fullUpload = gframeForceFull;
+    gframeForceFull = false;
+}
 
-        hit = 0; //was there a wall hit?
+void renderFrame(Frame_Slot &frame, const Frame_Slot &prev)
+{
+    calcFloorDist(&frame.floorDist[0], frame.height, frame.cam.vertLook, frame.cam.vertHeight);
+    std::fill(frame.floorRowWritten.begin(), frame.floorRowWritten.end(), 0);
+    std::fill(frame.fogRowWritten.begin(), frame.fogRowWritten.end(), 0);
+    std::fill(frame.aux.sprite.begin(), frame.aux.sprite.end(), 0); //clipSprites fills it
+    //depth and surface come from the textured passes, debug colors leave them as they were
+    if(frame.debugColors)
+    {
+        calcRaycast(frame);
+        projectSprites(frame);
+        clipSprites(frame);
+        return;
+    }
+    prepareFloor(frame, prev);
+    if(!gframeScheduler.threads.empty())
+    {
+        //spread over the frame threads in bands, see buildFrameGraph
+        gframeTasks.frame = &frame;
+        gframeTasks.prev = &prev;
+        buildFrameGraph(gframeGraph, gframeTasks);
+        runTaskGraph(gframeScheduler, gframeGraph);
+        return;
+    }
+    projectSprites(frame);
+    calcRaycast(frame);
+    calcWallColumns(frame, 0, frame.width);
+    clipSprites(frame);
+    drawFloor(frame, prev, 0, frame.height);
+    drawWalls(frame, 0, frame.height);
+    markFloorRows(frame, prev, 0, frame.height);
+    if(fogPassNeeded(frame))
+    {
+        prepareFog(frame, gframeTasks.fog);
+        generatefogMask(frame, prev, gframeTasks.fog, 0, frame.height);
+    }
+}
 
-        //perform DDA
-        while (hit == 0)
-        {
-            //jump to next map square in x-direction, OR in y-direction
-            if (sideDistX < sideDistY)
-            {
-                sideDistX += deltaDistX;
-                mapX[x] += stepX;
-                side[x] = 0; 
-            }
-            else
-            {
-                sideDistY += deltaDistY;
-                mapY[x] += stepY;
-                side[x] = 1;
-            }
-            //Check if ray has hit a wall
-            if (leveldata[mapX[x]][mapY[x]].visible)
-            {
-                if(leveldata[mapX[x]][mapY[x]].isDoor) //sliding door, so check if the door is blocking or not
-                {
-                    double wallX, checkDist;
+void markFloorRows(Frame_Slot &frame, const Frame_Slot &prev, int rowStart, int rowEnd)
+{
+    for(int y = rowStart; y < rowEnd; y++)
+    {
+        if(frame.paletted)
+            expandIndices(gpalette, &frame.indexPixels[y * frame.width], &frame.floorPixels[y * frame.width], frame.width);
+        markRow(frame.floorPixels, frame.floorRowWritten, frame.floorRowDirty, prev.floorPixels, prev.floorRowWritten, y, frame.width, frame.fullUpload);
+    }
+}
 
-                    if (side[x] == 0) //NS wall
-                    {
-                        perpWallDist = (mapX[x] + ((double)stepX * 0.5) - posX + (1 - stepX) / 2) / rayDirX;
+inline int frameBandStart(int size, int bands, int band)
+{
+    return size * band / bands;
+}
 
-                        checkDist = (mapY[x] + stepY - posY + (1 - stepY) / 2) / rayDirY;
+void buildFrameGraph(Task_Graph &graph, Frame_Tasks &tasks)
+{
+    //floor rows and sprite sorting need nothing from the raycast, so they run while the rays are cast. walls, the
+    //fog tables and the sprite clip need every column's span before they can start, and fog rows wait on the tables.
+    //faces and subsample modes work on the whole screen at once, so they're one task
+    const Frame_Slot &frame = *tasks.frame;
+    const bool fog = fogPassNeeded(frame);
+    const int columnBands = tasks.columnBands, rowBands = tasks.rowBands;
+    const int rays = frame.raycastMode == RAYCAST_COLUMNS ? columnBands : 1;
+    clearTaskGraph(graph);
+    for(int band = 0; band < rays; band++)
+        addGraphTask(graph, frameRayTask, &tasks, band);
+    const int columns = graph.count;
+    for(int band = 0; band < columnBands; band++)
+        addTaskDependency(graph, band % rays, addGraphTask(graph, frameColumnsTask, &tasks, band));
+    int sprites = addGraphTask(graph, frameSpritesTask, &tasks, 0);
+    int spriteClip = addGraphTask(graph, frameSpriteClipTask, &tasks, 0);
+    addTaskDependency(graph, sprites, spriteClip);
+    for(int column = 0; column < columnBands; column++)
+        addTaskDependency(graph, columns + column, spriteClip);
+    int fogTables = -1;
+    if(fog)
+    {
+        fogTables = addGraphTask(graph, frameFogTablesTask, &tasks, 0);
+        for(int column = 0; column < columnBands; column++)
+            addTaskDependency(graph, columns + column, fogTables);
+    }
+    for(int band = 0; band < rowBands; band++)
+    {
+        int floor = addGraphTask(graph, frameFloorTask, &tasks, band);
+        int walls = addGraphTask(graph, frameWallsTask, &tasks, band);
+        addTaskDependency(graph, floor, walls);
+        for(int column = 0; column < columnBands; column++)
+            addTaskDependency(graph, columns + column, walls);
+        if(fog)
+            addTaskDependency(graph, fogTables, addGraphTask(graph, frameFogTask, &tasks, band));
+    }
+}
 
-                        wallX = posY + perpWallDist * rayDirY;
-                    }
-                    else  //EW wall
-                    {
-                        perpWallDist = (mapY[x] + ((double)stepY * 0.5) - posY + (1 - stepY) / 2) / rayDirY;
+void frameRayTask(void *data, int band)
+{
+    Frame_Tasks &tasks = *(Frame_Tasks *)data;
+    Frame_Slot &frame = *tasks.frame;
+    if(frame.raycastMode != RAYCAST_COLUMNS)
+    {
+        calcRaycast(frame);
+        return;
+    }
+    int start = frameBandStart(frame.width, tasks.columnBands, band), end = frameBandStart(frame.width, tasks.columnBands, band + 1);
+    castColumns(frame, start, end);
+    fillColumnDepth(frame, start, end);
+}
 
-                        checkDist = (mapX[x] + stepX - posX + (1 - stepX) / 2) / rayDirX;
+void frameColumnsTask(void *data, int band)
+{
+    Frame_Tasks &tasks = *(Frame_Tasks *)data;
+    Frame_Slot &frame = *tasks.frame;
+    calcWallColumns(frame, frameBandStart(frame.width, tasks.columnBands, band), frameBandStart(frame.width, tasks.columnBands, band + 1));
+}
 
-                        wallX = posX + perpWallDist * rayDirX;
-                    }
-                    wallX -= floor((wallX)); //we've determined the where (0 to 1) across the wall that we hit
-                                            //compare that to this wall's timer to see if we hit or keep going
-                    
-                    if(checkDist > perpWallDist)
-                    if(wallX <= leveldata[mapX[x]][mapY[x]].timer)
-                    {
-                        hit = 1;
-                        wallDist[x] = perpWallDist;
-                    }                
-                }
-                else //not a sliding door, definitely a hit
-                {
-                    hit = 1;
+void frameFloorTask(void *data, int band)
+{
+    Frame_Tasks &tasks = *(Frame_Tasks *)data;
+    Frame_Slot &frame = *tasks.frame;
+    drawFloor(frame, *tasks.prev, frameBandStart(frame.height, tasks.rowBands, band), frameBandStart(frame.height, tasks.rowBands, band + 1));
+}
 
-                            //Calculate distance to wall projected on camera direction (Euclidean distance will give fisheye effect!)
-                    if (side[x] == 0)
-                    {
-                        perpWallDist = (mapX[x] - posX + (1 - stepX) / 2);
-                        perpWallDist = perpWallDist / rayDirX;
-                    }
-                    else
-                    {
-                        perpWallDist = (mapY[x] - posY + (1 - stepY) / 2);
-                        perpWallDist = perpWallDist / rayDirY;
-                    }
+void frameWallsTask(void *data, int band)
+{
+    Frame_Tasks &tasks = *(Frame_Tasks *)data;
+    Frame_Slot &frame = *tasks.frame;
+    int start = frameBandStart(frame.height, tasks.rowBands, band), end = frameBandStart(frame.height, tasks.rowBands, band + 1);
+    drawWalls(frame, start, end);
+    markFloorRows(frame, *tasks.prev, start, end);
+}
 
-                    wallDist[x] = perpWallDist; //fill wall distance buffer
-                }          
-            }
-        }
-        //store location and distance of wall straight ahead of player
-        if(x == gscreenWidth / 2)
-        {
-            if (side[x] == 0)
-            {
-                blockAheadDist = std::abs(perpWallDist * rayDirX);
-            }
-            else
-            {
-                blockAheadDist = std::abs(perpWallDist * rayDirY);
-            }            
-            blockAheadX = mapX[x];
-            blockAheadY = mapY[x];
-        }
-        else if(x == 0) //store location of block that's in our leftmost periphery
-        {        
-            blockLeftX = mapX[x];
-            blockLeftY = mapY[x];
-        }
-        else if(x == gscreenWidth -1) //store location of block that's in our rightmost periphery
-        {        
-            blockRightX = mapX[x];
-            blockRightY = mapY[x];
-        }
+void frameFogTask(void *data, int band)
+{
+    Frame_Tasks &tasks = *(Frame_Tasks *)data;
+    Frame_Slot &frame = *tasks.frame;
+    generatefogMask(frame, *tasks.prev, tasks.fog, frameBandStart(frame.height, tasks.rowBands, band), frameBandStart(frame.height, tasks.rowBands, band + 1));
+}
 
-    }
-    if(debugColors)
-        drawWorldGeoFlat(wallDist, side, mapX, mapY);
-    else
-        drawWorldGeoTex(wallDist, side, mapX, mapY);
-    drawSprites(wallDist);
+void frameFogTablesTask(void *data, int band)
+{
+    Frame_Tasks &tasks = *(Frame_Tasks *)data;
+    prepareFog(*tasks.frame, tasks.fog);
 }
 
-void calcFloorDist()
+void frameSpritesTask(void *data, int band)
 {
+    Frame_Tasks &tasks = *(Frame_Tasks *)data;
+    projectSprites(*tasks.frame);
+}
 
-    for(int y = 0; y < ((gscreenHeight / 2) + vertLook); y++)
-    {
-        // Current y position compared to the center of the screen (the horizon)
-        int p = y - ((gscreenHeight / 2) + vertLook);
+void frameSpriteClipTask(void *data, int band)
+{
+    Frame_Tasks &tasks = *(Frame_Tasks *)data;
+    clipSprites(*tasks.frame);
+}
 
-        // Vertical position of the camera.
-        double posZ = (gscreenHeight / 2.0) - (vertHeight * gscreenHeight);
+void presentFrame(Frame_Slot &frame)
+{
+    drawFrame(frame);
+    captureFrame(gcapture, gRenderer); //does nothing unless recording
+    SDL_RenderPresent(gRenderer); //blit back-buffer to screen
 
-        // Horizontal distance from the camera to the floor for the current row.
-        // 0.5 is the z position exactly in the middle between floor and ceiling.
-        double rowDistance = -posZ / p;
+    Uint64 presentTime = SDL_GetPerformanceCounter();
+    latencyPresented(glookLatency, frame.lookSeq, presentTime);
+    latencyPresented(gmoveLatency, frame.moveSeq, presentTime);
+}
+
+void drawFrame(Frame_Slot &frame)
+{
+    //the title bar and hotkeys still look at these
+    blockAheadDist = frame.blockAheadDist;
+    blockAheadX = frame.blockAheadX;
+    blockAheadY = frame.blockAheadY;
+    blockLeftX = frame.blockLeftX;
+    blockLeftY = frame.blockLeftY;
+    blockRightX = frame.blockRightX;
+    blockRightY = frame.blockRightY;
+
+    //clear screen with a dark grey
+    SDL_SetRenderDrawColor(gRenderer, 0x20, 0x20, 0x20, 0xff);
+    SDL_RenderClear(gRenderer);
+    if(frame.debugColors)
+        drawWorldGeoFlat(frame);
+    else
+        drawWorldGeoTex(frame);
+    drawSprites(frame);
+    drawHud(frame);
+    SDL_RenderFlush(gRenderer); //draw all batched commands
+}
 
-        floorDist[y] = rowDistance;
+void uploadDirtyRows(SDL_Texture *tex, const std::vector<Uint32> &pixels, const std::vector<Uint8> &dirty, int width, int height)
+{
+    //one SDL_UpdateTexture per run of consecutive changed rows
+    int y = 0;
+    while(y < height)
+    {
+        if(!dirty[y])
+        {
+            y++;
+            continue;
+        }
+        int runStart = y;
+        while(y < height && dirty[y])
+            y++;
+        SDL_Rect rows = {0, runStart, width, y - runStart};
+        SDL_UpdateTexture(tex, &rows, &pixels[runStart * width], width * sizeof(Uint32));
     }
-    for(int y = ((gscreenHeight / 2) + vertLook); y < gscreenHeight; y++)
+}
+
+void markRow(std::vector<Uint32> &pixels, std::vector<Uint8> &written, std::vector<Uint8> &dirty, const std::vector<Uint32> &prevPixels, const std::vector<Uint8> &prevWritten, int y, int width, bool full)
+{
+    //prev was uploaded right before this frame will be, so if it wrote this row the texture holds exactly its pixels
+    written[y] = 1;
+    dirty[y] = full || !prevWritten[y] || memcmp(&pixels[y * width], &prevPixels[y * width], width * sizeof(Uint32)) != 0;
+}
+
+void updateBlockTimers(Sim_World &world, int inX, int inY, int radius, double percent)
+{
+    for(int y = std::max(inY - radius, 0); y < std::min(world.height, inY + radius + 1); ++y)
     {
-        // Current y position compared to the center of the screen (the horizon)
-        int p = y - ((gscreenHeight / 2) + vertLook);
-        // Vertical position of the camera.
-        double posZ = (gscreenHeight / 2.0) + (vertHeight * gscreenHeight);
+        for(int x = std::max(inX - radius, 0); x < std::min(world.width, inX + radius + 1); ++x)
+        {
+            Map_Block &block = world.level[x][y];
+            if(block.timerOn)
+            {
+                block.timer += percent;
+                if(block.timer < 0.0)
+                {
+                    block.timer = 0.0;
+                    block.timerOn = false;
+                    block.visible = false;
+                    block.solid = false;
+                }
+                else if(block.timer > 1.0)
+                {
+                    block.timer = 1.0;
+                    block.timerOn = false;
+                }
+                Door_State door;
+                door.x = x;
+                door.y = y;
+                door.timer = block.timer;
+                door.timerOn = block.timerOn;
+                door.visible = block.visible;
+                door.solid = block.solid;
+                world.changedDoors.push_back(door);
+            }
+        }
+    }
+}
 
-        // Horizontal distance from the camera to the floor for the current row.
-        // 0.5 is the z position exactly in the middle between floor and ceiling.
-        double rowDistance = posZ / p;
+bool initSim()
+{
+    gsimWorldLock = SDL_CreateMutex();
+    gsimInputLock = SDL_CreateMutex();
+    gsimSnapLock = SDL_CreateMutex();
+    SDL_AtomicSet(&gsimQuit, 0);
+    glookLatency.name = "look";
+    gmoveLatency.name = "move";
+    return gsimWorldLock != NULL && gsimInputLock != NULL && gsimSnapLock != NULL;
+}
 
-        floorDist[y] = rowDistance;
+void startSimThread()
+{
+    SDL_AtomicSet(&gsimQuit, 0);
+    gsimThread = SDL_CreateThread(simThread, "sim", NULL);
+    if(gsimThread == NULL)
+    {
+        printf("Sim thread failed to start. SDL Error: %s\n", SDL_GetError());
     }
+}
 
-    // for(int y = 0; y < gscreenHeight; y++) //define a height table for floor and ceiling calculations later
-    // {
-    //     floorDist[y] = (gscreenHeight*vFOV+(2*vertHeight*gscreenHeight))/ ((2.0*(y-vertLook) - (gscreenHeight)));
-    //     ceilDist[y] = (gscreenHeight*vFOV-(2*vertHeight*gscreenHeight))/ ((2.0*(y+vertLook) - (gscreenHeight)));
-    // }
+void stopSimThread()
+{
+    if(gsimThread != NULL)
+    {
+        SDL_AtomicSet(&gsimQuit, 1);
+        SDL_WaitThread(gsimThread, NULL);
+        gsimThread = NULL;
+    }
 }
 
-void drawWorldGeoFlat(double* wallDist, int* side, int* mapX, int* mapY)
+int simThread(void *data)
 {
-    //draw sky
-    SDL_SetRenderDrawColor(gRenderer, 0x7f, 0xaa, 0xff, 0xff);
-    SDL_RenderFillRect(gRenderer, &gskyDestRect);
-    //draw floor
-    SDL_SetRenderDrawColor(gRenderer, 0x7f, 0x7f, 0x7f, 0xff);
-    SDL_RenderFillRect(gRenderer, &gfloorRect);
-    int lineHeight, drawStart, drawEnd;
-    SDL_Rect wallRect;
-    for (int x = 0; x < gscreenWidth; x++)
-        {
-        lineHeight = (int)(gscreenHeight * vFOV / wallDist[x]);
-        //calculate lowest and highest pixel to fill in current stripe
-        drawStart = -lineHeight / 2 + gscreenHeight / 2;
-        drawEnd = lineHeight / 2 + gscreenHeight / 2;
-        //choose wall color
-        SDL_Color color;
-        switch (leveldata[mapX[x]][mapY[x]].block_id)
-        {
-        case 1:
-            color = cBlue;
-            break;
-        case 2:
-            color = cGreen;
-            break;
-        case 3:
-            color = cRed;
-            break;
-        case 4:
-            color = cWhite;
-            break;
-        default:
-            color = cYellow;
-            break;
-        }
-        //give x and y sides different brightness
-        if (side[x] == 1)
+    const Uint64 freq = SDL_GetPerformanceFrequency();
+    const Uint64 tickLength = freq / simTickRate;
+    const double dt = 1.0 / simTickRate;
+    Uint64 nextTick = SDL_GetPerformanceCounter();
+    Uint64 tick = 0;
+    Sim_Input input;
+
+    while(SDL_AtomicGet(&gsimQuit) == 0)
+    {
+        Uint64 now = SDL_GetPerformanceCounter();
+        if(now < nextTick)
         {
-            color.r = color.r >> 1;
-            color.g = color.g >> 1;
-            color.b = color.b >> 1;
-            color.a = color.a  >> 1;
+            //sleep most of the wait, SDL_Delay is only good to about a millisecond
+            Uint32 waitMs = (Uint32)((nextTick - now) * 1000 / freq);
+            SDL_Delay(waitMs > 1 ? waitMs - 1 : 0);
+            continue;
         }
-
-        //calculate lowest and highest pixel to fill in current stripe
-        drawEnd = (lineHeight / 2) + (gscreenHeight / 2) + ((vertHeight*gscreenHeight) / wallDist[x]) + vertLook;
-        drawStart = drawEnd - lineHeight;
-        if (drawStart < 0)
-            drawStart = 0;
-        if (drawEnd >= gscreenHeight)
-            drawEnd = gscreenHeight - 1;
-
-        //render vertical lines for raycast based on calculations
-
-        
-        
-        wallRect.x = x;
-        wallRect.y = drawStart;
-        wallRect.w = 1;
-        wallRect.h = drawEnd - drawStart;
-        SDL_SetRenderDrawColor(gRenderer, color.r, color.g, color.b, color.a);
-        SDL_RenderFillRect(gRenderer, &wallRect);
+        if(now - nextTick > tickLength * 8) //fell far behind (window drag, debugger). skip ahead instead of fast forwarding
+            nextTick = now;
+
+        SDL_LockMutex(gsimInputLock);
+        input = gsimInput;
+        gsimInput.mouseX = 0; //relative motion and use presses are consumed, held keys carry over
+        gsimInput.mouseY = 0;
+        gsimInput.useCount = 0;
+        SDL_UnlockMutex(gsimInputLock);
+
+        SDL_LockMutex(gsimWorldLock);
+        simStep(gsim, input, dt);
+        simPublish(gsim, ++tick, nextTick);
+        SDL_UnlockMutex(gsimWorldLock);
+
+        nextTick += tickLength;
     }
+    return 0;
 }
 
-void drawWorldGeoTex(double* wallDist, int* side, int* mapX, int* mapY)
+void simStep(Sim_World &world, const Sim_Input &input, double dt)
 {
-    if(ceilingOn == false)
+    Camera_State &cam = world.cam;
+    std::vector<std::vector<Map_Block>> &level = world.level;
+    world.inputSeq = input.inputSeq;
+    world.mouseTotalX = input.mouseTotalX;
+    world.mouseTotalY = input.mouseTotalY;
+
+    double moveSpeed = dt * 4; //value is grid squares / sec
+    double rotSpeed = moveSpeed / 2; //the value is in radians/second
+    if (input.mouseX != 0)
+        rotSpeed = std::abs(input.mouseX) * input.mouseSense * mouseTurnScale;
+
+    if (input.mouseY > 0 && cam.vertLook > ( (-1.0)*gscreenHeight / 2)) // look down
     {
-        drawSkyBox();
+        cam.vertLook -= input.mouseY*input.mouseVertSense;
+        if(cam.vertLook < ( (-1.0)*gscreenHeight / 2))
+            cam.vertLook = ( (-1.0)*gscreenHeight / 2);
     }
-    drawFloor();
-    
-    double cameraX, rayDirX, rayDirY, wallX, brightness;
-    int lineHeight, texX;
-    int drawStart[gscreenWidth], drawEnd[gscreenWidth];
-    int currTexWidth, currTexHeight;
-    
-    for (int x = 0; x < gscreenWidth; x++)
+    else if (input.mouseY < 0 && cam.vertLook < (gscreenHeight / 2)) //look up
     {
-        cameraX = 2 * x / double(gscreenWidth) - 1; //x-coordinate in camera space, or along the x of the camera plane itself
-        rayDirX = dirX + planeX * cameraX; //the XY coord where the vector of this ray crosses the camera plane
-        rayDirY = dirY + planeY * cameraX;
-        //Calculate height of line to draw on screen
-        lineHeight = (int)(gscreenHeight * vFOV / wallDist[x]);
-        int currentWall = 0;
-        if (side[x] == 1 && rayDirY > 0) //NORTH WALL
-            currentWall = NORTH;
-        else if (side[x] == 1 && rayDirY < 0) //SOUTH WALL
-            currentWall = SOUTH;
-        else if (side[x] == 0 && rayDirX < 0) //EAST WALL
-            currentWall = EAST;
-        else //WEST WALL??
-            currentWall = WEST;
-
-        if(leveldata[mapX[x]][mapY[x]].wallTex[currentWall] < totalWallTextures)
-        {
-            gcurrTex = gwallTex[leveldata[mapX[x]][mapY[x]].wallTex[currentWall]];
-        }
-        else
-        {
-            gcurrTex = gwallTex[0];
-        }
-        SDL_QueryTexture(gcurrTex, NULL, NULL, &currTexWidth, &currTexHeight);        
+        cam.vertLook -= input.mouseY*input.mouseVertSense;
+        if(cam.vertLook > (gscreenHeight / 2))
+            cam.vertLook = (gscreenHeight / 2);
+    }
 
-        //calculate value of wallX
-        if (side[x] == 0)
-            wallX = posY + wallDist[x] * rayDirY; //if we hit a NS wall, use y pos, + perpendicular value * y component of vector to get total y offset
-        else
-            wallX = posX + wallDist[x] * rayDirX; //as above, but x value for EW walls
-        wallX -= floor((wallX));                   //subtract away the digits to the left of the decimal point, leaving only the fractional value across the single wall
+    //when running forward or backward while strafing, your total displacement is effectively multplied by sqrt(2)
+    //so we're just dividing speed by sqrt(2) in this situation to limit total displacement to normal values
+    if ((input.forward ^ input.back) && (input.left ^ input.right))
+    {
+        moveSpeed *= 0.707;
+    }
+    //sprint by holding shift
+    if (input.sprint)
+    {
+        moveSpeed *= 1.5;
+    }
+    double xComponent = (cam.dirX / (std::abs(cam.dirX)+std::abs(cam.dirY)));
+    double yComponent = (cam.dirY / (std::abs(cam.dirX)+std::abs(cam.dirY)));
+    if (input.forward) //move forward
+    {
+        // the 0.3 is to try to prevent the player from normally being right up on the wall and clipping through it on corners
+        // they still CAN, but they have to on purpose essentially
+        if (level[int(cam.posX + xComponent * (0.3))][int(cam.posY)].solid == false)
+            if (level[int(cam.posX + xComponent * moveSpeed)][int(cam.posY)].solid == false)
+                cam.posX += (xComponent) * moveSpeed;
+        if (level[int(cam.posX)][int(cam.posY + yComponent * (0.3))].solid == false)
+            if (level[int(cam.posX)][int(cam.posY + yComponent * moveSpeed)].solid == false)
+                cam.posY += yComponent * moveSpeed;
+    }
+    if (input.back) //move backward
+    {
+        if (level[int(cam.posX - xComponent * (0.3))][int(cam.posY)].solid == false)
+            if (level[int(cam.posX - xComponent * moveSpeed)][int(cam.posY)].solid == false)
+                cam.posX -= xComponent * moveSpeed;
+        if (level[int(cam.posX)][int(cam.posY - yComponent * (0.3))].solid == false)
+            if (level[int(cam.posX)][int(cam.posY - yComponent * moveSpeed)].solid == false)
+                cam.posY -= yComponent * moveSpeed;
+    }
+    if (input.left) //strafe left
+    {
+        if (level[int(cam.posX - cam.planeX * (0.3))][int(cam.posY)].solid == false)
+            if (level[int(cam.posX - cam.planeX * moveSpeed)][int(cam.posY)].solid == false)
+                cam.posX -= cam.planeX * (moveSpeed);
+        if (level[int(cam.posX)][int(cam.posY - cam.planeY * (0.3))].solid == false)
+            if (level[int(cam.posX)][int(cam.posY - cam.planeY * moveSpeed)].solid == false)
+                cam.posY -= cam.planeY * (moveSpeed);
+    }
+    if (input.right) //strafe right
+    {
+        if (level[int(cam.posX + cam.planeX * (0.3))][int(cam.posY)].solid == false)
+            if (level[int(cam.posX + cam.planeX * moveSpeed)][int(cam.posY)].solid == false)
+                cam.posX += cam.planeX * moveSpeed;
+        if (level[int(cam.posX)][int(cam.posY + cam.planeY * (0.3))].solid == false)
+            if (level[int(cam.posX)][int(cam.posY + cam.planeY * moveSpeed)].solid == false)
+                cam.posY += cam.planeY * moveSpeed;
+    }
 
+    double oldDirX = cam.dirX;
+    double oldPlaneX = cam.planeX;
+    if ((input.turnLeft || input.mouseX < 0) && input.turnRight == false) //turn left
+    {
+        //redundant key checks prevent either key having priority
+        //both camera direction and camera plane must be rotated
+        cam.dirX = cam.dirX * cos(-rotSpeed) - cam.dirY * sin(-rotSpeed);
+        cam.dirY = oldDirX * sin(-rotSpeed) + cam.dirY * cos(-rotSpeed);
+        cam.planeX = cam.planeX * cos(-rotSpeed) - cam.planeY * sin(-rotSpeed);
+        cam.planeY = oldPlaneX * sin(-rotSpeed) + cam.planeY * cos(-rotSpeed);
+    }
+    else if ((input.turnRight || input.mouseX > 0) && input.turnLeft == false) //turn right
+    {
+        cam.dirX = cam.dirX * cos(rotSpeed) - cam.dirY * sin(rotSpeed);
+        cam.dirY = oldDirX * sin(rotSpeed) + cam.dirY * cos(rotSpeed);
+        cam.planeX = cam.planeX * cos(rotSpeed) - cam.planeY * sin(rotSpeed);
+        cam.planeY = oldPlaneX * sin(rotSpeed) + cam.planeY * cos(rotSpeed);
+    }
+    //keep dir length matched to the FOV and the plane perpendicular to it so rounding can't drift over many ticks
+    double dirLength = std::sqrt(cam.dirX * cam.dirX + cam.dirY * cam.dirY);
+    if(dirLength > 0)
+    {
+        double fovLength = 1.0 / std::tan((input.hFOV * degToRad) / 2);
+        cam.planeX = -cam.dirY / dirLength;
+        cam.planeY = cam.dirX / dirLength;
+        cam.dirX *= fovLength / dirLength;
+        cam.dirY *= fovLength / dirLength;
+    }
 
-        wallX += 1.0 - leveldata[mapX[x]][mapY[x]].timer;
+    if(input.crouch)
+    {
+        cam.vertHeight -= (vertSpeed) * moveSpeed; //screen height corresponds to 1 absolute world unit
+        if(cam.vertHeight < (-0.2))
+            cam.vertHeight = (-0.2);
+    }
+    else if(input.rise)
+    {
+        cam.vertHeight += (vertSpeed) * moveSpeed;
+        if(cam.vertHeight > (0.4))
+            cam.vertHeight = (0.4);
+    }
 
-        //x coordinate on the texture
-        texX = int(wallX * double(currTexWidth)); //determine exact value across the wall texture in pixels
-        if (side[x] == 0 && rayDirX < 0)
-            texX = currTexWidth - texX - 1; //horizontally flip textures so they're drawn properly depending on the side of the cube they're on
-        if (side[x] == 1 && rayDirY > 0)
-            texX = currTexWidth - texX - 1;
+    //use whatever is straight ahead
+    if(input.useCount > 0)
+    {
+        Ray_Hit ahead;
+        castRay(level, cam.posX, cam.posY, cam.dirX, cam.dirY, ahead);
+        double aheadDist = std::abs(ahead.dist * (ahead.side == 0 ? cam.dirX : cam.dirY));
+        if(ahead.found && aheadDist < 1)
+        {
+            switch (level[ahead.mapX][ahead.mapY].block_id)
+            {
+            case BLOCK_WALL:
+                //standard wall;
+                break;
+            case BLOCK_PANEL:
+                //exit panel. loading happens on the main thread
+                world.exitRequested = true;
+                break;
+            case BLOCK_DOOR:
+                //door. picked up by updateBlockTimers below
+                level[ahead.mapX][ahead.mapY].timerOn = true;
+                break;
+            default:
+                //likely, an error;
+                break;
+            }
+        }
+    }
 
-        //calculate lowest and highest pixel to fill in current stripe
-        drawStart[x] = -lineHeight / 2 + (gscreenHeight / 2) + ((vertHeight*gscreenHeight) / wallDist[x]) + vertLook;
-        drawEnd[x] = lineHeight / 2 + (gscreenHeight / 2) + ((vertHeight*gscreenHeight) / wallDist[x]) + vertLook;
-
-        // set up the rectangle to sample the texture for the wall
-        SDL_Rect line = {x, drawStart[x], 1, drawEnd[x] - drawStart[x]};
-        SDL_Rect sample = {texX, 0, 1, currTexHeight};
-
-        //use color mod to darken the wall texture
-        //255 = no color mod, lower values mean darker
-        //currently setup so that NS walls are full brightness, and EW walls are darkened
-        if(side[x] == 0)
-            brightness = 255.0;
-        else
-            brightness = 127.0;
+    std::size_t doorsBefore = world.changedDoors.size();
+    updateBlockTimers(world, int(cam.posX), int(cam.posY), 2, -2.0 * dt); //tell nearby doors to open
+    animateSprites(gspriteAtlas, world.sprites, dt);
 
-        SDL_SetTextureColorMod(gcurrTex, brightness, brightness, brightness);
-        renderTexture(gcurrTex, gRenderer, line, &sample);   
-    }
-    //render distance fog on top of floor/ceiling textures
-    //
-    //THIS IS SLOOOOWWWWW
-    //
-    //TODO: speed up fog map
-    if(fogOn)
+    if(!world.chasers.x.empty())
     {
-        generatefogMask(gfogTex, drawStart, drawEnd, wallDist);
-        SDL_SetTextureBlendMode(gfogTex, SDL_BLENDMODE_BLEND);
-        SDL_RenderCopy(gRenderer, gfogTex, NULL, NULL);
+        if(world.flow.width != world.width || world.flow.height != world.height)
+            resetFlowField(world.flow, world.width, world.height);
+        bool doorOpened = false;
+        for(std::size_t i = doorsBefore; i < world.changedDoors.size(); i++)
+            doorOpened |= !world.changedDoors[i].solid && !world.changedDoors[i].timerOn;
+        updateFlowField(world.flow, level, int(cam.posX), int(cam.posY), doorOpened);
+        stepChasers(world.chasers, world.flow, world.sprites, level, cam.posX, cam.posY, dt);
     }
 }
 
-void drawFloor() //affine mapping accross entire screen, has artifacts
+void simPublish(Sim_World &world, Uint64 tick, Uint64 time)
 {
-    //create some pointers to later access the pixels in the floor and buffer textures
-    void *floorBufferPixels, *floorTexPixels, *ceilTexPixels;
-    int floorBufferPitch, floorTexPitch, ceilTexPitch;//, floorTexX, floorTexY;// lineHeight;
-    int floorTexWidth, floorTexHeight, ceilTexWidth, ceilTexHeight;
-
-    //lock floor textures and a screen buffer texture for read/write operations
-    SDL_LockTexture(gfloorTex, NULL, &floorTexPixels, &floorTexPitch); 
-    SDL_LockTexture(gceilTex, NULL, &ceilTexPixels, &ceilTexPitch);
-    SDL_LockTexture(gfloorBuffer, NULL, &floorBufferPixels, &floorBufferPitch);
-    Uint32 *bufferPixels = (Uint32 *)floorBufferPixels; //access pixel data as a bunch of Uint32s. add handling for 24 bit possibility?
-    Uint32 *ufloorTexPix = (Uint32 *)floorTexPixels;
-    Uint32 *uceilTexPix = (Uint32 *)ceilTexPixels;
+    SDL_LockMutex(gsimSnapLock);
+    std::swap(gsimPrev, gsimCurr); //reuse the old snapshot's storage
+    gsimCurr.tick = tick;
+    gsimCurr.time = time;
+    gsimCurr.cam = world.cam;
+    gsimCurr.sprites = world.sprites;
+    gsimCurr.inputSeq = world.inputSeq;
+    gsimCurr.mouseTotalX = world.mouseTotalX;
+    gsimCurr.mouseTotalY = world.mouseTotalY;
+    gsimPendingDoors.insert(gsimPendingDoors.end(), world.changedDoors.begin(), world.changedDoors.end());
+    if(world.exitRequested)
+        gsimExitPending = true;
+    SDL_UnlockMutex(gsimSnapLock);
+    world.changedDoors.clear();
+    world.exitRequested = false;
+}
 
+void simResetFromView(bool copyLevel)
+{
+    SDL_LockMutex(gsimWorldLock);
+    if(copyLevel || !glevelGeometry)
+        gsim.level = leveldata;
+    else
+    {
+        //same level as the sim already has, only the doors can differ
+        for(std::size_t i = 0; i < glevelGeometry->doorCells.size(); i++)
+        {
+            int x = glevelGeometry->doorCells[i] % mapWidth, y = glevelGeometry->doorCells[i] / mapWidth;
+            gsim.level[x][y] = leveldata[x][y];
+        }
+    }
+    gsim.width = mapWidth;
+    gsim.height = mapHeight;
+    gsim.cam.posX = posX;
+    gsim.cam.posY = posY;
+    gsim.cam.dirX = dirX;
+    gsim.cam.dirY = dirY;
+    gsim.cam.planeX = planeX;
+    gsim.cam.planeY = planeY;
+    gsim.cam.vertLook = vertLook;
+    gsim.cam.vertHeight = vertHeight;
+    gsim.sprites = allSprites;
+    attachChasers(gsim.chasers, gsim.sprites);
+    resetFlowField(gsim.flow, 0, 0);
+    gsim.changedDoors.clear();
+    gsim.exitRequested = false;
+    gsim.inputSeq = ginputSeq; //pending input is thrown away below, count it as handled
+    gsim.mouseTotalX = gsimInput.mouseTotalX; //only the main thread writes these, no need for gsimInputLock
+    gsim.mouseTotalY = gsimInput.mouseTotalY;
+    gsimViewMouseX = gsim.mouseTotalX;
+    gsimViewMouseY = gsim.mouseTotalY;
+
+    SDL_LockMutex(gsimSnapLock);
+    gsimCurr.tick = 0;
+    gsimCurr.time = SDL_GetPerformanceCounter();
+    gsimCurr.cam = gsim.cam;
+    gsimCurr.sprites = gsim.sprites;
+    gsimCurr.inputSeq = gsim.inputSeq;
+    gsimCurr.mouseTotalX = gsim.mouseTotalX;
+    gsimCurr.mouseTotalY = gsim.mouseTotalY;
+    gsimPrev = gsimCurr;
+    gsimPendingDoors.clear();
+    gsimExitPending = false;
+    SDL_UnlockMutex(gsimSnapLock);
+    SDL_UnlockMutex(gsimWorldLock);
+
+    SDL_LockMutex(gsimInputLock);
+    gsimInput.mouseX = 0;
+    gsimInput.mouseY = 0;
+    gsimInput.useCount = 0;
+    SDL_UnlockMutex(gsimInputLock);
+}
 
-    // double floorXWall, floorYWall, currentFloorX, currentFloorY, weight, cameraX, rayDirX, rayDirY, wallX;
-    // double distPlayer;
+void syncSimView()
+{
+    static Sim_Snapshot prev, curr; //static so the sprite vectors keep their storage between frames
+    static std::vector<Door_State> doors;
+    bool exitPending;
+
+    SDL_LockMutex(gsimSnapLock);
+    prev = gsimPrev;
+    curr = gsimCurr;
+    doors.swap(gsimPendingDoors);
+    exitPending = gsimExitPending;
+    gsimExitPending = false;
+    SDL_UnlockMutex(gsimSnapLock);
+
+    if(exitPending)
+    {
+        doors.clear();
+        newlevel(false); //resets the sim from the new level, nothing else to apply this frame
+        return;
+    }
 
-    //get attributes of the floor source texture
-    SDL_QueryTexture(gfloorTex, NULL, NULL, &floorTexWidth, &floorTexHeight);
-    SDL_QueryTexture(gceilTex, NULL, NULL, &ceilTexWidth, &ceilTexHeight);
-    // rayDir for leftmost ray (x = 0) and rightmost ray (x = w)
-    float rayDirX0 = dirX - planeX;
-    float rayDirY0 = dirY - planeY;
-    float rayDirX1 = dirX + planeX;
-    float rayDirY1 = dirY + planeY;
+    for(std::size_t i = 0; i < doors.size(); ++i)
+    {
+        Map_Block &block = leveldata[doors[i].x][doors[i].y];
+        block.timer = doors[i].timer;
+        block.timerOn = doors[i].timerOn;
+        block.visible = doors[i].visible;
+        block.solid = doors[i].solid;
+    }
+    doors.clear();
+    gsimViewSeq = curr.inputSeq;
+    gsimViewMouseX = curr.mouseTotalX;
+    gsimViewMouseY = curr.mouseTotalY;
+
+    //render sits between the last two ticks. alpha is how far we are past the newest one
+    double alpha = (double)(SDL_GetPerformanceCounter() - std::min(curr.time, SDL_GetPerformanceCounter())) / (SDL_GetPerformanceFrequency() / (double)simTickRate);
+    alpha = std::min(1.0, std::max(0.0, alpha));
+    //with late latch the view angle starts from the newest tick and lateLatchView adds whatever is still pending.
+    //interpolating it too would drag the view back behind input that's already been shown
+    double lookAlpha = lateLatchOn ? 1.0 : alpha;
+
+    posX = prev.cam.posX + (curr.cam.posX - prev.cam.posX) * alpha;
+    posY = prev.cam.posY + (curr.cam.posY - prev.cam.posY) * alpha;
+
+    //interpolate the view angle rather than the vectors so the FOV doesn't shrink mid turn
+    double prevAngle = std::atan2(prev.cam.dirY, prev.cam.dirX);
+    double turn = std::atan2(curr.cam.dirY, curr.cam.dirX) - prevAngle;
+    if(turn > M_PI)
+        turn -= 2 * M_PI;
+    else if(turn < -M_PI)
+        turn += 2 * M_PI;
+    double angle = prevAngle + turn * lookAlpha;
+    double dirLength = std::sqrt(curr.cam.dirX * curr.cam.dirX + curr.cam.dirY * curr.cam.dirY);
+    dirX = std::cos(angle) * dirLength;
+    dirY = std::sin(angle) * dirLength;
+    planeX = -std::sin(angle);
+    planeY = std::cos(angle);
+
+    double newLook = prev.cam.vertLook + (curr.cam.vertLook - prev.cam.vertLook) * lookAlpha;
+    double newHeight = prev.cam.vertHeight + (curr.cam.vertHeight - prev.cam.vertHeight) * alpha;
+    if(newLook != vertLook || newHeight != vertHeight)
+    {
+        vertLook = newLook;
+        vertHeight = newHeight;
+        updateVerticalView();
+    }
 
-    if(ceilingOn)
+    allSprites = curr.sprites;
+    if(prev.sprites.size() == curr.sprites.size())
     {
-        for(int y = 0; y < ((gscreenHeight / 2) + vertLook); y++)
+        for(std::size_t i = 0; i < allSprites.size(); ++i)
         {
-            // // Current y position compared to the center of the screen (the horizon)
-            // int p = y - ((gscreenHeight / 2) + vertLook);
+            allSprites[i].worldX = prev.sprites[i].worldX + (curr.sprites[i].worldX - prev.sprites[i].worldX) * alpha;
+            allSprites[i].worldY = prev.sprites[i].worldY + (curr.sprites[i].worldY - prev.sprites[i].worldY) * alpha;
+        }
+    }
+}
+
+void updateVerticalView()
+{
+    calcFloorDist(floorDist, gscreenHeight, vertLook, vertHeight);
+    int tw, th;
+    SDL_QueryTexture(gskyTex, NULL, NULL, &tw, &th);
+    gskySrcRect.y = (int)std::round(((double)th/2.0 - (double)gskySrcRect.h/2.0) - ((double)vertLook * ((double)gskySrcRect.h/(double)gskyDestRect.h)));
+    if(gskySrcRect.y > th - gskySrcRect.h)
+        gskySrcRect.y = th - gskySrcRect.h;
+    if (gskySrcRect.y < 0)
+        gskySrcRect.y = 0;
+
+    gfloorRect.y = gscreenHeight / 2 + vertLook;
+    gfloorRect.h = gscreenHeight - gfloorRect.y;
+}
 
-            // // Vertical position of the camera.
-            // float posZ = (gscreenHeight / 2.0) - (vertHeight * gscreenHeight);
+void lateLatchView()
+{
+    //last chance to pick up mouse motion before the frame thread starts casting rays
+    int mouseXDist = 0, mouseYDist = 0;
+    SDL_PumpEvents();
+    SDL_GetRelativeMouseState(&mouseXDist, &mouseYDist);
 
-            // // Horizontal distance from the camera to the floor for the current row.
-            // // 0.5 is the z position exactly in the middle between floor and ceiling.
-            // float rowDistance = -posZ / p;
+    SDL_LockMutex(gsimInputLock);
+    if(mouseXDist != 0 || mouseYDist != 0)
+    {
+        gsimInput.mouseX += mouseXDist;
+        gsimInput.mouseY += mouseYDist;
+        gsimInput.mouseTotalX += mouseXDist;
+        gsimInput.mouseTotalY += mouseYDist;
+        gsimInput.inputSeq = ++ginputSeq;
+        latencyInputSeen(glookLatency, ginputSeq, SDL_GetPerformanceCounter());
+    }
+    //measured against the totals syncSimView took with the camera, not the sim's unconsumed motion. a tick in
+    //between would otherwise take motion the view hasn't got yet, or the view would get it twice
+    double pendingX = (double)(gsimInput.mouseTotalX - gsimViewMouseX);
+    double pendingY = (double)(gsimInput.mouseTotalY - gsimViewMouseY);
+    SDL_UnlockMutex(gsimInputLock);
 
-            // calculate the real world step vector we have to add for each x (parallel to camera plane)
-            // adding step by step avoids multiplications with a weight in the inner loop
-            // float floorStepX = rowDistance * (rayDirX1 - rayDirX0) / gscreenWidth;
-            // float floorStepY = rowDistance * (rayDirY1 - rayDirY0) / gscreenWidth;
-            float floorStepX = floorDist[y] * (rayDirX1 - rayDirX0) / gscreenWidth;
-            float floorStepY = floorDist[y] * (rayDirY1 - rayDirY0) / gscreenWidth;
+    if(!lateLatchOn)
+        return;
 
+    //same turn and look the sim will apply on its next tick
+    if(pendingX != 0)
+    {
+        double rot = pendingX * mouseSense * mouseTurnScale;
+        double oldDirX = dirX;
+        double oldPlaneX = planeX;
+        dirX = dirX * cos(rot) - dirY * sin(rot);
+        dirY = oldDirX * sin(rot) + dirY * cos(rot);
+        planeX = planeX * cos(rot) - planeY * sin(rot);
+        planeY = oldPlaneX * sin(rot) + planeY * cos(rot);
+    }
+    if(pendingY != 0)
+    {
+        vertLook -= pendingY * mouseVertSense;
+        vertLook = std::min((double)(gscreenHeight / 2), std::max((-1.0) * gscreenHeight / 2, vertLook));
+        updateVerticalView();
+    }
+}
 
-            // real world coordinates of the leftmost column. This will be updated as we step to the right.
-            // float floorX = posX + rowDistance * rayDirX0;
-            // float floorY = posY + rowDistance * rayDirY0;
-            float floorX = posX + floorDist[y] * rayDirX0;
-            float floorY = posY + floorDist[y] * rayDirY0;
+void updateLatencyReport()
+{
+    Uint64 now = SDL_GetPerformanceCounter();
+    if(glatencyReportTime == 0)
+        glatencyReportTime = now;
+    if(now - glatencyReportTime >= (Uint64)(latencyReportInterval * SDL_GetPerformanceFrequency()))
+    {
+        latencyReport(glookLatency);
+        latencyReport(gmoveLatency);
+        glatencyReportTime = now;
+    }
+}
 
+void calcRaycast(Frame_Slot &frame)
+{
+    //ACTUAL RAYCAST LOGIC
+    if(frame.raycastMode == RAYCAST_FACES)
+        calcRaycastFaces(frame);
+    else if(frame.raycastMode == RAYCAST_SUBSAMPLE)
+        calcRaycastSubsampled(frame);
+    else
+        castColumns(frame, 0, frame.width);
+    fillColumnDepth(frame, 0, frame.width);
+}
 
-            for(int x = 0; x < gscreenWidth; ++x)
-            {
-                // the cell coord is simply got from the integer parts of floorX and floorY
-                int cellX = (int)(floorX);
-                int cellY = (int)(floorY);
+void fillColumnDepth(Frame_Slot &frame, int start, int end)
+{
+    const int scale = frame.aux.scale;
+    for(int ax = (start + scale - 1) / scale; ax < (int)frame.aux.columnDepth.size() && ax * scale < end; ax++)
+        frame.aux.columnDepth[ax] = frame.blockID[ax * scale] < 0 ? auxSkyDepth : frame.wallDist[ax * scale];
+}
 
-                // get the texture coordinate from the fractional part
-                int tx = (int)(floorTexWidth * (floorX - cellX)) & (floorTexWidth - 1);
-                int ty = (int)(floorTexHeight * (floorY - cellY)) & (floorTexHeight - 1);
+template<typename Cell_Visitor>
+void castColumn(Frame_Slot &frame, int x, Cell_Visitor &visit)
+{
+    const Camera_State &cam = frame.cam;
+    //calculate ray position and direction
+    double cameraX = 2 * x / double(frame.width) - 1; //x-coordinate in camera space, or along the x of the camera plane itself
+                                                      //cameraX ranges from -1 to 1, with 0 being center of camera screen
+    double rayDirX = cam.dirX + cam.planeX * cameraX; //the XY coord where the vector of this ray crosses the camera plane
+    double rayDirY = cam.dirY + cam.planeY * cameraX; //
+    Ray_Hit hit;
+    castRay(*frame.level, cam.posX, cam.posY, rayDirX, rayDirY, hit, frame.maxRayDist, visit);
+    storeColumnHit(frame, x, hit, rayDirX, rayDirY);
+}
 
-                floorX += floorStepX;
-                floorY += floorStepY;
+void castColumn(Frame_Slot &frame, int x)
+{
+    No_Cell_Visitor visit;
+    castColumn(frame, x, visit);
+}
 
-                Uint32 color;
-                //ceiling (symmetrical, at screenHeight - y - 1 instead of y)
-                color = uceilTexPix[ceilTexWidth * ty + tx];
-                //color = (color >> 1) & 8355711; // make a bit darker
-                bufferPixels[gscreenWidth * y + x] = color;
-            }        
+void castColumns(Frame_Slot &frame, int start, int end)
+{
+    for (int x = start; x < end; x++)
+        castColumn(frame, x);
+}
 
+void storeColumnHit(Frame_Slot &frame, int x, Ray_Hit &hit, double rayDirX, double rayDirY)
+{
+    const Camera_State &cam = frame.cam;
+    const std::vector<std::vector<Map_Block>> &level = *frame.level;
+    if(!hit.found)
+    {
+        //nothing within reach. the column becomes a fog wall at the distance the ray got to
+        hit.dist = std::max(hit.dist, minClipDist);
+        hit.mapX = std::min(std::max(int(cam.posX + hit.dist * rayDirX), 0), (int)level.size() - 1);
+        hit.mapY = std::min(std::max(int(cam.posY + hit.dist * rayDirY), 0), (int)level[hit.mapX].size() - 1);
+    }
+    double perpWallDist = hit.dist;
+    frame.wallDist[x] = hit.dist; //fill wall distance buffer
+    frame.side[x] = hit.side;
+    frame.mapX[x] = hit.mapX;
+    frame.mapY[x] = hit.mapY;
+    frame.blockID[x] = hit.found ? level[hit.mapX][hit.mapY].block_id : -1;
+    frame.raySteps[x] = hit.steps;
+
+    //store location and distance of wall straight ahead of player
+    if(x == frame.width / 2)
+    {
+        if (hit.side == 0)
+        {
+            frame.blockAheadDist = std::abs(perpWallDist * rayDirX);
+        }
+        else
+        {
+            frame.blockAheadDist = std::abs(perpWallDist * rayDirY);
         }
-    }    
-    for(int y = ((gscreenHeight / 2) + vertLook); y < gscreenHeight; y++)
+        frame.blockAheadX = hit.mapX;
+        frame.blockAheadY = hit.mapY;
+    }
+    else if(x == 0) //store location of block that's in our leftmost periphery
     {
-            // // Current y position compared to the center of the screen (the horizon)
-            // int p = y - ((gscreenHeight / 2) + vertLook);
-            // // Vertical position of the camera.
-            // float posZ = (gscreenHeight / 2.0) + (vertHeight * gscreenHeight);
-
-            // // Horizontal distance from the camera to the floor for the current row.
-            // // 0.5 is the z position exactly in the middle between floor and ceiling.
-            // float rowDistance = posZ / p;
+        frame.blockLeftX = hit.mapX;
+        frame.blockLeftY = hit.mapY;
+    }
+    else if(x == frame.width -1) //store location of block that's in our rightmost periphery
+    {
+        frame.blockRightX = hit.mapX;
+        frame.blockRightY = hit.mapY;
+    }
+}
 
-            // calculate the real world step vector we have to add for each x (parallel to camera plane)
-            // adding step by step avoids multiplications with a weight in the inner loop
-            // float floorStepX = rowDistance * (rayDirX1 - rayDirX0) / gscreenWidth;
-            // float floorStepY = rowDistance * (rayDirY1 - rayDirY0) / gscreenWidth;
+//which way column x's ray leaves a cell, as an index into flowStepX/flowStepY (+x, -x, +y, -y).
+//same rule as the DDA in castRay: the x side only goes first if it's strictly nearer
+int spanExit(const Frame_Slot &frame, int cellX, int cellY, int x)
+{
+    const Camera_State &cam = frame.cam;
+    double cameraX = 2 * x / double(frame.width) - 1;
+    double rayDirX = cam.dirX + cam.planeX * cameraX;
+    double rayDirY = cam.dirY + cam.planeY * cameraX;
+    double exitX = (rayDirX == 0) ? 1e30 : ((rayDirX < 0 ? cellX : cellX + 1) - cam.posX) / rayDirX;
+    double exitY = (rayDirY == 0) ? 1e30 : ((rayDirY < 0 ? cellY : cellY + 1) - cam.posY) / rayDirY;
+    if (exitX < exitY)
+        return rayDirX < 0 ? 1 : 0;
+    return rayDirY < 0 ? 3 : 2;
+}
 
-            float floorStepX = floorDist[y] * (rayDirX1 - rayDirX0) / gscreenWidth;
-            float floorStepY = floorDist[y] * (rayDirY1 - rayDirY0) / gscreenWidth;
+//true if every ray that reaches cell (cellX, cellY) has already stopped at maxRayDist
+bool cellBeyondClip(const Frame_Slot &frame, int cellX, int cellY)
+{
+    if(frame.maxRayDist >= rayNoLimit)
+        return false;
+    //how far along the view direction the nearest corner of the cell is
+    const Camera_State &cam = frame.cam;
+    double dirLengthSq = cam.dirX * cam.dirX + cam.dirY * cam.dirY;
+    double nearest = rayNoLimit;
+    for(int corner = 0; corner < 4; corner++)
+        nearest = std::min(nearest, ((cellX + (corner & 1) - cam.posX) * cam.dirX + (cellY + (corner >> 1) - cam.posY) * cam.dirY) / dirLengthSq);
+    return nearest > frame.maxRayDist;
+}
 
-            // real world coordinates of the leftmost column. This will be updated as we step to the right.
-            // float floorX = posX + rowDistance * rayDirX0;
-            // float floorY = posY + rowDistance * rayDirY0;
+//columns [start, end) all cross edge exit into the wall at (wallX, wallY). same distance formula castRay ends with,
+//so the results match it exactly
+void fillFaceColumns(Frame_Slot &frame, int wallX, int wallY, int exit, int start, int end)
+{
+    const Camera_State &cam = frame.cam;
+    int stepX = flowStepX[exit], stepY = flowStepY[exit];
+    int side = exit < 2 ? 0 : 1;
+    for(int c = start; c < end; c++)
+    {
+        double cameraX = 2 * c / double(frame.width) - 1;
+        double rayDirX = cam.dirX + cam.planeX * cameraX;
+        double rayDirY = cam.dirY + cam.planeY * cameraX;
+        Ray_Hit hit;
+        Ray_Real dist;
+        if (side == 0)
+        {
+            dist = (wallX - Ray_Real(cam.posX) + (1 - stepX) / 2);
+            dist = dist / Ray_Real(rayDirX);
+            hit.face = stepX < 0 ? EAST : WEST;
+        }
+        else
+        {
+            dist = (wallY - Ray_Real(cam.posY) + (1 - stepY) / 2);
+            dist = dist / Ray_Real(rayDirY);
+            hit.face = stepY > 0 ? NORTH : SOUTH;
+        }
+        hit.dist = realToDouble(dist);
+        if(hit.dist > frame.maxRayDist * 0.999) //too close to the clip to be sure the DDA agrees
+        {
+            castColumn(frame, c);
+            continue;
+        }
+        hit.side = side;
+        hit.mapX = wallX;
+        hit.mapY = wallY;
+        hit.found = true;
+        storeColumnHit(frame, c, hit, rayDirX, rayDirY);
+    }
+}
 
-            float floorX = posX + floorDist[y] * rayDirX0;
-            float floorY = posY + floorDist[y] * rayDirY0;
+void calcRaycastFaces(Frame_Slot &frame)
+{
+    //portal style: every column starts in the player's cell. a cell splits the columns it holds by the edge their rays
+    //leave through, since rays are sorted by angle each edge gets one run of columns, found with a binary search.
+    //runs that cross into an open cell carry on from there, runs that cross into a wall are solved in one go.
+    //the work grows with the number of cell edges on screen, not with the number of columns.
+    //doors, the map edge and anything past maxRayDist fall back to the ordinary DDA for their columns
+    const Camera_State &cam = frame.cam;
+    const std::vector<std::vector<Map_Block>> &level = *frame.level;
+    const int mapW = level.size();
+    const int mapH = mapW > 0 ? level[0].size() : 0;
+    std::vector<Cell_Span> &spans = frame.cellSpans;
+    spans.clear();
+
+    Cell_Span first;
+    first.cellX = int(std::floor(cam.posX));
+    first.cellY = int(std::floor(cam.posY));
+    first.start = 0;
+    first.end = frame.width;
+    if(first.cellX < 0 || first.cellY < 0 || first.cellX >= mapW || first.cellY >= mapH)
+    {
+        for (int x = 0; x < frame.width; x++)
+            castColumn(frame, x);
+        return;
+    }
+    spans.push_back(first);
 
-            for(int x = 0; x < gscreenWidth; ++x)
+    while(!spans.empty())
+    {
+        Cell_Span span = spans.back();
+        spans.pop_back();
+        int x = span.start;
+        while(x < span.end)
+        {
+            //this run is every column from x on that leaves through the same edge
+            int exit = spanExit(frame, span.cellX, span.cellY, x);
+            int low = x + 1, high = span.end;
+            while(low < high)
             {
-                // the cell coord is simply got from the integer parts of floorX and floorY
-                int cellX = (int)(floorX);
-                int cellY = (int)(floorY);
-
-                // get the texture coordinate from the fractional part
-                int tx = (int)(floorTexWidth * (floorX - cellX)) & (floorTexWidth - 1);
-                int ty = (int)(floorTexHeight * (floorY - cellY)) & (floorTexHeight - 1);
-
-                floorX += floorStepX;
-                floorY += floorStepY;
+                int mid = low + (high - low) / 2;
+                if(spanExit(frame, span.cellX, span.cellY, mid) == exit)
+                    low = mid + 1;
+                else
+                    high = mid;
+            }
+            int runEnd = low;
 
-                Uint32 color;
+            int stepX = flowStepX[exit], stepY = flowStepY[exit];
+            int nextX = span.cellX + stepX, nextY = span.cellY + stepY;
+            bool inside = nextX >= 0 && nextY >= 0 && nextX < mapW && nextY < mapH;
+            const Map_Block *block = inside ? &level[nextX][nextY] : NULL;
+            bool beyondClip = inside && cellBeyondClip(frame, nextX, nextY);
 
-                // floor
-                color = ufloorTexPix[floorTexWidth * ty + tx];
-                //color = (color >> 1) & 8355711; // make a bit darker
-                bufferPixels[gscreenWidth * y + x] = color;
-            }     
+            if(!inside || beyondClip || (block->visible && block->isDoor))
+            {
+                for(int c = x; c < runEnd; c++)
+                    castColumn(frame, c);
+            }
+            else if(!block->visible)
+            {
+                Cell_Span next;
+                next.cellX = nextX;
+                next.cellY = nextY;
+                next.start = x;
+                next.end = runEnd;
+                spans.push_back(next);
+            }
+            else
+            {
+                fillFaceColumns(frame, nextX, nextY, exit, x, runEnd);
+            }
+            x = runEnd;
+        }
     }
-    //Render floor by unlocking floor textures and buffer, and copying the entire buffer onto the render target in one go
-    //Unlock texture
-    SDL_UnlockTexture(gfloorTex);
-    SDL_UnlockTexture(gceilTex);
-    SDL_UnlockTexture(gfloorBuffer);
-    SDL_SetTextureBlendMode(gfloorBuffer, SDL_BLENDMODE_BLEND);
-    if(ceilingOn)
-        SDL_RenderCopy(gRenderer, gfloorBuffer, NULL, NULL);
-    else
-        SDL_RenderCopy(gRenderer, gfloorBuffer, &gfloorRect, &gfloorRect);
 }
 
-
-//draw floor using vertical stripes, much slower but fewer artifacts
-//this is the only reason to keep the floor and ceiling distance buffers
-void drawFloor(double* wallDist, int* drawStart, int* drawEnd, int* side, int* mapX, int* mapY)
+void calcRaycastSubsampled(Frame_Slot &frame)
 {
-    //create some pointers to later access the pixels in the floor and buffer textures
-    void *floorBufferPixels, *floorTexPixels, *ceilTexPixels;
-    int floorBufferPitch, floorTexPitch, ceilTexPitch, floorTexX, floorTexY;
-    int floorTexWidth, floorTexHeight, ceilTexWidth, ceilTexHeight;
+    //a full DDA ray every raycastStride columns. if two of them pass through exactly the same cells, every ray between
+    //them crosses the same cell edges in the same order and ends on the same face, so those columns are filled in with
+    //castRay's own distance formula. wherever the two disagree, at corners, edges and doors, the columns between
+    //get their own DDA rays
+    const std::vector<std::vector<Map_Block>> &level = *frame.level;
+    if(frame.width <= 0)
+        return;
+    Cell_Trail leftVisit(frame.leftTrail), rightVisit(frame.rightTrail);
+    int left = 0;
+    frame.leftTrail.clear();
+    castColumn(frame, 0, leftVisit);
+    while(left < frame.width - 1)
+    {
+        int right = std::min(left + raycastStride, frame.width - 1);
+        frame.rightTrail.clear();
+        castColumn(frame, right, rightVisit);
+        bool filled = false;
+        std::size_t cells = frame.rightTrail.size();
+        if(right - left > 1 && frame.blockID[left] >= 0 && frame.blockID[right] >= 0 && cells >= 2 && frame.leftTrail == frame.rightTrail
+           && !level[frame.mapX[right]][frame.mapY[right]].isDoor)
+        {
+            //the last step into the wall says which face it was
+            int fromX = frame.rightTrail[cells - 2].x, fromY = frame.rightTrail[cells - 2].y;
+            int exit = frame.mapX[right] > fromX ? 0 : frame.mapX[right] < fromX ? 1 : frame.mapY[right] > fromY ? 2 : 3;
+            fillFaceColumns(frame, frame.mapX[right], frame.mapY[right], exit, left + 1, right);
+            filled = true;
+        }
+        if(!filled)
+            for(int c = left + 1; c < right; c++)
+                castColumn(frame, c);
+        std::swap(frame.leftTrail, frame.rightTrail);
+        left = right;
+    }
+}
 
-    //lock floor textures and a screen buffer texture for read/write operations
+double fogClipDist(const Frame_Slot &frame)
+{
+    //fog brightness is playerFog / (fogMultiplier * brightSin * fovScale * dist^2), never below worldFog.
+    //brightSin is smallest (1) in the middle of the screen, so that's where fog reaches fogClipBrightness last.
+    //if worldFog keeps it above that, far walls stay faintly visible and there's nothing to clip
+    if(!frame.fogOn || frame.debugColors || frame.worldFog > fogClipBrightness)
+        return rayNoLimit;
+    double fovScale = (90.0 / frame.hFOV) * (90.0 / frame.hFOV);
+    return std::sqrt(frame.playerFog / (frame.fogMultiplier * fovScale * fogClipBrightness));
+}
 
-    SDL_LockTexture(gfloorTex, NULL, &floorTexPixels, &floorTexPitch); 
-    SDL_LockTexture(gceilTex, NULL, &ceilTexPixels, &ceilTexPitch);
-    SDL_LockTexture(gfloorBuffer, NULL, &floorBufferPixels, &floorBufferPitch);
+template<typename Real>
+int wallTexColumn(double posX, double posY, double wallDist, double rayDirX, double rayDirY, int side, double slide, int texWidth)
+{
+    //calculate value of wallX
+    Real wallX;
+    if (side == 0)
+        wallX = Real(posY) + Real(wallDist) * Real(rayDirY); //if we hit a NS wall, use y pos, + perpendicular value * y component of vector to get total y offset
+    else
+        wallX = Real(posX) + Real(wallDist) * Real(rayDirX); //as above, but x value for EW walls
+    wallX -= realFloor(wallX);                   //subtract away the digits to the left of the decimal point, leaving only the fractional value across the single wall
+    wallX += Real(slide);
+    return realToInt(wallX * Real(texWidth)); //determine exact value across the wall texture in pixels
+}
+
+void calcWallColumns(Frame_Slot &frame, int start, int end)
+{
+    const Camera_State &cam = frame.cam;
+    double cameraX, rayDirX, rayDirY;
+    int lineHeight, texX;
+    int currTexWidth;
+    
+    for (int x = start; x < end; x++)
+    {
+        cameraX = 2 * x / double(frame.width) - 1; //x-coordinate in camera space, or along the x of the camera plane itself
+        rayDirX = cam.dirX + cam.planeX * cameraX; //the XY coord where the vector of this ray crosses the camera plane
+        rayDirY = cam.dirY + cam.planeY * cameraX;
+        const Map_Block &block = (*frame.level)[frame.mapX[x]][frame.mapY[x]]; //the cell where the ray stopped if it hit nothing
+        //Calculate height of line to draw on screen
+        lineHeight = (int)(frame.height * vFOV / frame.wallDist[x]);
+        int currentWall = 0;
+        if (frame.side[x] == 1 && rayDirY > 0) //NORTH WALL
+            currentWall = NORTH;
+        else if (frame.side[x] == 1 && rayDirY < 0) //SOUTH WALL
+            currentWall = SOUTH;
+        else if (frame.side[x] == 0 && rayDirX < 0) //EAST WALL
+            currentWall = EAST;
+        else //WEST WALL??
+            currentWall = WEST;
+        frame.wallFace[x] = currentWall;
+
+        if(frame.blockID[x] >= 0 && block.wallTex[currentWall] < totalWallTextures)
+        {
+            frame.wallTex[x] = block.wallTex[currentWall];
+        }
+        else
+        {
+            frame.wallTex[x] = 0;
+        }
+        currTexWidth = gwallTexels[frame.wallTex[x]].levels[0].w;
+
+        //x coordinate on the texture. doors slide along the wall by how far they are open
+        texX = wallTexColumn<Ray_Real>(cam.posX, cam.posY, frame.wallDist[x], rayDirX, rayDirY, frame.side[x], frame.blockID[x] >= 0 ? 1.0 - block.timer : 0.0, currTexWidth);
+        if (frame.side[x] == 0 && rayDirX < 0)
+            texX = currTexWidth - texX - 1; //horizontally flip textures so they're drawn properly depending on the side of the cube they're on
+        if (frame.side[x] == 1 && rayDirY > 0)
+            texX = currTexWidth - texX - 1;
+        frame.texX[x] = texX;
+
+        //calculate lowest and highest pixel to fill in current stripe
+        frame.drawStart[x] = -lineHeight / 2 + (frame.height / 2) + ((cam.vertHeight*frame.height) / frame.wallDist[x]) + cam.vertLook;
+        frame.drawEnd[x] = lineHeight / 2 + (frame.height / 2) + ((cam.vertHeight*frame.height) / frame.wallDist[x]) + cam.vertLook;
+    }
+}
+
+void calcFloorDist(double *rowDist, int screenHeight, double look, double height)
+{
+
+    for(int y = 0; y < ((screenHeight / 2) + look); y++)
+    {
+        // Current y position compared to the center of the screen (the horizon)
+        int p = y - ((screenHeight / 2) + look);
+
+        // Vertical position of the camera.
+        double posZ = (screenHeight / 2.0) - (height * screenHeight);
+
+        // Horizontal distance from the camera to the floor for the current row.
+        // 0.5 is the z position exactly in the middle between floor and ceiling.
+        double rowDistance = -posZ / p;
+
+        rowDist[y] = rowDistance;
+    }
+    for(int y = ((screenHeight / 2) + look); y < screenHeight; y++)
+    {
+        // Current y position compared to the center of the screen (the horizon)
+        int p = y - ((screenHeight / 2) + look);
+        // Vertical position of the camera.
+        double posZ = (screenHeight / 2.0) + (height * screenHeight);
+
+        // Horizontal distance from the camera to the floor for the current row.
+        // 0.5 is the z position exactly in the middle between floor and ceiling.
+        double rowDistance = posZ / p;
+
+        rowDist[y] = rowDistance;
+    }
+
+    // for(int y = 0; y < gscreenHeight; y++) //define a height table for floor and ceiling calculations later
+    // {
+    //     floorDist[y] = (gscreenHeight*vFOV+(2*vertHeight*gscreenHeight))/ ((2.0*(y-vertLook) - (gscreenHeight)));
+    //     ceilDist[y] = (gscreenHeight*vFOV-(2*vertHeight*gscreenHeight))/ ((2.0*(y+vertLook) - (gscreenHeight)));
+    // }
+}
+
+void drawWorldGeoFlat(const Frame_Slot &frame)
+{
+    //draw sky
+    SDL_SetRenderDrawColor(gRenderer, 0x7f, 0xaa, 0xff, 0xff);
+    SDL_RenderFillRect(gRenderer, &gskyDestRect);
+    //draw floor
+    SDL_SetRenderDrawColor(gRenderer, 0x7f, 0x7f, 0x7f, 0xff);
+    SDL_RenderFillRect(gRenderer, &frame.floorRect);
+    int lineHeight, drawStart, drawEnd;
+    SDL_Rect wallRect;
+    for (int x = 0; x < frame.width; x++)
+        {
+        lineHeight = (int)(gscreenHeight * vFOV / frame.wallDist[x]);
+        //calculate lowest and highest pixel to fill in current stripe
+        drawStart = -lineHeight / 2 + gscreenHeight / 2;
+        drawEnd = lineHeight / 2 + gscreenHeight / 2;
+        //choose wall color
+        SDL_Color color;
+        switch (frame.blockID[x])
+        {
+        case -1:
+            color = fogColor;
+            break;
+        case 1:
+            color = cBlue;
+            break;
+        case 2:
+            color = cGreen;
+            break;
+        case 3:
+            color = cRed;
+            break;
+        case 4:
+            color = cWhite;
+            break;
+        default:
+            color = cYellow;
+            break;
+        }
+        //give x and y sides different brightness
+        if (frame.side[x] == 1)
+        {
+            color.r = color.r >> 1;
+            color.g = color.g >> 1;
+            color.b = color.b >> 1;
+            color.a = color.a  >> 1;
+        }
+
+        //calculate lowest and highest pixel to fill in current stripe
+        drawEnd = (lineHeight / 2) + (gscreenHeight / 2) + ((frame.cam.vertHeight*gscreenHeight) / frame.wallDist[x]) + frame.cam.vertLook;
+        drawStart = drawEnd - lineHeight;
+        if (drawStart < 0)
+            drawStart = 0;
+        if (drawEnd >= gscreenHeight)
+            drawEnd = gscreenHeight - 1;
+
+        //render vertical lines for raycast based on calculations
+
+        
+        
+        wallRect.x = x;
+        wallRect.y = drawStart;
+        wallRect.w = 1;
+        wallRect.h = drawEnd - drawStart;
+        SDL_SetRenderDrawColor(gRenderer, color.r, color.g, color.b, color.a);
+        SDL_RenderFillRect(gRenderer, &wallRect);
+    }
+}
+
+void drawWorldGeoTex(const Frame_Slot &frame)
+{
+    if(frame.ceilingOn == false)
+    {
+        drawSkyBox(frame);
+    }
+
+    //floor, ceiling and walls were all drawn on the frame thread, only changed rows get sent to the gpu.
+    //without a ceiling the rows above the horizon are transparent where the sky shows through
+    uploadDirtyRows(gfloorBuffer, frame.floorPixels, frame.floorRowDirty, frame.width, frame.height);
+    SDL_SetTextureBlendMode(gfloorBuffer, SDL_BLENDMODE_BLEND);
+    SDL_RenderCopy(gRenderer, gfloorBuffer, NULL, NULL);
+    //render distance fog on top of floor/ceiling textures
+    if(fogPassNeeded(frame))
+    {
+        uploadDirtyRows(gfogTex, frame.fogPixels, frame.fogRowDirty, frame.width, frame.height);
+        SDL_SetTextureBlendMode(gfogTex, SDL_BLENDMODE_BLEND);
+        SDL_RenderCopy(gRenderer, gfogTex, NULL, NULL);
+    }
+}
+
+void drawFloor(Frame_Slot &frame, const Frame_Slot &prev, int rowStart, int rowEnd) //affine mapping accross entire screen, has artifacts
+{
+    //runs on the frame thread, so texels come from the texel store instead of locking the textures
+    const int width = frame.width;
+    const int height = frame.height;
+    const double *rowDist = &frame.floorDist[0];
+    const Camera_State &cam = frame.cam;
+    Uint32 *bufferPixels = &frame.floorPixels[0];
+    const int horizon = std::min(height, std::max(0, (int)((height / 2) + cam.vertLook)));
+
+    // rayDir for leftmost ray (x = 0) and rightmost ray (x = w)
+    Floor_Real rayDirX0 = cam.dirX - cam.planeX;
+    Floor_Real rayDirY0 = cam.dirY - cam.planeY;
+    Floor_Real rayDirX1 = cam.dirX + cam.planeX;
+    Floor_Real rayDirY1 = cam.dirY + cam.planeY;
+    Aux_Buffers &aux = frame.aux;
+    const bool auxOn = !aux.depth.empty() || !aux.surface.empty();
+    const double fovScale = (90.0/frame.hFOV) * (90.0/frame.hFOV);
+
+    //interlaced: cast only the rows of one parity and take the others from the previous frame. a floor point at
+    //column cx of a row sits at prev distance along + d * (dirAlong + cx * planeAlong) and prev column offset
+    //across + d * (dirAcross + cx * planeAcross) in prev's dir and plane units. looking up or down only moves the
+    //horizon, so the prev row is found by distance on prev's side of prev's horizon. a turn tilts the row across
+    //prev's rows, so every floorReprojectSpan columns look up their own source row. prev cast the other parity,
+    //those are the rows worth copying from
+    bool reproject = frame.floorParity >= 0; //prepareFloor picked the parity
+    const int sourceStep = prev.floorParity < 0 ? 1 : 2; //rows of prev that were cast
+    double along = 0, dirAlong = 0, planeAlong = 0, across = 0, dirAcross = 0, planeAcross = 0;
+    int prevHorizon = horizon;
+    if(reproject)
+    {
+        const Camera_State &prevCam = prev.cam;
+        double moveX = cam.posX - prevCam.posX, moveY = cam.posY - prevCam.posY;
+        double dirLength2 = prevCam.dirX * prevCam.dirX + prevCam.dirY * prevCam.dirY;
+        double planeLength2 = prevCam.planeX * prevCam.planeX + prevCam.planeY * prevCam.planeY;
+        along = (moveX * prevCam.dirX + moveY * prevCam.dirY) / dirLength2;
+        dirAlong = (cam.dirX * prevCam.dirX + cam.dirY * prevCam.dirY) / dirLength2;
+        planeAlong = (cam.planeX * prevCam.dirX + cam.planeY * prevCam.dirY) / dirLength2;
+        across = (moveX * prevCam.planeX + moveY * prevCam.planeY) / planeLength2;
+        dirAcross = (cam.dirX * prevCam.planeX + cam.dirY * prevCam.planeY) / planeLength2;
+        planeAcross = (cam.planeX * prevCam.planeX + cam.planeY * prevCam.planeY) / planeLength2;
+        prevHorizon = std::min(height, std::max(0, (int)((height / 2) + prevCam.vertLook)));
+    }
+
+    for(int y = rowStart; y < rowEnd; y++)
+    {
+        Uint32 *row = bufferPixels + width * y;
+        bool isCeiling = y < horizon;
+        bool auxRow = auxOn && (y % aux.scale == 0);
+        if(isCeiling && !frame.ceilingOn)
+        {
+            //sky shows through here, walls get drawn on top afterwards
+            std::fill(row, row + width, 0);
+            if(frame.paletted)
+                std::fill(frame.indexPixels.begin() + width * y, frame.indexPixels.begin() + width * (y + 1), paletteTransparent);
+            if(auxRow)
+            {
+                int ay = y / aux.scale;
+                if(!aux.depth.empty())
+                    std::fill(aux.depth.begin() + ay * aux.width, aux.depth.begin() + (ay + 1) * aux.width, auxSkyDepth);
+                if(!aux.surface.empty())
+                    std::fill(aux.surface.begin() + ay * aux.width, aux.surface.begin() + (ay + 1) * aux.width, auxSurface(0, AUX_FACE_SKY));
+            }
+            continue;
+        }
+        // calculate the real world step vector we have to add for each x (parallel to camera plane)
+        // adding step by step avoids multiplications with a weight in the inner loop
+        Floor_Real floorStepX = rowDist[y] * realToDouble(rayDirX1 - rayDirX0) / width;
+        Floor_Real floorStepY = rowDist[y] * realToDouble(rayDirY1 - rayDirY0) / width;
+
+        //mip level from how far apart neighbouring pixels land on the texture, across the row and down to the next one
+        const Texel_Mips &mips = isCeiling ? gceilTexels : gfloorTexels;
+        int level = 0;
+        if(frame.mipmapsOn)
+        {
+            double acrossStep = realLength(floorStepX, floorStepY);
+            double downStep = std::abs(rowDist[y] - rowDist[(y + 1 < height) ? y + 1 : y - 1]);
+            level = mipLevel(mips, std::max(acrossStep, downStep) * mips.levels[0].w);
+        }
+        const Texel_Image &tex = mips.levels[level];
+        //z-order lookups: texel (tx,ty) is at xIndex[tx] + yIndex[ty]. sides are powers of two so masks wrap them
+        const Uint32 *texels = &tex.texels[0];
+        const Uint32 *xIndex = &tex.xIndex[0];
+        const Uint32 *yIndex = &tex.yIndex[0];
+        const int texWidth = tex.w, texHeight = tex.h;
+
+        // real world coordinates of the leftmost column. This will be updated as we step to the right.
+        Floor_Real floorX = cam.posX + rowDist[y] * realToDouble(rayDirX0);
+        Floor_Real floorY = cam.posY + rowDist[y] * realToDouble(rayDirY0);
+
+        if(frame.paletted)
+        {
+            //palette indices, fogged through the colormap of each pixel's fog level
+            Uint8 *indexRow = &frame.indexPixels[width * y];
+            const Uint8 *indices = &tex.indices[0];
+            int texturedEnd = rowDist[y] < frame.maxRayDist ? width : 0;
+            std::fill(indexRow + texturedEnd, indexRow + width, frame.fogIndex);
+            double rowFog = frame.playerFog / (frame.fogMultiplier * rowDist[y] * rowDist[y] * fovScale);
+            for(int x = 0; x < texturedEnd; ++x)
+            {
+                int cellX = realToInt(floorX);
+                int cellY = realToInt(floorY);
+                int tx = realToInt(texWidth * (floorX - cellX)) & (texWidth - 1);
+                int ty = realToInt(texHeight * (floorY - cellY)) & (texHeight - 1);
+                floorX += floorStepX;
+                floorY += floorStepY;
+                Uint8 index = indices[xIndex[tx] + yIndex[ty]];
+                if(frame.fogOn)
+                    index = colormap(frame.colormaps, 0, paletteFogLevel(frame, rowFog * invBrightSin[x]))[index];
+                indexRow[x] = index;
+            }
+        }
+        else
+        {
+            //rows past the clip distance are all fog, don't texture them at all
+            int texturedEnd = rowDist[y] < frame.maxRayDist ? width : 0;
+            std::fill(row + texturedEnd, row + width, frame.fogPixel);
+            if(reproject && y % 2 != frame.floorParity && texturedEnd > 0)
+            {
+                //start looking where a pure look up or down would have put this row
+                const double dist = rowDist[y];
+                int source = y + prevHorizon - horizon;
+                for(int spanStart = 0; spanStart < texturedEnd; spanStart += floorReprojectSpan)
+                {
+                    int spanEnd = std::min(texturedEnd, spanStart + floorReprojectSpan);
+                    double spanCx = (spanStart + spanEnd) / (double)width - 1.0;
+                    int found = floorSourceRow(prev, source, isCeiling, along + dist * (dirAlong + spanCx * planeAlong), prevHorizon, sourceStep);
+                    int copyStart = spanStart, copyEnd = spanStart;
+                    if(found >= 0)
+                    {
+                        //prev column for x is sourceX + x * sourceScale, walked in 16.16 fixed point. columns that
+                        //land off prev's screen are cast as usual
+                        source = found;
+                        const Uint32 *sourceRow = &prev.floorHistory[found * width];
+                        const double sourceDist = prev.floorDist[found];
+                        double sourceScale = dist * planeAcross / sourceDist;
+                        double sourceX = width / 2.0 + width * (across + dist * (dirAcross - planeAcross)) / (2.0 * sourceDist) + 0.5;
+                        Sint64 fixedStep = (Sint64)(sourceScale * 65536.0);
+                        Sint64 fixedStart = (Sint64)(sourceX * 65536.0);
+                        copyEnd = spanEnd;
+                        while(copyStart < copyEnd && fixedStart + copyStart * fixedStep < 0)
+                            copyStart++;
+                        while(copyEnd > copyStart && ((fixedStart + (copyEnd - 1) * fixedStep) >> 16) >= width)
+                            copyEnd--;
+                        Sint64 fixedX = fixedStart + copyStart * fixedStep;
+                        for(int x = copyStart; x < copyEnd; ++x)
+                        {
+                            row[x] = sourceRow[fixedX >> 16];
+                            fixedX += fixedStep;
+                        }
+                    }
+                    for(int x = spanStart; x < spanEnd; ++x)
+                    {
+                        if(x == copyStart)
+                            x = copyEnd;
+                        if(x >= spanEnd)
+                            break;
+                        Floor_Real pointX = floorX + x * floorStepX, pointY = floorY + x * floorStepY;
+                        int cellX = realToInt(pointX);
+                        int cellY = realToInt(pointY);
+                        int tx = realToInt(texWidth * (pointX - cellX)) & (texWidth - 1);
+                        int ty = realToInt(texHeight * (pointY - cellY)) & (texHeight - 1);
+                        row[x] = texels[xIndex[tx] + yIndex[ty]];
+                    }
+                }
+            }
+            else
+            {
+                for(int x = 0; x < texturedEnd; ++x)
+                {
+                    // the cell coord is simply got from the integer parts of floorX and floorY
+                    int cellX = realToInt(floorX);
+                    int cellY = realToInt(floorY);
+
+                    // get the texture coordinate from the fractional part
+                    int tx = realToInt(texWidth * (floorX - cellX)) & (texWidth - 1);
+                    int ty = realToInt(texHeight * (floorY - cellY)) & (texHeight - 1);
+
+                    floorX += floorStepX;
+                    floorY += floorStepY;
+
+                    //ceiling rows use the ceiling texture, floor rows the floor texture
+                    row[x] = texels[xIndex[tx] + yIndex[ty]];
+                }
+                //fresh rows are what the next frame reprojects from
+                if(frame.floorInterlace)
+                    std::copy(row, row + width, frame.floorHistory.begin() + y * width);
+            }
+
+        }
+        if(auxRow)
+        {
+            //the same row walked again at aux resolution, only to find which cell each sample lands in
+            int ay = y / aux.scale;
+            int face = isCeiling ? AUX_FACE_CEILING : AUX_FACE_FLOOR;
+            const std::vector<std::vector<Map_Block>> &level = *frame.level;
+            Floor_Real rowX = cam.posX + rowDist[y] * realToDouble(rayDirX0);
+            Floor_Real rowY = cam.posY + rowDist[y] * realToDouble(rayDirY0);
+            for(int ax = 0; ax < aux.width; ax++)
+            {
+                if(!aux.depth.empty())
+                    aux.depth[ay * aux.width + ax] = rowDist[y];
+                if(!aux.surface.empty())
+                {
+                    int cellX = realToInt(realFloor(rowX + ax * aux.scale * floorStepX));
+                    int cellY = realToInt(realFloor(rowY + ax * aux.scale * floorStepY));
+                    bool inside = cellX >= 0 && cellY >= 0 && cellX < (int)level.size() && cellY < (int)level[cellX].size();
+                    aux.surface[ay * aux.width + ax] = auxSurface(inside ? level[cellX][cellY].block_id : 0, face);
+                }
+            }
+        }
+    }
+    //walls go on top of this in drawWalls, then renderFrame works out which rows changed
+}
+
+void prepareFloor(Frame_Slot &frame, const Frame_Slot &prev)
+{
+    //interlaced frames cast the rows prev didn't, as long as the camera has only moved a little since prev
+    bool reproject = frame.floorInterlace && floorReprojectable(frame, prev);
+    frame.floorParity = reproject ? (prev.floorParity == 0 ? 1 : 0) : -1;
+    frame.floorHistoryValid = frame.floorInterlace;
+}
+
+//colormap level for a pixel with fog term playerFog / (fogMultiplier * brightSin * fovScale * dist^2). same curve as generatefogMask
+inline int paletteFogLevel(const Frame_Slot &frame, double fog)
+{
+    double brightness = std::min(1.0, std::max(frame.worldFog, std::min(frame.playerFog, fog)));
+    return (int)((1.0 - brightness) * (paletteFogLevels - 1) + 0.5);
+}
+
+bool floorReprojectable(const Frame_Slot &frame, const Frame_Slot &prev)
+{
+    //slides, looking up or down, crouching and small turns all keep each floor point near a row prev cast. big
+    //turns and jumps cast the whole floor
+    if(&prev == &frame || !prev.floorHistoryValid || prev.width != frame.width || prev.height != frame.height)
+        return false;
+    const Camera_State &cam = frame.cam, &prevCam = prev.cam;
+    if(frame.ceilingOn != prev.ceilingOn || frame.mipmapsOn != prev.mipmapsOn || frame.maxRayDist != prev.maxRayDist)
+        return false;
+    double turn = std::atan2(cam.dirX * prevCam.dirY - cam.dirY * prevCam.dirX, cam.dirX * prevCam.dirX + cam.dirY * prevCam.dirY);
+    if(std::abs(turn) > floorReprojectMaxTurn)
+        return false;
+    double moveX = cam.posX - prevCam.posX, moveY = cam.posY - prevCam.posY;
+    return moveX * moveX + moveY * moveY <= floorReprojectMaxMove * floorReprojectMaxMove;
+}
+
+//the row source cast that is nearest to showing the floor (or ceiling) at dist, searched from start. -1 if dist
+//falls outside the rows that side of source's horizon has or the nearest one is fog
+int floorSourceRow(const Frame_Slot &source, int start, bool ceiling, double dist, int horizon, int rowStep)
+{
+    const double *rowDist = &source.floorDist[0];
+    const int first = ceiling ? 0 : horizon;
+    const int end = ceiling ? horizon : source.height;
+    if(dist <= 0 || !std::isfinite(dist) || end - first < rowStep)
+        return -1;
+    //only rows of source's own parity were cast
+    int row = std::min(end - 1, std::max(first, start));
+    if(rowStep > 1 && row % 2 != source.floorParity)
+        row += row + 1 < end ? 1 : -1;
+    //rows get nearer moving away from the horizon, on both sides
+    int dir = ceiling == (dist < rowDist[row]) ? -1 : 1;
+    while(row + dir * rowStep >= first && row + dir * rowStep < end
+          && std::abs(rowDist[row + dir * rowStep] - dist) < std::abs(rowDist[row] - dist))
+        row += dir * rowStep;
+    //further from the nearest row than rows are from each other means it's off the end of that side
+    int inner = row - dir * rowStep;
+    if(inner < first || inner >= end)
+        inner = row + dir * rowStep;
+    if(inner >= first && inner < end && std::abs(rowDist[row] - dist) > std::abs(rowDist[row] - rowDist[inner]))
+        return -1;
+    if(rowDist[row] >= source.maxRayDist)
+        return -1;
+    return row;
+}
+
+void drawWalls(Frame_Slot &frame, int rowStart, int rowEnd)
+{
+    //one textured column per x, written straight into the frame buffer.
+    //wall textures are stored column major so each column reads its texels in order
+    const int width = frame.width;
+    const int height = frame.height;
+    const double fovScale = (90.0/frame.hFOV) * (90.0/frame.hFOV);
+    Uint32 *bufferPixels = &frame.floorPixels[0];
+    Aux_Buffers &aux = frame.aux;
+    const bool auxOn = !aux.depth.empty() || !aux.surface.empty();
+
+    for(int x = 0; x < width; x++)
+    {
+        int lineHeight = frame.drawEnd[x] - frame.drawStart[x];
+        if(lineHeight <= 0 || frame.drawEnd[x] <= rowStart || frame.drawStart[x] >= rowEnd)
+            continue;
+        bool fogWall = frame.blockID[x] < 0;
+        if(auxOn && x % aux.scale == 0)
+        {
+            int ax = x / aux.scale;
+            Uint32 surface = fogWall ? auxSurface(0, AUX_FACE_SKY) : auxSurface(frame.blockID[x], frame.wallFace[x]);
+            float depth = fogWall ? auxSkyDepth : frame.wallDist[x];
+            for(int ay = auxCeil(aux, std::max(rowStart, frame.drawStart[x])); ay * aux.scale < std::min(rowEnd, frame.drawEnd[x]); ay++)
+            {
+                if(!aux.depth.empty())
+                    aux.depth[ay * aux.width + ax] = depth;
+                if(!aux.surface.empty())
+                    aux.surface[ay * aux.width + ax] = surface;
+            }
+        }
+        if(fogWall)
+        {
+            //the ray gave up before reaching a wall, fill the column with fog instead
+            Uint32 *dest = bufferPixels + std::max(rowStart, frame.drawStart[x]) * width + x;
+            for(int y = std::max(rowStart, frame.drawStart[x]); y < std::min(rowEnd, frame.drawEnd[x]); y++, dest += width)
+                *dest = frame.fogPixel;
+            if(frame.paletted)
+                for(int y = std::max(rowStart, frame.drawStart[x]); y < std::min(rowEnd, frame.drawEnd[x]); y++)
+                    frame.indexPixels[y * width + x] = frame.fogIndex;
+            continue;
+        }
+        //far walls squeeze many texels into each pixel, use a smaller copy of the texture instead
+        const Texel_Mips &mips = gwallTexels[frame.wallTex[x]];
+        int level = frame.mipmapsOn ? mipLevel(mips, mips.levels[0].h * frame.wallDist[x] / (height * vFOV)) : 0;
+        const Texel_Image &tex = mips.levels[level];
+        int yStart = std::max(rowStart, frame.drawStart[x]);
+        int yEnd = std::min(rowEnd, frame.drawEnd[x]);
+        //a ray that just grazes a part open door's edge lands one column past the texture, or one before it once flipped
+        int texX = std::min(std::max(frame.texX[x], 0), mips.levels[0].w - 1) * tex.w / mips.levels[0].w;
+
+        //16.16 fixed point walk down the texture column
+        Uint32 step = (Uint32)(((Uint64)tex.h << 16) / lineHeight);
+        Uint32 texPos = (Uint32)(yStart - frame.drawStart[x]) * step;
+
+        if(frame.paletted)
+        {
+            //side shading and the column's fog in one colormap
+            int fogLevel = 0;
+            if(frame.fogOn)
+                fogLevel = paletteFogLevel(frame, frame.playerFog / (frame.fogMultiplier * frame.wallDist[x] * frame.wallDist[x] * fovScale) * invBrightSin[x]);
+            const Uint8 *map = colormap(frame.colormaps, frame.side[x] != 0, fogLevel);
+            const Uint8 *column = indexColumn(tex, texX);
+            Uint8 *dest = &frame.indexPixels[yStart * width + x];
+            for(int y = yStart; y < yEnd; y++)
+            {
+                *dest = map[column[std::min(texPos >> 16, (Uint32)tex.h - 1)]];
+                dest += width;
+                texPos += step;
+            }
+            continue;
+        }
+        const Uint32 *column = texelColumn(tex, texX);
+
+        //NS walls are full brightness, EW walls are darkened (the old color mod of 127)
+        Uint32 *dest = bufferPixels + yStart * width + x;
+        if(frame.side[x] == 0)
+        {
+            for(int y = yStart; y < yEnd; y++)
+            {
+                *dest = column[std::min(texPos >> 16, (Uint32)tex.h - 1)];
+                dest += width;
+                texPos += step;
+            }
+        }
+        else
+        {
+            for(int y = yStart; y < yEnd; y++)
+            {
+                *dest = texelDarken(column[std::min(texPos >> 16, (Uint32)tex.h - 1)]);
+                dest += width;
+                texPos += step;
+            }
+        }
+    }
+}
+
+
+//draw floor using vertical stripes, much slower but fewer artifacts
+//this is the only reason to keep the floor and ceiling distance buffers
+void drawFloor(double* wallDist, int* drawStart, int* drawEnd, int* side, int* mapX, int* mapY)
+{
+    //texels come from the texel store, only the screen buffer needs locking
+    void *floorBufferPixels;
+    int floorBufferPitch, floorTexX, floorTexY;
+    const int floorTexWidth = gfloorTexels.levels[0].w, floorTexHeight = gfloorTexels.levels[0].h;
+    const int ceilTexWidth = gceilTexels.levels[0].w, ceilTexHeight = gceilTexels.levels[0].h;
+
+    SDL_LockTexture(gfloorBuffer, NULL, &floorBufferPixels, &floorBufferPitch);
 
     Uint32 *bufferPixels = (Uint32 *)floorBufferPixels; //access pixel data as a bunch of Uint32s. add handling for 24 bit possibility?
-    Uint32 *ufloorTexPix = (Uint32 *)floorTexPixels;
-    Uint32 *uceilTexPix = (Uint32 *)ceilTexPixels;
 
 
     double floorXWall, floorYWall, currentFloorX, currentFloorY, weight, cameraX, rayDirX, rayDirY, wallX;
@@ -1068,9 +2678,6 @@ void drawFloor(double* wallDist, int* drawStart, int* drawEnd, int* side, int* m
             drawEnd[x] = gscreenHeight; 
 
 
-        //get attributes of the floor source texture
-        SDL_QueryTexture(gfloorTex, NULL, NULL, &floorTexWidth, &floorTexHeight); //get height and width of floor tile texture
-
         //draw floor in vertical stripe from bottom of wall to bottom of screen
         for (int y = drawEnd[x]; y < gscreenHeight; y++)
         {
@@ -1084,12 +2691,11 @@ void drawFloor(double* wallDist, int* drawStart, int* drawEnd, int* side, int* m
             floorTexY = int(currentFloorY * floorTexHeight) % floorTexHeight;
 
             //set destination pixel to the selected pixel from the source
-            bufferPixels[y * gscreenWidth + x] = ufloorTexPix[floorTexWidth * floorTexY + floorTexX];
+            bufferPixels[y * gscreenWidth + x] = texelAt(gfloorTexels.levels[0], floorTexX, floorTexY);
         }
         
         if(ceilingOn)
         {
-            SDL_QueryTexture(gceilTex, NULL, NULL, &ceilTexWidth, &ceilTexHeight); //get ceiling tile texture width and height
             for (int y = gscreenHeight - drawStart[x]; y < gscreenHeight; y++)
             {
                 
@@ -1100,15 +2706,13 @@ void drawFloor(double* wallDist, int* drawStart, int* drawEnd, int* side, int* m
                 floorTexX = int(currentFloorX * ceilTexWidth) % ceilTexWidth;
                 floorTexY = int(currentFloorY * ceilTexHeight) % ceilTexHeight;
 
-                bufferPixels[(gscreenHeight - y - 1) * gscreenWidth + x] = uceilTexPix[ceilTexWidth * floorTexY + floorTexX];
+                bufferPixels[(gscreenHeight - y - 1) * gscreenWidth + x] = texelAt(gceilTexels.levels[0], floorTexX, floorTexY);
             }
         }
     }
 
     //Render floor by unlocking floor textures and buffer, and copying the entire buffer onto the render target in one go
     //Unlock texture
-    SDL_UnlockTexture(gfloorTex);
-    SDL_UnlockTexture(gceilTex);
     SDL_UnlockTexture(gfloorBuffer);
     SDL_SetTextureBlendMode(gfloorBuffer, SDL_BLENDMODE_BLEND);
     if(ceilingOn)
@@ -1118,16 +2722,17 @@ void drawFloor(double* wallDist, int* drawStart, int* drawEnd, int* side, int* m
     
 }
 
-void drawSkyBox()
+void drawSkyBox(const Frame_Slot &frame)
 {
     //Here I'm creating a sky box and rotating it according to player's viewing angle
     //trying to match drawn sky segment to FOV
     
-    double angle = atan2(dirY, dirX) * radToDeg; // gets view dir in degrees
+    double angle = atan2(frame.cam.dirY, frame.cam.dirX) * radToDeg; // gets view dir in degrees
 
     if (angle < 0)
         angle += 360;
     
+    SDL_Rect skySrcRect = frame.skySrcRect; //vertical position was set when the frame started
     int tw, th;
     SDL_QueryTexture(gskyTex, NULL, NULL, &tw, &th); //get texture width and height
     angle *= (double)tw/360.0; //converts 360 degress to texture width
@@ -1137,163 +2742,210 @@ void drawSkyBox()
             angle -= tw;
         if (angle < 0)
             angle += tw;
-    gskySrcRect.x = angle;
-    if(tw - gskySrcRect.x < gskySrcRect.w) //reached end of texture and need to draw sky in two parts
+    skySrcRect.x = angle;
+    if(tw - skySrcRect.x < skySrcRect.w) //reached end of texture and need to draw sky in two parts
     {
         //draw first part, wrap to 0, draw rest
-        SDL_Rect tempSrc = gskySrcRect;
+        SDL_Rect tempSrc = skySrcRect;
         SDL_Rect tempDest = gskyDestRect;
         tempSrc.w = tw - tempSrc.x;
-        tempDest.w = (int)((double)tempSrc.w * ((double)gskyDestRect.w / (double)gskySrcRect.w));
+        tempDest.w = (int)((double)tempSrc.w * ((double)gskyDestRect.w / (double)skySrcRect.w));
         SDL_RenderCopy(gRenderer, gskyTex, &tempSrc, &tempDest);
 
         tempSrc.x = 0;
-        tempSrc.w = gskySrcRect.w - tempSrc.w;
+        tempSrc.w = skySrcRect.w - tempSrc.w;
         tempDest.x += tempDest.w;
         tempDest.w = gskyDestRect.w - tempDest.w;
         SDL_RenderCopy(gRenderer, gskyTex, &tempSrc, &tempDest);
 
     }
     else //safe to draw entire sky rect at once
-        SDL_RenderCopy(gRenderer, gskyTex, &gskySrcRect, &gskyDestRect); //now paste our chunk of sky onto the renderer
+        SDL_RenderCopy(gRenderer, gskyTex, &skySrcRect, &gskyDestRect); //now paste our chunk of sky onto the renderer
 }
 
-void drawSprites(double* wallDist)
+void projectSprites(Frame_Slot &frame)
 {
+    //everything here comes from the camera, so it runs while the rays are cast. clipSprites cuts each sprite
+    //against the walls afterwards and drawSprites hands them to the renderer
+    const std::vector<Game_Sprite> &sprites = frame.sprites;
+    const Camera_State &cam = frame.cam;
+    const int screenWidth = frame.width, screenHeight = frame.height;
 
     //TODO do a better job of sorting sprites
-    for(std::size_t i = 0; i != allSprites.size(); ++i)
-    {
-        spriteDistances[i] = ((posX - allSprites[i].worldX)*(posX - allSprites[i].worldX)+(posY - allSprites[i].worldY)*(posY - allSprites[i].worldY));
-        spriteOrder[i] = i;
-    }
-    //void sortSprites(int* order, double* dist, int amount)
-    int amount = allSprites.size();
+    int amount = sprites.size();
     std::vector<std::pair<double, int>> sortSpritePair(amount);
     for(int i = 0; i < amount; i++) {
-        sortSpritePair[i].first = spriteDistances[i];
-        sortSpritePair[i].second = spriteOrder[i];
+        sortSpritePair[i].first = ((cam.posX - sprites[i].worldX)*(cam.posX - sprites[i].worldX)+(cam.posY - sprites[i].worldY)*(cam.posY - sprites[i].worldY));
+        sortSpritePair[i].second = i;
     }
     std::sort(sortSpritePair.begin(), sortSpritePair.end());
-    // restore in reverse order to go from farthest to nearest
-    for(int i = 0; i < amount; i++) {
-        spriteDistances[i] = sortSpritePair[amount - i - 1].first;
-        spriteOrder[i] = sortSpritePair[amount - i - 1].second;
-    }
 
     double brightness;
 
-    double invDet = 1.0 / (planeX * dirY - dirX * planeY); //required for correct matrix multiplication
+    double invDet = 1.0 / (cam.planeX * cam.dirY - cam.dirX * cam.planeY); //required for correct matrix multiplication
 
-    for(auto i = 0; i < amount; ++i)
+    frame.spriteDraws.clear();
+    for(int i = amount - 1; i >= 0; --i) //farthest to nearest
     {
-        double spriteX = allSprites[spriteOrder[i]].worldX - posX;
-        double spriteY = allSprites[spriteOrder[i]].worldY - posY;
+        const int index = sortSpritePair[i].second;
+        double spriteX = sprites[index].worldX - cam.posX;
+        double spriteY = sprites[index].worldY - cam.posY;
 
         //transform sprite with the inverse camera matrix
         // [ planeX   dirX ] -1                                       [ dirY      -dirX ]
         // [               ]       =  1/(planeX*dirY-dirX*planeY) *   [                 ]
         // [ planeY   dirY ]                                          [ -planeY  planeX ]
 
-        double transformY = invDet * (-planeY * spriteX + planeX * spriteY); //this is actually the depth inside the screen, that what Z is in 3D
-        if(transformY > 0) //transformY values < 0 are behind player
-        {
-            double transformX = invDet * (dirY * spriteX - dirX * spriteY);
-            int spriteScreenX = int((gscreenWidth / 2) * (1 + transformX / transformY));
-
-            int spriteHeight = abs(int(gscreenHeight / (transformY))); //using 'transformY' instead of the real distance prevents fisheye
-
-
-            //calculate lowest and highest pixel to fill in current stripe   
-            int drawEndY = spriteHeight / 2 + gscreenHeight / 2 + (vertHeight * abs(int(gscreenHeight / (transformY)))) + vertLook;
-
-            spriteHeight *= allSprites[spriteOrder[i]].height;
+        double transformY = invDet * (-cam.planeY * spriteX + cam.planeX * spriteY); //this is actually the depth inside the screen, that what Z is in 3D
+        if(transformY <= 0) //transformY values < 0 are behind player
+            continue;
+        double transformX = invDet * (cam.dirY * spriteX - cam.dirX * spriteY);
+        int spriteScreenX = int((screenWidth / 2) * (1 + transformX / transformY));
 
-            int drawStartY = drawEndY - spriteHeight;
+        int spriteHeight = abs(int(screenHeight / (transformY))); //using 'transformY' instead of the real distance prevents fisheye
 
-            //calculate width of the sprite
-            int spriteWidth = abs( int (gscreenHeight / (transformY))) * allSprites[spriteOrder[i]].width;        
-            int drawEndX = spriteWidth / 2 + spriteScreenX;
-            int drawStartX = drawEndX - spriteWidth;
 
-            SDL_Rect clip, dest;
-            clip.x = drawStartX;
-            clip.y = drawStartY;
-            clip.w = drawEndX - drawStartX;
-            clip.h = drawEndY - drawStartY;
-            dest = clip;
+        //calculate lowest and highest pixel to fill in current stripe   
+        int drawEndY = spriteHeight / 2 + screenHeight / 2 + (cam.vertHeight * abs(int(screenHeight / (transformY)))) + cam.vertLook;
 
-            if(drawStartX < 0) drawStartX = 0;
-            if(drawEndX >= gscreenWidth) drawEndX = gscreenWidth - 1;
-            clip.x = drawStartX;
-            clip.w = drawEndX - drawStartX;
+        spriteHeight *= sprites[index].height;
 
-            for(auto testX = drawStartX; testX <= drawEndX+1; testX++)
-            {
-                clip.x = testX;
-                if(transformY < wallDist[testX])
-                    break;
-            }
-            for(auto testX = drawEndX; testX >= clip.x; --testX)
-            {
-                clip.w = testX-clip.x;
-                if(transformY < wallDist[testX])
-                    break;
-            }
+        int drawStartY = drawEndY - spriteHeight;
 
+        //calculate width of the sprite
+        int spriteWidth = abs( int (screenHeight / (transformY))) * sprites[index].width;        
+        int drawEndX = spriteWidth / 2 + spriteScreenX;
+        int drawStartX = drawEndX - spriteWidth;
 
-            if(clip.y < 0) clip.y = 0;
-            if(clip.y+clip.h >= gscreenHeight) clip.h = gscreenHeight - clip.y - 1;
+        Sprite_Draw draw;
+        draw.sprite = index;
+        draw.depth = transformY;
+        SDL_Rect &clip = draw.clip;
+        clip.x = drawStartX;
+        clip.y = drawStartY;
+        clip.w = drawEndX - drawStartX;
+        clip.h = drawEndY - drawStartY;
+        draw.dest = clip;
 
-            if(clip.x+clip.w >= 0 && clip.x < gscreenWidth)
-            {
-                SDL_RenderSetClipRect(gRenderer, &clip);
-                SDL_SetTextureBlendMode(pickupTex[allSprites[spriteOrder[i]].texID], SDL_BLENDMODE_BLEND);
-                SDL_RenderCopy(gRenderer, pickupTex[allSprites[spriteOrder[i]].texID], &allSprites[spriteOrder[i]].image, &dest);
-
-                if(fogOn && (!debugColors))
-                {
-                    int shadowX = std::min(std::max(dest.x + (dest.w/2),0),gscreenWidth-1);        
-                    transformY *= (90.0/hFOV);     
-                    brightness = std::min(1.0,std::max(worldFog,std::min(playerFog,playerFog/((fogMultiplier* brightSin[shadowX]) * transformY * transformY))));  
-                    brightness = std::max(std::min(brightness, playerFog),worldFog);
-
-                    fogColor.a = (Uint8)255.0*(1.0-std::min(1.0,std::max(worldFog, brightness)));
-                    SDL_SetTextureBlendMode(maskTex[allSprites[spriteOrder[i]].texID], SDL_BLENDMODE_BLEND);
-                    SDL_SetTextureColorMod(maskTex[allSprites[spriteOrder[i]].texID], fogColor.r, fogColor.g, fogColor.b);
-                    SDL_SetTextureAlphaMod(maskTex[allSprites[spriteOrder[i]].texID], fogColor.a);
-                    SDL_RenderCopy(gRenderer, maskTex[allSprites[spriteOrder[i]].texID], &allSprites[spriteOrder[i]].image, &dest);
-                }
+        //clipSprites narrows the columns down to the ones in front of the walls
+        if(drawStartX < 0) drawStartX = 0;
+        if(drawEndX >= screenWidth) drawEndX = screenWidth - 1;
+        clip.x = drawStartX;
+        clip.w = drawEndX - drawStartX;
 
-                SDL_RenderSetClipRect(gRenderer, NULL);
-            }
+        if(clip.y < 0) clip.y = 0;
+        if(clip.y+clip.h >= screenHeight) clip.h = screenHeight - clip.y - 1;
 
+        draw.fogged = frame.fogOn && (!frame.debugColors);
+        draw.fog = frame.fogColor;
+        if(draw.fogged)
+        {
+            const SDL_Rect &dest = draw.dest;
+            int shadowX = std::min(std::max(dest.x + (dest.w/2),0),screenWidth-1);        
+            transformY *= (90.0/frame.hFOV);     
+            brightness = std::min(1.0,std::max(frame.worldFog,std::min(frame.playerFog,frame.playerFog/((frame.fogMultiplier* brightSin[shadowX]) * transformY * transformY))));  
+            brightness = std::max(std::min(brightness, frame.playerFog),frame.worldFog);
+            draw.fog.a = (Uint8)255.0*(1.0-std::min(1.0,std::max(frame.worldFog, brightness)));
         }
+        frame.spriteDraws.push_back(draw);
     }
+}
 
+void clipSprites(Frame_Slot &frame)
+{
+    frame.spritesDrawn = 0;
+    for(std::size_t i = 0; i < frame.spriteDraws.size(); i++)
+    {
+        Sprite_Draw &draw = frame.spriteDraws[i];
+        SDL_Rect &clip = draw.clip;
+        const int drawStartX = clip.x, drawEndX = clip.x + clip.w;
+        for(auto testX = drawStartX; testX <= drawEndX+1; testX++)
+        {
+            clip.x = testX;
+            if(testX < frame.width && draw.depth < frame.wallDist[testX])
+                break;
+        }
+        for(auto testX = drawEndX; testX >= clip.x; --testX)
+        {
+            clip.w = testX-clip.x;
+            if(draw.depth < frame.wallDist[testX])
+                break;
+        }
 
-
-
+        draw.visible = clip.x+clip.w >= 0 && clip.x < frame.width;
+        if(draw.visible)
+        {
+            frame.spritesDrawn++;
+            auxMarkSprite(frame.aux, gspriteAtlas.texels, frame.sprites[draw.sprite].image, draw.dest, draw.depth, frame.wallDist, frame.width, frame.height, draw.sprite + 1);
+        }
+    }
 }
 
+void drawSprites(Frame_Slot &frame)
+{
+    //the frame tasks already placed and clipped every sprite, this only hands them to the renderer
+#if SDL_VERSION_ATLEAST(2,0,18)
+    static std::vector<SDL_Vertex> spriteVerts; //static so the storage is reused every frame
+    static std::vector<int> spriteIndices;
+    spriteVerts.clear();
+    spriteIndices.clear();
+#endif
+
+    for(std::size_t i = 0; i < frame.spriteDraws.size(); ++i)
+    {
+        const Sprite_Draw &draw = frame.spriteDraws[i];
+        if(!draw.visible)
+            continue;
+        const Game_Sprite &sprite = frame.sprites[draw.sprite];
+#if SDL_VERSION_ATLEAST(2,0,18)
+        //clip on the cpu rather than with the renderer clip rect so nothing breaks the batch
+        addSpriteQuad(gspriteAtlas, spriteVerts, spriteIndices, draw.dest, draw.clip, sprite.image, cWhite);
+        if(draw.fogged)
+            addSpriteQuad(gspriteAtlas, spriteVerts, spriteIndices, draw.dest, draw.clip, spriteMaskRect(gspriteAtlas, sprite), draw.fog);
+#else
+        SDL_Rect mask = spriteMaskRect(gspriteAtlas, sprite);
+        SDL_RenderSetClipRect(gRenderer, &draw.clip);
+        SDL_SetTextureColorMod(gspriteAtlas.tex, 255, 255, 255);
+        SDL_SetTextureAlphaMod(gspriteAtlas.tex, 255);
+        SDL_RenderCopy(gRenderer, gspriteAtlas.tex, &sprite.image, &draw.dest);
+        if(draw.fogged)
+        {
+            SDL_SetTextureColorMod(gspriteAtlas.tex, draw.fog.r, draw.fog.g, draw.fog.b);
+            SDL_SetTextureAlphaMod(gspriteAtlas.tex, draw.fog.a);
+            SDL_RenderCopy(gRenderer, gspriteAtlas.tex, &mask, &draw.dest);
+        }
+        SDL_RenderSetClipRect(gRenderer, NULL);
+#endif
+    }
+
+#if SDL_VERSION_ATLEAST(2,0,18)
+    //every sprite and fog mask, far to near, in one draw from the atlas
+    if(!spriteIndices.empty())
+        SDL_RenderGeometry(gRenderer, gspriteAtlas.tex, &spriteVerts[0], spriteVerts.size(), &spriteIndices[0], spriteIndices.size());
+#endif
+}
+
+
 void close()
 {
+    if(gmemoryReportOn)
+    {
+        measureMemory();
+        printMemoryReport(gmemory);
+    }
     //destroy renderer
-    SDL_DestroyTexture(gskyTex);
-    //SDL_DestroyTexture(gDoorTex);
-    SDL_DestroyTexture(gwallTex[0]);
-    SDL_DestroyTexture(gwallTex[1]);
-    SDL_DestroyTexture(gfloorTex);
-    SDL_DestroyTexture(gceilTex);
-    SDL_DestroyTexture(weaponTex);
-    gskyTex = NULL;
-    //gDoorTex = NULL;
-    gwallTex[0] = NULL;
-    gwallTex[1] = NULL;
-    gfloorTex = NULL;
-    gceilTex = NULL;
+    destroyTexture(gskyTex);
+    //destroyTexture(gDoorTex);
+    if(gwallTex != NULL)
+        for(int i = 0; i < totalWallTextures; i++)
+            destroyTexture(gwallTex[i]);
+    destroyTexture(gfloorTex);
+    destroyTexture(gceilTex);
+    destroyTexture(gfloorBuffer);
+    destroyTexture(gfogTex);
+    destroyTexture(weaponTex);
+    destroyTexture(gspriteAtlas.tex);
     gcurrTex = NULL;
-    weaponTex = NULL;
     SDL_DestroyRenderer(gRenderer);
     gRenderer = NULL;
     SDL_DestroyWindow(gwindow);
@@ -1301,6 +2953,89 @@ void close()
     SDL_Quit();
 }
 
+SDL_Texture *trackTexture(SDL_Texture *tex)
+{
+    memoryAdd(gmemory, MEMORY_TEXTURES, textureBytes(tex));
+    return tex;
+}
+
+void destroyTexture(SDL_Texture *&tex)
+{
+    if(tex == NULL)
+        return;
+    memoryRemove(gmemory, MEMORY_TEXTURES, textureBytes(tex));
+    SDL_DestroyTexture(tex);
+    tex = NULL;
+}
+
+void measureMemory()
+{
+    Uint64 map = vectorBytes(leveldata);
+    if(gsimWorldLock != NULL)
+        SDL_LockMutex(gsimWorldLock);
+    map += vectorBytes(gsim.level) + flowFieldBytes(gsim.flow);
+    Uint64 sprites = vectorBytes(gsim.sprites) + vectorBytes(gsim.changedDoors) + chaserBytes(gsim.chasers);
+    if(gsimWorldLock != NULL)
+        SDL_UnlockMutex(gsimWorldLock);
+    memorySet(gmemory, MEMORY_MAP, map);
+    memorySet(gmemory, MEMORY_BLOCK_TYPES, vectorBytes(blockTypes));
+
+    Uint64 texels = texelBytes(gfloorTexels) + texelBytes(gceilTexels) + texelBytes(gspriteAtlas.texels);
+    for(int i = 0; i < totalWallTextures; i++)
+        texels += texelBytes(gwallTexels[i]);
+    memorySet(gmemory, MEMORY_TEXELS, texels);
+
+    sprites += vectorBytes(allSprites) + vectorBytes(glevelSprites);
+    memorySet(gmemory, MEMORY_SPRITES, sprites);
+
+    Uint64 tables = sizeof(brightSin) + sizeof(invBrightSin) + sizeof(floorDist) + sizeof(gpalette) + vectorBytes(gpalette.nearest);
+    memorySet(gmemory, MEMORY_TABLES, tables);
+
+    measureFrameMemory();
+    measureSnapshotMemory();
+}
+
+void measureFrameMemory()
+{
+    Uint64 frames = frameSlotBytes(gframes[0]) + frameSlotBytes(gframes[1]) + vectorBytes(gframeGraph.tasks);
+    for(std::size_t i = 0; i < gframeGraph.tasks.size(); i++)
+        frames += vectorBytes(gframeGraph.tasks[i].dependents);
+    for(std::size_t i = 0; i < gworldBatch.worlds.size(); i++)
+        frames += frameSlotBytes(gworldBatch.worlds[i].frame);
+    frames += vectorBytes(gworldBatch.observations) + vectorBytes(gworldBatch.columnDepth) + vectorBytes(gworldBatch.depth);
+    frames += vectorBytes(gworldBatch.surface) + vectorBytes(gworldBatch.spriteIds);
+    frames += captureRingBytes(gcapture);
+    memorySet(gmemory, MEMORY_FRAMES, frames);
+}
+
+void measureSnapshotMemory()
+{
+    //worlds on one map share its geometry, count each one once
+    std::vector<const Level_Geometry *> geometries;
+    Uint64 snapshots = vectorBytes(gworldSnapshot.doors) + vectorBytes(gworldSnapshot.sprites);
+    geometries.push_back(glevelGeometry.get());
+    geometries.push_back(gworldSnapshot.geometry.get());
+    for(std::size_t i = 0; i < gworldBatch.worlds.size(); i++)
+    {
+        const World_Context &context = gworldBatch.worlds[i];
+        snapshots += vectorBytes(context.start.doors) + vectorBytes(context.start.sprites);
+        snapshots += vectorBytes(context.world.level) + vectorBytes(context.world.sprites);
+        snapshots += flowFieldBytes(context.world.flow) + chaserBytes(context.world.chasers);
+        geometries.push_back(context.start.geometry.get());
+    }
+    std::sort(geometries.begin(), geometries.end());
+    geometries.erase(std::unique(geometries.begin(), geometries.end()), geometries.end());
+    for(std::size_t i = 0; i < geometries.size(); i++)
+        if(geometries[i] != NULL)
+            snapshots += sizeof(Level_Geometry) + vectorBytes(geometries[i]->blocks) + vectorBytes(geometries[i]->doorCells);
+    if(gsimSnapLock != NULL)
+        SDL_LockMutex(gsimSnapLock);
+    snapshots += vectorBytes(gsimPrev.sprites) + vectorBytes(gsimCurr.sprites) + vectorBytes(gsimPendingDoors);
+    if(gsimSnapLock != NULL)
+        SDL_UnlockMutex(gsimSnapLock);
+    memorySet(gmemory, MEMORY_SNAPSHOTS, snapshots);
+}
+
 void renderTexture(SDL_Texture *tex, SDL_Renderer *ren, SDL_Rect dst, SDL_Rect *clip = nullptr)
 {
     // draw the clipped texture to the destination rectangle
@@ -1351,264 +3086,1211 @@ std::string getProjectPath(const std::string &subDir = "")
     return subDir.empty() ? baseRes : baseRes + subDir + PATH_SEP;
 }
 
-SDL_Texture *loadImage(std::string path)
+std::vector<std::string> listMapFiles()
+{
+    //shorter names first so numbered maps come out in number order
+    std::vector<std::string> names;
+    const std::string dir = getProjectPath("resources") + "maps";
+#ifdef _WIN32
+    WIN32_FIND_DATAA found;
+    HANDLE search = FindFirstFileA((dir + PATH_SYM + "*.txt").c_str(), &found);
+    if(search != INVALID_HANDLE_VALUE)
+    {
+        do
+            names.push_back(found.cFileName);
+        while(FindNextFileA(search, &found));
+        FindClose(search);
+    }
+#else
+    if(DIR *listing = opendir(dir.c_str()))
+    {
+        while(dirent *entry = readdir(listing))
+            names.push_back(entry->d_name);
+        closedir(listing);
+    }
+#endif
+    std::vector<std::pair<size_t, std::string>> sortMaps;
+    for(const std::string &name : names)
+        if(name.size() > 4 && name.compare(name.size() - 4, 4, ".txt") == 0)
+            sortMaps.push_back(std::make_pair(name.size(), name.substr(0, name.size() - 4)));
+    std::sort(sortMaps.begin(), sortMaps.end());
+    std::vector<std::string> maps;
+    for(const std::pair<size_t, std::string> &map : sortMaps)
+        maps.push_back(map.second);
+    return maps;
+}
+
+SDL_Texture *loadImage(std::string path, Texel_Image *texels, int layout)
+{
+    static std::string projectPath = getProjectPath();
+
+    Asset_Image image;
+    image.path = projectPath + path;
+    image.texels = texels;
+    image.layout = layout;
+    if (!decodeAssetImage(image))
+        return NULL;
+    return trackTexture(createAssetTexture(gRenderer, image));
+}
+
+SDL_Texture *loadImageColorKey(std::string path, SDL_Color transparent, Texel_Image *texels)
+{
+    static std::string projectPath = getProjectPath();
+
+    Asset_Image image;
+    image.path = projectPath + path;
+    image.colorKey = true;
+    image.key = transparent;
+    image.texels = texels;
+    if (!decodeAssetImage(image))
+        return NULL;
+    return trackTexture(createAssetTexture(gRenderer, image));
+}
+
+bool loadImageTexels(std::string path, SDL_Color transparent, Texel_Image &texels)
+{
+    static std::string projectPath = getProjectPath();
+
+    Asset_Image image;
+    image.path = projectPath + path;
+    image.texture = false;
+    image.colorKey = true;
+    image.key = transparent;
+    image.texels = &texels;
+    return decodeAssetImage(image);
+}
+
+void prepareFog(const Frame_Slot &frame, Fog_Tables &fog)
+{
+    //the frame format is RGBA32, so alpha is one byte of the pixel and each fog color is the clear one with it set
+    fog.clear = SDL_MapRGBA(gpixelFormat, frame.fogColor.r, frame.fogColor.g, frame.fogColor.b, 0);
+    fog.alphaShift = gpixelFormat->Ashift;
+
+    //the per column part of every pixel's fog term
+    fog.columnFog.resize(frame.width);
+    for(int x = 0; x < frame.width; x++)
+        fog.columnFog[x] = frame.fogMultiplier * brightSin[x];
+
+    //walls get one fog value per column. 8 bit frames only get here without a ceiling, see fogPassNeeded. their
+    //fog buffer covers just the sky, so their walls stay clear
+    const double fovScale = (90.0/frame.hFOV) * (90.0/frame.hFOV);
+    const double worldFog = frame.worldFog, playerFog = frame.playerFog;
+    fog.wallFog.resize(frame.width);
+    for(int x = 0; x < frame.width; x++)
+    {
+        double tempdist = frame.wallDist[x] * frame.wallDist[x] * fovScale;
+        double brightness = std::min(1.0,std::max(worldFog,std::min(playerFog,playerFog/(fog.columnFog[x] * tempdist))));
+        fog.wallFog[x] = frame.paletted ? fog.clear : fog.clear | ((Uint32)(Uint8)(255.0*(1.0-brightness)) << fog.alphaShift);
+    }
+}
+
+ISA_KERNEL void generatefogMaskKernel(Frame_Slot &frame, const Frame_Slot &prev, const Fog_Tables &fog, int rowStart, int rowEnd)
+{
+    //every pixel of the band first gets fogged as if it were floor, in straight loops the wider copies vectorize.
+    //then each column's wall span is written over it, and only then are the rows checked against the last frame
+    const int width = frame.width;
+    const double fovScale = (90.0/frame.hFOV) * (90.0/frame.hFOV);
+    const double worldFog = frame.worldFog, playerFog = frame.playerFog;
+    const double clearest = 1.0 - playerFog, thickest = 1.0 - worldFog; //fade at the player and at the world's limit
+    const double *columnFog = &fog.columnFog[0];
+    const Uint32 clear = fog.clear;
+    const int alphaShift = fog.alphaShift;
+    const bool skyOnly = frame.paletted;
+    const int horizon = std::min(frame.height, std::max(0, (int)((frame.height / 2) + frame.cam.vertLook)));
+
+    Uint32* pixels = &frame.fogPixels[0];
+    for(int y = rowStart; y < rowEnd; y++)
+    {
+        Uint32 *row = pixels + y * width;
+        if(skyOnly && y >= horizon)
+        {
+            std::fill(row, row + width, clear);
+            continue;
+        }
+        //1 - brightness, clamped after the subtraction instead of before. rounding keeps 1 - x in order, so the
+        //alpha is exactly what clamping brightness gives, and the clamps are plain selects the copies vectorize.
+        //both fogs stay within 0 to 1, so brightness never needed its clamp to 1
+        const double dist = frame.floorDist[y] * frame.floorDist[y] * fovScale;
+        for(int x = 0; x < width; x++)
+        {
+            double fade = 1.0 - playerFog / (columnFog[x] * dist);
+            fade = fade > clearest ? fade : clearest;
+            fade = fade < thickest ? fade : thickest;
+            row[x] = clear | ((Uint32)(int)(255.0 * fade) << alphaShift);
+        }
+    }
+    for(int x = 0; x < width; x++)
+    {
+        const int end = std::min(rowEnd, frame.drawEnd[x]);
+        for(int y = std::max(rowStart, frame.drawStart[x]); y < end; y++)
+            pixels[y * width + x] = fog.wallFog[x];
+    }
+    for(int y = rowStart; y < rowEnd; y++)
+        markRow(frame.fogPixels, frame.fogRowWritten, frame.fogRowDirty, prev.fogPixels, prev.fogRowWritten, y, width, frame.fullUpload);
+}
+
+ISA_VARIANTS(generatefogMask, (Frame_Slot &frame, const Frame_Slot &prev, const Fog_Tables &fog, int rowStart, int rowEnd), (frame, prev, fog, rowStart, rowEnd))
+
+void generatefogMask(Frame_Slot &frame, const Frame_Slot &prev, const Fog_Tables &fog, int rowStart, int rowEnd)
+{
+    generatefogMaskIsa(frame, prev, fog, rowStart, rowEnd);
+}
+
+bool fogPassNeeded(const Frame_Slot &frame)
+{
+    //the colormaps already fogged everything the 8 bit path drew, but without a ceiling the sky is the skybox texture
+    return frame.fogOn && (!frame.paletted || !frame.ceilingOn);
+}
+
+void selectCpuKernels(int level)
+{
+    generatefogMaskIsa = ISA_PICK(generatefogMask, level);
+}
+
+void drawHud(const Frame_Slot &frame)
+{
+    drawWeap();
+    if(mapOn)
+        drawMiniMap(frame);
+    return;
+}
+void drawWeap()
+{
+    renderTexture(weaponTex, gRenderer, weaponDestRect, &weaponTexRect);
+    return;
+}
+
+void drawMiniMap(const Frame_Slot &frame)
+{
+
+    SDL_SetRenderDrawColor(gRenderer, cBlack.r, cBlack.g, cBlack.b, cBlack.a);
+    SDL_RenderFillRect(gRenderer, &miniMapRect);
+    for(int y = 0; y < mapHeight; y++)
+    {
+        for(int x = 0; x < mapWidth; x++)
+        {
+            if(leveldata[x][y].visible)
+            {
+                switch(leveldata[x][y].block_id)
+                {
+                    case(1):
+                        SDL_SetRenderDrawColor(gRenderer, cBlue.r, cBlue.g, cBlue.b, cBlue.a);
+                        break;
+                    case(2):
+                        SDL_SetRenderDrawColor(gRenderer, cGreen.r, cGreen.g, cGreen.b, cGreen.a);
+                        break;
+                    case(3):
+                        SDL_SetRenderDrawColor(gRenderer, cRed.r, cRed.g, cRed.b, cRed.a);
+                        break;
+                    default:
+                        SDL_SetRenderDrawColor(gRenderer, cBlack.r, cBlack.g, cBlack.b, cBlack.a);
+                        break;
+                }
+                miniMapDot.x = miniMapRect.x + 2*x;
+                miniMapDot.y = miniMapRect.y + 2*y;
+                SDL_RenderDrawRect(gRenderer, &miniMapDot);
+            }
+        }
+    }
+    SDL_SetRenderDrawColor(gRenderer, cYellow.r, cYellow.g, cYellow.b, cYellow.a);
+    miniMapDot.x = miniMapRect.x + 2*(int)frame.cam.posX;
+    miniMapDot.y = miniMapRect.y + 2*(int)frame.cam.posY;
+    SDL_RenderDrawRect(gRenderer, &miniMapDot);
+    SDL_SetRenderDrawColor(gRenderer, cCyan.r, cCyan.g, cCyan.b, cCyan.a);
+    SDL_RenderDrawLine(gRenderer, miniMapRect.x + 2*(int)frame.cam.posX, miniMapRect.y + 2*(int)frame.cam.posY, miniMapRect.x + 2*(int)(frame.blockLeftX), miniMapRect.y + 2*(int)(frame.blockLeftY));
+    SDL_RenderDrawLine(gRenderer, miniMapRect.x + 2*(int)frame.cam.posX, miniMapRect.y + 2*(int)frame.cam.posY, miniMapRect.x + 2*(int)(frame.blockRightX), miniMapRect.y + 2*(int)(frame.blockRightY));
+    SDL_RenderDrawLine(gRenderer, miniMapRect.x + 2*(int)frame.cam.posX, miniMapRect.y + 2*(int)frame.cam.posY, miniMapRect.x + 2*(int)(frame.blockAheadX), miniMapRect.y + 2*(int)(frame.blockAheadY));
+    return;
+}
+
+void newlevel(bool warpView)
+{
+        enableInput = false; //shouldn't matter but just in case, disable player input during new level load
+        if(warpView)
+        {
+            for(int i = 0; i < 50; i++)
+            {
+                viewTrip -= 0.2; //make floor and ceiling appear to stretch / fall away. acid trip effect. just for fun
+
+                updateScreen();
+                SDL_Delay(20);
+            }
+        }
+
+        if(glevelPreloaded)
+            glevelPreloaded = false; //init loaded the first one alongside the textures
+        else
+            loadNextLevel();
+        ceilingOn = rand()%2;
+
+        //reset all the camera stuff
+        //dirX = std::tan((hFOV*degToRad)/2);
+        //dirX = std::sqrt(dirX*dirX+dirY*dirY); //preserve hfov. not sure why the other way isn't working
+        double oldFOV = hFOV;
+        changeFOV(false, 90);
+        dirX = 1;
+        dirY = 0;
+        changeFOV(false, oldFOV);        
+        planeX = 0;
+        planeY = 1;
+        vertLook = 0;
+        vertHeight = 0.1;
+        viewTrip = 0;
+        initAllSprites();
+        updateVerticalView();
+
+        miniMapRect = { gscreenWidth - (mapWidth*2) - gscreenWidth/16,
+                        gscreenHeight / 16,
+                        mapWidth*2,
+                        mapHeight*2 };
+
+        simResetFromView(); //sim picks up the new map, camera and sprites from here
+        measureMemory(); //so the map's peak is seen even for levels nobody prints a report on
+
+
+        enableInput = true;
+}
+
+void loadNextLevel()
+{
+    //runs on a worker during init, so it touches nothing but the level, camera start and map name
+    srand(time(0));
+    if(glevelGenOn)
+    {
+        //generated levels: each exit moves on to the next seed so a run is repeatable from its first seed
+        Level_Gen_Params params = glevelGen;
+        params.seed += glevelsGenerated++;
+        Generated_Level level;
+        Uint64 start = SDL_GetPerformanceCounter();
+        generateLevel(params, level);
+        double ms = (SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency();
+        printf("Map: generated %dx%d, seed %llu, %.1fms\n", level.width, level.height, (unsigned long long)params.seed, ms);
+        loadGeneratedLevel(level);
+        gmapName = "generated seed " + std::to_string((unsigned long long)params.seed);
+    }
+    else
+    {
+        //randomly load a new level from maps directory, named map0.txt to map19.txt
+        std::stringstream levelFileName;
+        std::string thisMap;
+        thisMap += "map";
+        thisMap += std::to_string(rand() % 20);
+        levelFileName << getProjectPath("resources") << PATH_SYM << "maps" << PATH_SYM << thisMap << ".txt";
+        printf("Map: %s\n", thisMap.c_str());
+        loadLevel(levelFileName.str());
+        gmapName = thisMap;
+    }
+    glevelsLoaded++;
+}
+
+void loadLevel(std::string path)
+{
+    
+
+    std::ifstream mapFile(path);
+    int a;
+    mapFile >> a;
+    posX = a + 0.5;
+    mapFile >> a;
+    posY = a + 0.5;
+    mapFile >> a;
+    mapWidth = a;
+    mapFile >> a;
+    mapHeight = a;
+    glevelGeometry.reset();
+
+    leveldata.resize(mapWidth);
+    for (int i = 0; i < mapWidth; i++)
+    {
+        leveldata[i].resize(mapHeight);
+    }
+
+    for (int y = 0; y < mapHeight; y++)
+    {
+        for (int x = 0; x < mapWidth; x++)
+        {
+            mapFile >> a;
+            changeBlock(&leveldata.at(x).at(y), a);
+        }
+    }
+
+    //optional sprite section after the blocks: "sprites <count>" then one "texID x y" per line
+    glevelSprites.clear();
+    std::string section;
+    int count = 0;
+    if(mapFile >> section && section == "sprites" && mapFile >> count)
+    {
+        for(int i = 0; i < count; i++)
+        {
+            Sprite_Spawn spawn;
+            if(!(mapFile >> spawn.texID >> spawn.x >> spawn.y))
+                break;
+            glevelSprites.push_back(spawn);
+        }
+    }
+
+    mapFile.close();
+}
+
+void loadGeneratedLevel(const Generated_Level &level)
+{
+    posX = level.startX + 0.5;
+    posY = level.startY + 0.5;
+    mapWidth = level.width;
+    mapHeight = level.height;
+    glevelGeometry.reset();
+
+    levelFromGenerated(level, leveldata);
+    glevelSprites = level.sprites;
+}
+
+void levelFromGenerated(const Generated_Level &level, std::vector<std::vector<Map_Block>> &blocks)
+{
+    blocks.resize(level.width);
+    for (int x = 0; x < level.width; x++)
+    {
+        blocks[x].resize(level.height);
+        for (int y = 0; y < level.height; y++)
+            changeBlock(&blocks[x][y], level.cells[x + y * level.width]);
+    }
+}
+
+void captureWorld(World_Snapshot &snapshot)
+{
+    //read from the sim rather than the render side, which lags behind it and interpolates
+    SDL_LockMutex(gsimWorldLock);
+    if(!glevelGeometry)
+        glevelGeometry = buildLevelGeometry(gsim.level, gsim.width, gsim.height);
+    snapshot.geometry = glevelGeometry;
+    saveDoors(*glevelGeometry, gsim.level, snapshot.doors);
+    snapshot.cam = gsim.cam;
+    snapshot.sprites = gsim.sprites;
+    SDL_UnlockMutex(gsimWorldLock);
+    snapshot.hFOV = hFOV;
+    snapshot.fogOn = fogOn;
+    snapshot.worldFog = worldFog;
+    snapshot.playerFog = playerFog;
+    snapshot.fogMultiplier = fogMultiplier;
+    snapshot.fogColor = fogColor;
+    snapshot.ceilingOn = ceilingOn;
+}
+
+void restoreWorld(const World_Snapshot &snapshot)
+{
+    //frame thread must be idle, it reads leveldata
+    bool sameLevel = (snapshot.geometry == glevelGeometry);
+    if(!sameLevel)
+    {
+        leveldata = snapshot.geometry->blocks;
+        mapWidth = snapshot.geometry->width;
+        mapHeight = snapshot.geometry->height;
+        glevelGeometry = snapshot.geometry;
+        miniMapRect = { gscreenWidth - (mapWidth*2) - gscreenWidth/16,
+                        gscreenHeight / 16,
+                        mapWidth*2,
+                        mapHeight*2 };
+    }
+    restoreDoors(*snapshot.geometry, snapshot.doors, leveldata);
+
+    posX = snapshot.cam.posX;
+    posY = snapshot.cam.posY;
+    dirX = snapshot.cam.dirX;
+    dirY = snapshot.cam.dirY;
+    planeX = snapshot.cam.planeX;
+    planeY = snapshot.cam.planeY;
+    vertLook = snapshot.cam.vertLook;
+    vertHeight = snapshot.cam.vertHeight;
+    hFOV = snapshot.hFOV;
+    allSprites = snapshot.sprites;
+    fogOn = snapshot.fogOn;
+    worldFog = snapshot.worldFog;
+    playerFog = snapshot.playerFog;
+    fogMultiplier = snapshot.fogMultiplier;
+    fogColor = snapshot.fogColor;
+    ceilingOn = snapshot.ceilingOn;
+    updateVerticalView();
+    simResetFromView(!sameLevel);
+}
+
+void initWorldBatch(World_Batch &batch, int count, int obsWidth, int obsHeight, int threads)
+{
+    batch.obsWidth = obsWidth;
+    batch.obsHeight = obsHeight;
+    batch.worlds.resize(count); //never resized again, frames point into their world's level
+    batch.actions.assign(count, Sim_Input());
+    batch.observations.assign((std::size_t)count * obsWidth * obsHeight, 0);
+    std::shared_ptr<const Level_Geometry> loaded; //worlds on the loaded map all share its geometry
+    for(int i = 0; i < count; i++)
+    {
+        World_Context &context = batch.worlds[i];
+        Sim_World &world = context.world;
+        if(glevelGenOn)
+        {
+            //a different generated map for every world
+            Level_Gen_Params params = glevelGen;
+            params.seed += i;
+            Generated_Level level;
+            generateLevel(params, level);
+            levelFromGenerated(level, world.level);
+            world.width = level.width;
+            world.height = level.height;
+            world.cam = Camera_State();
+            world.cam.posX = level.startX + 0.5;
+            world.cam.posY = level.startY + 0.5;
+            world.cam.dirX = 1.0 / std::tan((hFOV * degToRad) / 2);
+            world.cam.vertHeight = 0.1;
+            world.sprites.clear();
+            for(std::size_t s = 0; s < level.sprites.size(); s++)
+                world.sprites.push_back(makeSprite(level.sprites[s].texID, level.sprites[s].x, level.sprites[s].y));
+            spawnChasers(world.sprites, world.level, world.width, world.height, gchaserCount, world.cam.posX, world.cam.posY);
+            context.start.geometry = buildLevelGeometry(world.level, world.width, world.height);
+        }
+        else
+        {
+            //everyone starts on the level that's loaded now
+            if(!loaded)
+                loaded = glevelGeometry ? glevelGeometry : buildLevelGeometry(leveldata, mapWidth, mapHeight);
+            world.level = leveldata;
+            world.width = mapWidth;
+            world.height = mapHeight;
+            world.cam.posX = posX;
+            world.cam.posY = posY;
+            world.cam.dirX = dirX;
+            world.cam.dirY = dirY;
+            world.cam.planeX = planeX;
+            world.cam.planeY = planeY;
+            world.cam.vertLook = vertLook;
+            world.cam.vertHeight = vertHeight;
+            world.sprites = allSprites;
+            context.start.geometry = loaded;
+        }
+        context.hFOV = hFOV;
+        saveDoors(*context.start.geometry, world.level, context.start.doors);
+        context.start.cam = world.cam;
+        context.start.sprites = world.sprites;
+        context.start.hFOV = context.hFOV;
+        attachChasers(world.chasers, world.sprites);
+        initFrameSlot(context.frame, obsWidth, obsHeight);
+        initAuxBuffers(context.frame.aux, batch.auxChannels, batch.auxScale, obsWidth, obsHeight);
+        context.frame.level = &world.level;
+    }
+    const Aux_Buffers &aux = batch.worlds[0].frame.aux;
+    batch.auxWidth = aux.width;
+    batch.auxHeight = aux.height;
+    batch.columnDepth.assign(aux.columnDepth.size() * count, 0.0f);
+    batch.depth.assign(aux.depth.size() * count, 0.0f);
+    batch.surface.assign(aux.surface.size() * count, 0);
+    batch.spriteIds.assign(aux.sprite.size() * count, 0);
+    startWorkerPool(batch.pool, threads > 0 ? threads : SDL_GetCPUCount());
+}
+
+void stepWorldBatch(World_Batch &batch)
+{
+    runWorkerPool(batch.pool, stepWorldJob, &batch, batch.worlds.size());
+}
+
+void stepWorldJob(void *data, int index)
+{
+    World_Batch &batch = *(World_Batch *)data;
+    World_Context &context = batch.worlds[index];
+    Sim_Input input = batch.actions[index];
+    input.hFOV = context.hFOV;
+    context.done = false;
+    for(int tick = 0; tick < batch.ticksPerStep; tick++)
+    {
+        simStep(context.world, input, 1.0 / simTickRate);
+        context.world.changedDoors.clear(); //no render side copy of the map to tell
+        //mouse motion and use presses are events, not held keys. only the first tick gets them
+        input.mouseX = 0;
+        input.mouseY = 0;
+        input.useCount = 0;
+        if(context.world.exitRequested)
+        {
+            context.done = true;
+            break;
+        }
+    }
+    context.steps++;
+    if(context.done)
+        resetWorldContext(context);
+    renderObservation(context, &batch.observations[(std::size_t)index * batch.obsWidth * batch.obsHeight]);
+
+    const Aux_Buffers &aux = context.frame.aux;
+    std::copy(aux.columnDepth.begin(), aux.columnDepth.end(), batch.columnDepth.begin() + index * aux.columnDepth.size());
+    std::copy(aux.depth.begin(), aux.depth.end(), batch.depth.begin() + index * aux.depth.size());
+    std::copy(aux.surface.begin(), aux.surface.end(), batch.surface.begin() + index * aux.surface.size());
+    std::copy(aux.sprite.begin(), aux.sprite.end(), batch.spriteIds.begin() + index * aux.sprite.size());
+}
+
+void stopWorldBatch(World_Batch &batch)
+{
+    stopWorkerPool(batch.pool);
+}
+
+void renderObservation(World_Context &context, Uint32 *pixels)
+{
+    Frame_Slot &frame = context.frame;
+    frame.cam = context.world.cam;
+    frame.cam.vertLook *= (double)frame.height / gscreenHeight; //sim looks up and down in screen pixels
+    frame.hFOV = context.hFOV;
+    frame.ceilingOn = context.ceilingOn;
+    frame.mipmapsOn = true;
+    frame.maxRayDist = maxRayDist; //no fog in observations, only the fixed limit
+    frame.raycastMode = graycastMode;
+    frame.fogPixel = SDL_MapRGBA(gpixelFormat, fogColor.r, fogColor.g, fogColor.b, 0xff);
+    frame.sprites = context.world.sprites;
+    std::fill(frame.aux.sprite.begin(), frame.aux.sprite.end(), 0);
+    calcFloorDist(&frame.floorDist[0], frame.height, frame.cam.vertLook, frame.cam.vertHeight);
+    calcRaycast(frame);
+    calcWallColumns(frame, 0, frame.width);
+    prepareFloor(frame, frame);
+    drawFloor(frame, frame, 0, frame.height);
+    drawWalls(frame, 0, frame.height);
+    std::copy(frame.floorPixels.begin(), frame.floorPixels.end(), pixels);
+    drawSpritesToBuffer(frame, pixels);
+}
+
+void drawSpritesToBuffer(Frame_Slot &frame, Uint32 *pixels)
+{
+    //same projection as drawSprites, but sampled from the atlas texels. nothing shared is written so worlds can run in parallel
+    const Camera_State &cam = frame.cam;
+    const Texel_Image &atlas = gspriteAtlas.texels;
+    const int width = frame.width;
+    const int height = frame.height;
+    std::vector<std::pair<double, int>> order(frame.sprites.size());
+    for(std::size_t i = 0; i < order.size(); i++)
+    {
+        double dx = cam.posX - frame.sprites[i].worldX, dy = cam.posY - frame.sprites[i].worldY;
+        order[i] = std::make_pair(dx * dx + dy * dy, (int)i);
+    }
+    std::sort(order.rbegin(), order.rend()); //farthest first
+
+    double invDet = 1.0 / (cam.planeX * cam.dirY - cam.dirX * cam.planeY);
+    for(std::size_t i = 0; i < order.size(); i++)
+    {
+        const Game_Sprite &sprite = frame.sprites[order[i].second];
+        double spriteX = sprite.worldX - cam.posX;
+        double spriteY = sprite.worldY - cam.posY;
+        double transformY = invDet * (-cam.planeY * spriteX + cam.planeX * spriteY);
+        if(transformY <= 0)
+            continue;
+        double transformX = invDet * (cam.dirY * spriteX - cam.dirX * spriteY);
+        int spriteScreenX = int((width / 2) * (1 + transformX / transformY));
+        int fullHeight = abs(int(height / transformY));
+        int drawEndY = fullHeight / 2 + height / 2 + (cam.vertHeight * fullHeight) + cam.vertLook;
+        int spriteHeight = fullHeight * sprite.height;
+        int spriteWidth = fullHeight * sprite.width;
+        if(spriteHeight <= 0 || spriteWidth <= 0)
+            continue;
+        int drawStartY = drawEndY - spriteHeight;
+        int drawStartX = spriteScreenX - spriteWidth / 2;
+        SDL_Rect dest = {drawStartX, drawStartY, spriteWidth, spriteHeight};
+        auxMarkSprite(frame.aux, atlas, sprite.image, dest, transformY, frame.wallDist, width, height, order[i].second + 1);
+
+        for(int x = std::max(0, drawStartX); x < std::min(width, drawStartX + spriteWidth); x++)
+        {
+            if(transformY >= frame.wallDist[x])
+                continue; //behind the wall in this column
+            int texX = sprite.image.x + (x - drawStartX) * sprite.image.w / spriteWidth;
+            for(int y = std::max(0, drawStartY); y < std::min(height, drawEndY); y++)
+            {
+                int texY = sprite.image.y + (y - drawStartY) * sprite.image.h / spriteHeight;
+                Uint32 texel = texelAt(atlas, texX, texY);
+                if(texel & texelAlphaMask)
+                    pixels[y * width + x] = texel;
+            }
+        }
+    }
+}
+
+void runWorldBatchBenchmark()
 {
-    static std::string projectPath = getProjectPath();
-
-    SDL_Surface *bmp = SDL_LoadBMP((projectPath + path).c_str());
-    SDL_Texture *tex = NULL;
-    if (bmp == nullptr)
+    gworldBatch.auxChannels = gauxChannels;
+    gworldBatch.auxScale = gauxScale;
+    initWorldBatch(gworldBatch, gbatchWorldCount, gbatchObsWidth, gbatchObsHeight, gbatchThreads);
+    measureMemory(); //observation and aux buffers are at their full size from here on
+    printf("Worlds: %d worlds, %dx%d observations, %u threads\n", gbatchWorldCount, gbatchObsWidth, gbatchObsHeight, (unsigned)gworldBatch.pool.threads.size() + 1);
+    int exits = 0;
+    Uint64 start = SDL_GetPerformanceCounter();
+    for(int step = 0; step < gbatchSteps; step++)
     {
-        printf("SDL_LoadBMP Error: %s\n", SDL_GetError());
-    }
-    else
-    {
-        bmp = SDL_ConvertSurfaceFormat(bmp, SDL_PIXELFORMAT_RGBA32, 0);
-        tex = SDL_CreateTexture(gRenderer, SDL_PIXELFORMAT_RGBA32, SDL_TEXTUREACCESS_STREAMING, bmp->w, bmp->h);
-
-        //Lock texture for manipulation
-        void *mPixels;
-        int mPitch;
-        SDL_LockTexture(tex, NULL, &mPixels, &mPitch);
-        //Copy loaded/formatted surface pixels
-        memcpy(mPixels, bmp->pixels, mPitch * bmp->h);
-        //Unlock texture to update
-        SDL_UnlockTexture(tex);
-        mPixels = NULL;
-
-        SDL_FreeSurface(bmp);
-        if (tex == nullptr)
+        //wander: mostly forward, some turning, the odd use press to open doors and take exits
+        for(std::size_t i = 0; i < gworldBatch.actions.size(); i++)
         {
-            printf("SDL_CreateTextureFromSurface Error: %s\n", SDL_GetError());
+            Sim_Input &action = gworldBatch.actions[i];
+            action.forward = rand() % 4 != 0;
+            action.turnLeft = rand() % 4 == 0;
+            action.turnRight = rand() % 4 == 1;
+            action.useCount = (rand() % 8 == 0) ? 1 : 0;
         }
+        stepWorldBatch(gworldBatch);
+        for(std::size_t i = 0; i < gworldBatch.worlds.size(); i++)
+            exits += gworldBatch.worlds[i].done;
     }
-
-    return tex;
+    double seconds = (SDL_GetPerformanceCounter() - start) / (double)SDL_GetPerformanceFrequency();
+    printf("Worlds: %d steps in %.2fs, %.0f environment frames per second, %d exits\n",
+           gbatchSteps, seconds, gbatchSteps * (double)gbatchWorldCount / std::max(seconds, 1e-9), exits);
+    stopWorldBatch(gworldBatch);
 }
 
-SDL_Texture *loadImageColorKey(std::string path, SDL_Color transparent)
+void runRayQueryBenchmark()
 {
-
-    static std::string projectPath = getProjectPath();
-
-    SDL_Surface *bmp = SDL_LoadBMP((projectPath + path).c_str());
-    SDL_Texture *tex = NULL;
-    if (bmp == nullptr)
+    //random rays from open cells toward other open cells, like a crowd checking if it can see the player
+    std::vector<int> open;
+    for(int y = 0; y < mapHeight; y++)
+        for(int x = 0; x < mapWidth; x++)
+            if(!leveldata[x][y].solid)
+                open.push_back(x + y * mapWidth);
+    if(open.empty())
+        return;
+    Ray_Query_Batch batch;
+    batch.level = &leveldata;
+    batch.sprites = &allSprites;
+    batch.queries.resize(grayBenchCount);
+    for(int i = 0; i < grayBenchCount; i++)
     {
-        printf("SDL_LoadBMP Error: %s\n", SDL_GetError());
+        Ray_Query &query = batch.queries[i];
+        int from = open[rand() % open.size()], to = open[rand() % open.size()];
+        query.originX = from % mapWidth + (rand() % 1000) / 1000.0;
+        query.originY = from / mapWidth + (rand() % 1000) / 1000.0;
+        query.dirX = to % mapWidth + 0.5 - query.originX;
+        query.dirY = to / mapWidth + 0.5 - query.originY;
+        query.maxDist = std::sqrt(query.dirX * query.dirX + query.dirY * query.dirY);
     }
-    else
+    Worker_Pool pool;
+    startWorkerPool(pool, gbatchThreads > 0 ? gbatchThreads : SDL_GetCPUCount());
+    const int rounds = 50;
+    double seconds[2] = {0, 0};
+    std::vector<Ray_Query_Hit> serialHits;
+    for(int parallel = 0; parallel < 2; parallel++)
     {
-        bmp = SDL_ConvertSurfaceFormat(bmp, SDL_PIXELFORMAT_RGBA32, 0);
-        SDL_SetColorKey(bmp, SDL_TRUE, SDL_MapRGB(bmp->format, transparent.r, transparent.g, transparent.b));
-        tex = SDL_CreateTextureFromSurface(gRenderer,bmp);
-
-        SDL_FreeSurface(bmp);
-        if (tex == nullptr)
-        {
-            printf("SDL_CreateTextureFromSurface Error: %s\n", SDL_GetError());
-        }
+        Uint64 start = SDL_GetPerformanceCounter();
+        for(int round = 0; round < rounds; round++)
+            castRayBatch(batch, parallel ? &pool : NULL);
+        seconds[parallel] = (SDL_GetPerformanceCounter() - start) / (double)SDL_GetPerformanceFrequency();
+        if(!parallel)
+            serialHits = batch.hits;
     }
-
-    return tex;
+    int clear = 0, walls = 0, sprites = 0, mismatched = 0;
+    for(int i = 0; i < grayBenchCount; i++)
+    {
+        const Ray_Query_Hit &hit = batch.hits[i];
+        if(hit.sprite >= 0)
+            sprites++;
+        else if(hit.wall.found)
+            walls++;
+        else
+            clear++;
+        mismatched += hit.sprite != serialHits[i].sprite || hit.wall.found != serialHits[i].wall.found || hit.wall.dist != serialHits[i].wall.dist;
+    }
+    printf("Rays: %d per batch, %d clear, %d blocked by walls or doors, %d by sprites\n", grayBenchCount, clear, walls, sprites);
+    printf("Rays: %.1fM rays/s on 1 thread, %.1fM rays/s on %u threads, %d results differ\n",
+           rounds * (double)grayBenchCount / std::max(seconds[0], 1e-9) / 1e6, rounds * (double)grayBenchCount / std::max(seconds[1], 1e-9) / 1e6,
+           (unsigned)pool.threads.size() + 1, mismatched);
+    stopWorkerPool(pool);
 }
 
-void generatefogMask(SDL_Texture* tex, int* drawStart, int* drawEnd, double* wallDist)
+template<typename Real>
+void precisionColumns(const Camera_State &cam, int width, int height, std::vector<Ray_Hit> &hits, std::vector<int> &texX, std::vector<int> &spans)
 {
-    int texWidth;
-    int texHeight;
-    void* texPix = NULL;
-    int pitch;//, lineHeight;
-    double brightness = 0;
-    Uint32 format;
-    SDL_QueryTexture(tex, &format, NULL, &texWidth, &texHeight);
-    SDL_LockTexture(tex, NULL, &texPix, &pitch);
-    Uint32* pixels = (Uint32*)texPix;
-    SDL_PixelFormat *mappingFormat = SDL_AllocFormat(format);
-    for(int x = 0; x < texWidth; x++)
+    No_Cell_Visitor visit;
+    for(int x = 0; x < width; x++)
     {
-        int start = std::max(drawStart[x],0);
-        int end = std::min(drawEnd[x], texHeight);
+        double cameraX = 2 * x / double(width) - 1;
+        double rayDirX = cam.dirX + cam.planeX * cameraX;
+        double rayDirY = cam.dirY + cam.planeY * cameraX;
+        Ray_Hit &hit = hits[x];
+        hit = Ray_Hit();
+        castRayAs<Real>(leveldata, cam.posX, cam.posY, rayDirX, rayDirY, hit, maxRayDist, visit);
+        texX[x] = spans[x] = -1;
+        if(!hit.found)
+            continue;
+        //the same sums calcWallColumns does, flipping and all
+        const Map_Block &block = leveldata[hit.mapX][hit.mapY];
+        int wallTex = block.wallTex[hit.face] < totalWallTextures ? block.wallTex[hit.face] : 0;
+        int texWidth = gwallTexels[wallTex].levels[0].w;
+        texX[x] = wallTexColumn<Real>(cam.posX, cam.posY, hit.dist, rayDirX, rayDirY, hit.side, 1.0 - block.timer, texWidth);
+        if ((hit.side == 0 && rayDirX < 0) || (hit.side == 1 && rayDirY > 0))
+            texX[x] = texWidth - texX[x] - 1;
+        int lineHeight = (int)(height * vFOV / hit.dist);
+        int drawStart = -lineHeight / 2 + (height / 2) + ((cam.vertHeight * height) / hit.dist) + cam.vertLook;
+        int drawEnd = lineHeight / 2 + (height / 2) + ((cam.vertHeight * height) / hit.dist) + cam.vertLook;
+        spans[x] = drawStart * (height + 1) + drawEnd;
+    }
+}
 
+template<typename Real>
+void precisionFloorRow(const Camera_State &cam, double rowDist, int width, int texWidth, int texHeight, std::vector<Sint64> &texels)
+{
+    Real rayDirX0 = cam.dirX - cam.planeX;
+    Real rayDirY0 = cam.dirY - cam.planeY;
+    Real rayDirX1 = cam.dirX + cam.planeX;
+    Real rayDirY1 = cam.dirY + cam.planeY;
+    Real floorStepX = rowDist * realToDouble(rayDirX1 - rayDirX0) / width;
+    Real floorStepY = rowDist * realToDouble(rayDirY1 - rayDirY0) / width;
+    Real floorX = cam.posX + rowDist * realToDouble(rayDirX0);
+    Real floorY = cam.posY + rowDist * realToDouble(rayDirY0);
+    for(int x = 0; x < width; ++x)
+    {
+        int cellX = realToInt(floorX);
+        int cellY = realToInt(floorY);
+        int tx = realToInt(texWidth * (floorX - cellX)) & (texWidth - 1);
+        int ty = realToInt(texHeight * (floorY - cellY)) & (texHeight - 1);
+        floorX += floorStepX;
+        floorY += floorStepY;
+        texels[x] = ((Sint64)cellX * 4096 * 4096 + (Sint64)cellY * 4096) * texWidth * texHeight + ty * texWidth + tx; //a different cell is a different texel too
+    }
+}
 
-        for(int y = 0; y < start; y++)
+void comparePrecision(Precision_Stats &stats, const std::vector<Ray_Hit> &refHits, const std::vector<int> &refTexX, const std::vector<int> &refSpans,
+                      const std::vector<Ray_Hit> &hits, const std::vector<int> &texX, const std::vector<int> &spans)
+{
+    const int width = refHits.size();
+    std::vector<Uint8> wrong(width, 0);
+    for(int x = 0; x < width; x++)
+    {
+        const Ray_Hit &ref = refHits[x], &hit = hits[x];
+        if(ref.found && leveldata[ref.mapX][ref.mapY].isDoor)
         {
-            double dist = floorDist[y] * floorDist[y] * (90.0/hFOV) * (90.0/hFOV);
-            brightness = std::min(1.0,std::max(worldFog,std::min(playerFog,playerFog/((fogMultiplier*  brightSin[x]) * dist))));
-            
-            fogColor.a = (Uint8)255.0*(1.0-std::min(1.0,std::max(worldFog, brightness)));
-            pixels[y * texWidth + x] = SDL_MapRGBA(mappingFormat, fogColor.r, fogColor.g, fogColor.b, fogColor.a);
+            //the door's slide moves its edge, and the texture column, off the cell grid. counted on their own
+            stats.doorColumns++;
+            wrong[x] = ref.found != hit.found || ref.mapX != hit.mapX || ref.mapY != hit.mapY || ref.side != hit.side || texX[x] != refTexX[x];
+            stats.wrongDoor += wrong[x];
+            continue;
         }
-        
-        double tempdist = wallDist[x] * wallDist[x] * (90.0/hFOV) * (90.0/hFOV);
-        
-        brightness = std::min(1.0,std::max(worldFog,std::min(playerFog,playerFog/((fogMultiplier* brightSin[x]) * tempdist))));
-        fogColor.a = (Uint8)255.0*(1.0-std::min(1.0,std::max(worldFog, brightness)));
-        for(int y = start; y < end; y++)
+        stats.columns++;
+        if(ref.found != hit.found || ref.mapX != hit.mapX || ref.mapY != hit.mapY)
         {
-            pixels[y * texWidth + x] = SDL_MapRGBA(mappingFormat, fogColor.r, fogColor.g, fogColor.b, fogColor.a);
+            stats.wrongCell++;
+            wrong[x] = 1;
+            continue;
         }
-        for(int y = end; y < texHeight; y++)
+        if(ref.side != hit.side)
         {
-            double dist = floorDist[y] * floorDist[y] * (90.0/hFOV) * (90.0/hFOV);
-            brightness = std::min(1.0,std::max(worldFog,std::min(playerFog,playerFog/((fogMultiplier* brightSin[x]) * dist))));
-            fogColor.a = (Uint8)255.0*(1.0-std::min(1.0,std::max(worldFog, brightness)));
-            pixels[y * texWidth + x] = SDL_MapRGBA(mappingFormat, fogColor.r, fogColor.g, fogColor.b, fogColor.a);
+            stats.wrongSide++;
+            wrong[x] = 1;
+            continue;
+        }
+        double error = std::abs(hit.dist - ref.dist);
+        stats.maxDistError = std::max(stats.maxDistError, error);
+        stats.maxRelError = std::max(stats.maxRelError, error / std::max(ref.dist, 1e-9));
+        if(spans[x] != refSpans[x])
+            stats.wrongSpan++;
+        if(texX[x] != refTexX[x])
+        {
+            stats.wrongTexX++;
+            wrong[x] = 1;
         }
-        
     }
-    SDL_FreeFormat(mappingFormat);
-    SDL_UnlockTexture(tex);
-
-    return;
-}
-
-void drawHud()
-{
-    drawWeap();
-    if(mapOn)
-        drawMiniMap();
-    return;
-}
-void drawWeap()
-{
-    renderTexture(weaponTex, gRenderer, weaponDestRect, &weaponTexRect);
-    return;
+    for(int x = 1; x + 1 < width; x++)
+        stats.seams += wrong[x] && !wrong[x - 1] && !wrong[x + 1];
 }
 
-void drawMiniMap()
+void runPrecisionReport()
 {
-
-    SDL_SetRenderDrawColor(gRenderer, cBlack.r, cBlack.g, cBlack.b, cBlack.a);
-    SDL_RenderFillRect(gRenderer, &miniMapRect);
-    for(int y = 0; y < mapHeight; y++)
+    //random views on every map, each cast in double, float and 16.16 fixed point. double is the reference.
+    //doors are left part open like the golden harness leaves them
+    const int views = 64;
+    const double doorTimers[3] = {0.25, 0.5, 0.75};
+    const int width = gscreenWidth, height = gscreenHeight;
+    const char *names[2] = {"float", "16.16 fixed"};
+    Precision_Stats stats[2];
+    std::vector<Ray_Hit> refHits(width), hits(width);
+    std::vector<int> refTexX(width), refSpans(width), texX(width), spans(width);
+    std::vector<Sint64> refTexels(width), texels(width);
+    std::vector<double> rowDist(height);
+    const Texel_Image &floorTex = gfloorTexels.levels[0];
+    const double dirLength = std::sqrt(dirX * dirX + dirY * dirY); //keeps the fov of the game camera
+    int maps = 0;
+    srand(1);
+    printf("Precision: this build casts rays in %s and steps the floor in %s\n", precisionName(RAY_PRECISION), precisionName(FLOOR_PRECISION));
+    for(const std::string &mapName : listMapFiles())
     {
+        loadLevel(getProjectPath("resources") + "maps" + PATH_SYM + mapName + ".txt");
+        int doors = 0;
         for(int x = 0; x < mapWidth; x++)
+            for(int y = 0; y < mapHeight; y++)
+                if(leveldata[x][y].isDoor)
+                    leveldata[x][y].timer = doorTimers[doors++ % 3];
+        std::vector<int> open;
+        for(int y = 0; y < mapHeight; y++)
+            for(int x = 0; x < mapWidth; x++)
+                if(!leveldata[x][y].solid)
+                    open.push_back(x + y * mapWidth);
+        if(open.empty())
+            continue;
+        maps++;
+        for(int view = 0; view < views; view++)
         {
-            if(leveldata[x][y].visible)
+            Camera_State cam;
+            int cell = open[rand() % open.size()];
+            double angle = (rand() % 36000) / 36000.0 * 2 * M_PI;
+            cam.posX = cell % mapWidth + 0.05 + (rand() % 900) / 1000.0;
+            cam.posY = cell / mapWidth + 0.05 + (rand() % 900) / 1000.0;
+            cam.dirX = std::cos(angle) * dirLength;
+            cam.dirY = std::sin(angle) * dirLength;
+            cam.planeX = -std::sin(angle);
+            cam.planeY = std::cos(angle);
+            cam.vertHeight = 0.1;
+            precisionColumns<double>(cam, width, height, refHits, refTexX, refSpans);
+            precisionColumns<float>(cam, width, height, hits, texX, spans);
+            comparePrecision(stats[0], refHits, refTexX, refSpans, hits, texX, spans);
+            precisionColumns<Fixed16>(cam, width, height, hits, texX, spans);
+            comparePrecision(stats[1], refHits, refTexX, refSpans, hits, texX, spans);
+
+            calcFloorDist(&rowDist[0], height, cam.vertLook, cam.vertHeight);
+            for(int y = height / 2 + 1; y < height; y++)
             {
-                switch(leveldata[x][y].block_id)
+                precisionFloorRow<double>(cam, rowDist[y], width, floorTex.w, floorTex.h, refTexels);
+                for(int type = 0; type < 2; type++)
                 {
-                    case(1):
-                        SDL_SetRenderDrawColor(gRenderer, cBlue.r, cBlue.g, cBlue.b, cBlue.a);
-                        break;
-                    case(2):
-                        SDL_SetRenderDrawColor(gRenderer, cGreen.r, cGreen.g, cGreen.b, cGreen.a);
-                        break;
-                    case(3):
-                        SDL_SetRenderDrawColor(gRenderer, cRed.r, cRed.g, cRed.b, cRed.a);
-                        break;
-                    default:
-                        SDL_SetRenderDrawColor(gRenderer, cBlack.r, cBlack.g, cBlack.b, cBlack.a);
-                        break;
+                    if(type == 0)
+                        precisionFloorRow<float>(cam, rowDist[y], width, floorTex.w, floorTex.h, texels);
+                    else
+                        precisionFloorRow<Fixed16>(cam, rowDist[y], width, floorTex.w, floorTex.h, texels);
+                    for(int x = 0; x < width; x++)
+                        stats[type].wrongFloor += texels[x] != refTexels[x];
+                    stats[type].floorPixels += width;
                 }
-                miniMapDot.x = miniMapRect.x + 2*x;
-                miniMapDot.y = miniMapRect.y + 2*y;
-                SDL_RenderDrawRect(gRenderer, &miniMapDot);
             }
         }
     }
-    SDL_SetRenderDrawColor(gRenderer, cYellow.r, cYellow.g, cYellow.b, cYellow.a);
-    miniMapDot.x = miniMapRect.x + 2*(int)posX;
-    miniMapDot.y = miniMapRect.y + 2*(int)posY;
-    SDL_RenderDrawRect(gRenderer, &miniMapDot);
-    SDL_SetRenderDrawColor(gRenderer, cCyan.r, cCyan.g, cCyan.b, cCyan.a);
-    SDL_RenderDrawLine(gRenderer, miniMapRect.x + 2*(int)posX, miniMapRect.y + 2*(int)posY, miniMapRect.x + 2*(int)(blockLeftX), miniMapRect.y + 2*(int)(blockLeftY));
-    SDL_RenderDrawLine(gRenderer, miniMapRect.x + 2*(int)posX, miniMapRect.y + 2*(int)posY, miniMapRect.x + 2*(int)(blockRightX), miniMapRect.y + 2*(int)(blockRightY));
-    SDL_RenderDrawLine(gRenderer, miniMapRect.x + 2*(int)posX, miniMapRect.y + 2*(int)posY, miniMapRect.x + 2*(int)(blockAheadX), miniMapRect.y + 2*(int)(blockAheadY));
-    return;
+    printf("Precision: %d maps, %d views each at %dx%d\n", maps, views, width, height);
+    for(int type = 0; type < 2; type++)
+    {
+        const Precision_Stats &s = stats[type];
+        double columns = std::max<Uint64>(s.columns, 1) / 100.0, pixels = std::max<Uint64>(s.floorPixels, 1) / 100.0;
+        printf("Precision: %-11s wrong cell %.4f%%, wrong side %.4f%%, wallDist error up to %.2g (%.2g relative)\n",
+               names[type], s.wrongCell / columns, s.wrongSide / columns, s.maxDistError, s.maxRelError);
+        printf("Precision: %-11s wall span %.4f%%, texture column %.4f%%, %llu seam columns, floor texels %.4f%%\n",
+               names[type], s.wrongSpan / columns, s.wrongTexX / columns, (unsigned long long)s.seams, s.wrongFloor / pixels);
+        printf("Precision: %-11s part open doors %.4f%% of %llu columns wrong\n",
+               names[type], s.wrongDoor * 100.0 / std::max<Uint64>(s.doorColumns, 1), (unsigned long long)s.doorColumns);
+    }
 }
 
-void newlevel(bool warpView)
+int runGoldenHarness()
 {
-        enableInput = false; //shouldn't matter but just in case, disable player input during new level load
-        if(warpView)
-        {
-            for(int i = 0; i < 50; i++)
-            {
-                viewTrip -= 0.2; //make floor and ceiling appear to stretch / fall away. acid trip effect. just for fun
-
-                updateScreen();
-                SDL_Delay(20);
-            }
-        }
-
-        //randomly load a new level from maps directory, named map0.txt to map19.txt
-        //eventually this might get replced with the random level gen function or something else
-        std::stringstream levelFileName;
-        srand(time(0));
-        std::string thisMap;
-        thisMap += "map";
-        thisMap += std::to_string(rand() % 20);
-        levelFileName << getProjectPath("resources") << PATH_SYM << "maps" << PATH_SYM << thisMap << ".txt";
-        ceilingOn = rand()%2;
-        printf("Map: %s\n", thisMap.c_str());
-        loadLevel(levelFileName.str());
-
-        //reset all the camera stuff
-        //dirX = std::tan((hFOV*degToRad)/2);
-        //dirX = std::sqrt(dirX*dirX+dirY*dirY); //preserve hfov. not sure why the other way isn't working
-        double oldFOV = hFOV;
-        changeFOV(false, 90);
-        dirX = 1;
-        dirY = 0;
-        changeFOV(false, oldFOV);        
-        planeX = 0;
-        planeY = 1;
+    //every map from its start cell looking along each axis, drawn with each combination of fog, ceiling and
+    //debug colors. doors are left part open so the sliding door columns are covered too
+    const int headings = 4;
+    const int timedRuns = 5;
+    const double doorTimers[3] = {0.25, 0.5, 0.75};
+    const std::string timesPath = ggoldenDir + PATH_SYM + goldenTimesFile;
+    std::map<std::string, double> refTimes, times;
+    if(!ggoldenRecord && !readGoldenTimes(timesPath, refTimes))
+    {
+        //references depend on the renderer and the times on the machine, so nothing is shipped. see the README
+        printf("Golden: nothing recorded in %s. record references on this machine from a known good build first with\n", ggoldenDir.c_str());
+        printf("Golden:   raycaster --golden-record %s\n", ggoldenDir.c_str());
+        return 1;
+    }
+    const std::vector<std::string> mapNames = listMapFiles();
+    if(mapNames.empty())
+    {
+        printf("Golden: no maps found in %smaps\n", getProjectPath("resources").c_str());
+        return 1;
+    }
+    std::vector<std::pair<double, std::string>> slower; //ms over the recorded time, for the views that have one
+    double total = 0, refTotal = 0;
+    int views = 0, failed = 0;
+    Golden_Image image, reference;
+    Frame_Slot &frame = gframes[0], &prev = gframes[1];
+
+    //draw like the game does, on as many threads as it would
+    int threads = gframeThreads > 0 ? gframeThreads : SDL_GetCPUCount();
+    if(threads > 1)
+    {
+        startTaskScheduler(gframeScheduler, threads);
+        gframeTasks.columnBands = frameTaskBands;
+        gframeTasks.rowBands = frameTaskBands;
+    }
+    lateLatchOn = false; //the mouse mustn't move the camera
+    mapOn = false;
+    printf("Golden: %s %s, %d maps, %d render threads\n", ggoldenRecord ? "recording to" : "checking against", ggoldenDir.c_str(), (int)mapNames.size(), threads);
+    for(int map = 0; map < (int)mapNames.size(); map++)
+    {
+        loadLevel(getProjectPath("resources") + "maps" + PATH_SYM + mapNames[map] + ".txt");
+        gmapName = mapNames[map];
+        srand(map); //sprites without a place in the map file are scattered at random
+        initAllSprites();
+        int doors = 0;
+        for(int x = 0; x < mapWidth; x++)
+            for(int y = 0; y < mapHeight; y++)
+                if(leveldata[x][y].isDoor)
+                    leveldata[x][y].timer = doorTimers[doors++ % 3];
         vertLook = 0;
         vertHeight = 0.1;
         viewTrip = 0;
-        initAllSprites();
-        calcFloorDist();
-
-        int tw, th;
-        SDL_QueryTexture(gskyTex, NULL, NULL, &tw, &th);
-        gskySrcRect.y = (int)std::round(((double)th/2.0 - (double)gskySrcRect.h/2.0) - ((double)vertLook * ((double)gskySrcRect.h/(double)gskyDestRect.h)));
-        if (gskySrcRect.y < 0)
-            gskySrcRect.y = 0;
-        gfloorRect.y = gscreenHeight / 2 + vertLook;
-        gfloorRect.h = gscreenHeight - gfloorRect.y;
+        updateVerticalView();
 
-        miniMapRect = { gscreenWidth - (mapWidth*2) - gscreenWidth/16,
-                        gscreenHeight / 16,
-                        mapWidth*2,
-                        mapHeight*2 };
+        for(int heading = 0; heading < headings; heading++)
+        {
+            double angle = heading * M_PI / 2;
+            hFOV = 90;
+            dirX = std::cos(angle);
+            dirY = std::sin(angle);
+            planeX = -std::sin(angle);
+            planeY = std::cos(angle);
+            for(int settings = 0; settings < 8; settings++)
+            {
+                fogOn = settings & 1;
+                ceilingOn = settings & 2;
+                debugColors = settings & 4;
+                char name[64];
+                snprintf(name, sizeof(name), "map%d_view%d_fog%d_ceiling%d_debug%d", map, heading, (int)fogOn, (int)ceilingOn, (int)debugColors);
+
+                double ms = timeGoldenView(frame, prev, timedRuns);
+                drawFrame(frame);
+                bool grabbed = grabGoldenImage(gRenderer, image);
+                SDL_RenderPresent(gRenderer);
+                views++;
+                times[name] = ms;
+                std::map<std::string, double>::iterator recorded = refTimes.find(name);
+                if(recorded != refTimes.end() && recorded->second > 0)
+                {
+                    total += ms;
+                    refTotal += recorded->second;
+                    slower.push_back(std::make_pair(ms - recorded->second, std::string(name)));
+                }
+                if(!grabbed)
+                {
+                    printf("Golden: %s couldn't be read back. SDL Error: %s\n", name, SDL_GetError());
+                    failed++;
+                    continue;
+                }
 
+                std::string path = ggoldenDir + PATH_SYM + name + ".ppm";
+                if(ggoldenRecord)
+                {
+                    if(!writeGoldenImage(path, image))
+                    {
+                        printf("Golden: couldn't write %s\n", path.c_str());
+                        failed++;
+                    }
+                    continue;
+                }
+                if(!readGoldenImage(path, reference))
+                {
+                    printf("Golden: %s has no reference image\n", name);
+                    failed++;
+                    continue;
+                }
+                Golden_Diff diff = compareGoldenImages(image, reference, ggoldenTolerance);
+                if(diff.sizeMismatch)
+                    printf("Golden: %s is %dx%d, its reference is %dx%d\n", name, image.width, image.height, reference.width, reference.height);
+                else if(diff.differing > 0)
+                    printf("Golden: %s differs in %llu pixels, by up to %d\n", name, (unsigned long long)diff.differing, diff.maxDiff);
+                else
+                    continue;
+                failed++;
+                writeGoldenImage(ggoldenDir + PATH_SYM + name + "_got.ppm", image);
+            }
+        }
+    }
+    stopTaskScheduler(gframeScheduler);
 
-        enableInput = true;
+    if(ggoldenRecord)
+    {
+        if(!writeGoldenTimes(timesPath, times))
+        {
+            printf("Golden: couldn't write %s\n", timesPath.c_str());
+            failed++;
+        }
+        printf("Golden: recorded %d views, %d failed\n", views - failed, failed);
+        return failed > 0 ? 1 : 0;
+    }
+    printf("Golden: %d views, %d differ from their references by more than %d\n", views, failed, ggoldenTolerance);
+    bool tooSlow = false;
+    if(refTotal > 0)
+    {
+        double change = (total / refTotal - 1.0) * 100.0;
+        tooSlow = change > ggoldenSlowdown;
+        printf("Golden: render time %.2fms over %d timed views, recorded %.2fms, %+.1f%%%s\n", total, (int)slower.size(), refTotal, change,
+               tooSlow ? ", slower than allowed" : "");
+        std::sort(slower.rbegin(), slower.rend());
+        for(std::size_t i = 0; i < std::min<std::size_t>(slower.size(), 5) && slower[i].first > 0; i++)
+            printf("Golden:   %s %+.3fms, now %.3fms\n", slower[i].second.c_str(), slower[i].first, times[slower[i].second]);
+    }
+    else
+        printf("Golden: no recorded times in %s, render time not checked\n", timesPath.c_str());
+    return (failed > 0 || tooSlow) ? 1 : 0;
 }
 
-void loadLevel(std::string path)
+double timeGoldenView(Frame_Slot &frame, Frame_Slot &prev, int runs)
 {
-    
-
-    std::ifstream mapFile(path);
-    int a;
-    mapFile >> a;
-    posX = a + 0.5;
-    mapFile >> a;
-    posY = a + 0.5;
-    mapFile >> a;
-    mapWidth = a;
-    mapFile >> a;
-    mapHeight = a;
-
-    leveldata.resize(mapWidth);
-    for (int i = 0; i < mapWidth; i++)
+    //one untimed run to warm the caches, then the median. every run starts with nothing to reproject and
+    //every row to upload so the last one, which gets drawn, is the same whatever came before it
+    std::vector<double> ms;
+    for(int run = 0; run <= runs; run++)
     {
-        leveldata[i].resize(mapHeight);
+        beginFrame(frame);
+        frame.fullUpload = true;
+        prev.floorHistoryValid = false;
+        Uint64 start = SDL_GetPerformanceCounter();
+        renderFrame(frame, prev);
+        if(run > 0)
+            ms.push_back((SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency());
     }
+    std::sort(ms.begin(), ms.end());
+    return ms.empty() ? 0 : ms[ms.size() / 2];
+}
 
-    for (int y = 0; y < mapHeight; y++)
+bool parseArgs(int argc, char **argv)
+{
+    std::string writePath;
+    for(int i = 1; i < argc; i++)
     {
-        for (int x = 0; x < mapWidth; x++)
+        std::string arg = argv[i];
+        if(arg == "--gen" && i + 2 < argc)
         {
-            mapFile >> a;
-            changeBlock(&leveldata.at(x).at(y), a);
+            glevelGenOn = true;
+            glevelGen.width = atoi(argv[++i]);
+            glevelGen.height = atoi(argv[++i]);
+        }
+        else if(arg == "--seed" && i + 1 < argc)
+        {
+            glevelGenOn = true;
+            glevelGen.seed = strtoull(argv[++i], NULL, 10);
+        }
+        else if(arg == "--gen-threads" && i + 1 < argc)
+            glevelGen.threads = atoi(argv[++i]);
+        else if(arg == "--write" && i + 1 < argc)
+            writePath = argv[++i];
+        else if(arg == "--capture" && i + 1 < argc)
+            gcapturePath = argv[++i];
+        else if(arg == "--capture-fps" && i + 1 < argc)
+            gcapture.fps = std::max(1, atoi(argv[++i]));
+        else if(arg == "--worlds" && i + 1 < argc)
+            gbatchWorldCount = std::max(1, atoi(argv[++i]));
+        else if(arg == "--obs" && i + 2 < argc)
+        {
+            gbatchObsWidth = std::max(2, atoi(argv[++i]));
+            gbatchObsHeight = std::max(2, atoi(argv[++i]));
+        }
+        else if(arg == "--world-steps" && i + 1 < argc)
+            gbatchSteps = std::max(1, atoi(argv[++i]));
+        else if(arg == "--world-threads" && i + 1 < argc)
+            gbatchThreads = atoi(argv[++i]);
+        else if(arg == "--chasers" && i + 1 < argc)
+            gchaserCount = std::max(0, atoi(argv[++i]));
+        else if(arg == "--raycast" && i + 1 < argc)
+        {
+            std::string mode = argv[++i];
+            if(mode == "faces")
+                graycastMode = RAYCAST_FACES;
+            else if(mode == "subsample")
+                graycastMode = RAYCAST_SUBSAMPLE;
+            else
+                graycastMode = RAYCAST_COLUMNS;
+        }
+        else if(arg == "--palette")
+            gpaletteOn = true;
+        else if(arg == "--floor-interlace")
+            floorInterlaceOn = true;
+        else if(arg == "--max-ray-dist" && i + 1 < argc)
+            maxRayDist = std::max(minClipDist, atof(argv[++i]));
+        else if(arg == "--isa" && i + 1 < argc && cpuLevelFromName(argv[i + 1]) >= 0)
+            gcpuLevel = cpuLevelFromName(argv[++i]);
+        else if(arg == "--precision-report")
+            gprecisionReportOn = true;
+        else if(arg == "--memory-report")
+            gmemoryReportOn = true;
+        else if(arg == "--telemetry")
+        {
+#if TELEMETRY_SHM
+            //the name is optional, the default one has the pid in it so instances on one host don't collide
+            if(i + 1 < argc && argv[i + 1][0] != '-')
+                gtelemetryName = argv[++i][0] == '/' ? argv[i] : std::string("/") + argv[i];
+            else
+                gtelemetryName = telemetryDefaultName(getpid());
+#else
+            if(i + 1 < argc && argv[i + 1][0] != '-')
+                i++;
+            printf("Telemetry: no shared memory on this platform, --telemetry is ignored\n");
+#endif
+        }
+        else if((arg == "--golden" || arg == "--golden-record") && i + 1 < argc)
+        {
+            ggoldenRecord = arg == "--golden-record";
+            ggoldenDir = argv[++i];
+        }
+        else if(arg == "--golden-tolerance" && i + 1 < argc)
+            ggoldenTolerance = std::max(0, atoi(argv[++i]));
+        else if(arg == "--golden-slowdown" && i + 1 < argc)
+            ggoldenSlowdown = std::max(0.0, atof(argv[++i]));
+        else if(arg == "--frame-threads" && i + 1 < argc)
+            gframeThreads = std::max(1, atoi(argv[++i]));
+        else if(arg == "--rays" && i + 1 < argc)
+            grayBenchCount = std::max(1, atoi(argv[++i]));
+        else if(arg == "--aux" && i + 1 < argc)
+        {
+            std::string channels = argv[++i];
+            gauxChannels = 0;
+            if(channels.find("columns") != std::string::npos || channels == "all")
+                gauxChannels |= AUX_COLUMN_DEPTH;
+            if(channels.find("depth") != std::string::npos || channels == "all")
+                gauxChannels |= AUX_DEPTH;
+            if(channels.find("surface") != std::string::npos || channels == "all")
+                gauxChannels |= AUX_SURFACE;
+            if(channels.find("sprites") != std::string::npos || channels == "all")
+                gauxChannels |= AUX_SPRITE;
+        }
+        else if(arg == "--aux-scale" && i + 1 < argc)
+            gauxScale = std::max(1, atoi(argv[++i]));
+        else
+        {
+            printf("Usage: raycaster [--gen <width> <height>] [--seed <n>] [--gen-threads <n>] [--write <map.txt>]\n");
+            printf("                 [--capture <file.y4m | prefix>] [--capture-fps <n>]\n");
+            printf("                 [--worlds <n>] [--obs <width> <height>] [--world-steps <n>] [--world-threads <n>]\n");
+            printf("                 [--aux <columns,depth,surface,sprites | all>] [--aux-scale <n>] [--rays <n>]\n");
+            printf("                 [--chasers <n>] [--max-ray-dist <blocks>] [--raycast <columns | faces | subsample>]\n");
+            printf("                 [--floor-interlace] [--palette] [--precision-report] [--isa <baseline | sse4.2 | avx2 | avx512>]\n");
+            printf("                 [--frame-threads <n>] [--memory-report] [--telemetry [name]]\n");
+            printf("                 [--golden <dir> | --golden-record <dir>] [--golden-tolerance <n>] [--golden-slowdown <percent>]\n");
+            printf("  --gen, --seed  play generated levels instead of the map files\n");
+            printf("  --write        write the generated level in map file format and quit\n");
+            printf("  --capture      record every frame to a y4m file, or to prefix_000001.ppm and so on\n");
+            printf("  --worlds       step n worlds together with random actions and report environment frames per second\n");
+            printf("  --chasers      spawn n sprites on every level that follow the player\n");
+            printf("  --raycast      faces projects whole wall faces instead of casting a ray per column, for very wide screens\n");
+            printf("                 subsample casts every %dth column and fills in between where both rays hit one face\n", raycastStride);
+            printf("  --floor-interlace cast every other floor row and reproject the rest from the last frame. walking, looking up\n");
+            printf("                 or down and turning up to about 2 degrees a frame reproject, bigger turns and jumps cast the whole\n");
+            printf("                 floor that frame. reprojected pixels show the nearest row the last frame cast, so about a fifth\n");
+            printf("                 of them can be off by a texel or so from a full cast\n");
+            printf("  --palette      draw walls, floor and ceiling with one 256 color palette, fog and shading through colormaps\n");
+            printf("  --max-ray-dist stop rays this far away and draw fog instead. thick fog lowers it on its own\n");
+            printf("  --rays         cast batches of n random line of sight rays and report rays per second\n");
+            printf("  --precision-report cast random views of every map in float and fixed point and count what differs from double\n");
+            printf("  --frame-threads split each frame's rays, floor, walls and fog over n threads, 1 draws it all on the frame thread\n");
+            printf("  --isa          run the fog kernel built for this instruction set instead of the best one the cpu has\n");
+            printf("  --memory-report print bytes held per subsystem, current and peak, on the way out. M prints it any time\n");
+            printf("  --telemetry    publish frame times, ray steps, map and camera to shared memory every frame, default name\n");
+            printf("                 %s<pid>. read it with telemetry_reader\n", telemetryPrefix);
+            printf("  --golden       draw fixed views of every map with each fog, ceiling and debug color setting, compare them\n");
+            printf("                 with the images in dir and exit nonzero if any differ or rendering got slower than allowed.\n");
+            printf("                 frames that differ are written next to their reference as name_got.ppm\n");
+            printf("  --golden-record draw the same views and write them and their render times to dir as the new reference\n");
+            printf("  --golden-tolerance largest difference of any color channel a pixel may have, 0 by default\n");
+            printf("  --golden-slowdown percent the total render time may grow over the recorded times, %.0f by default\n", ggoldenSlowdown);
+            printf("  --aux          with --worlds, also fill depth, block/face id and sprite id buffers for every observation,\n");
+            printf("                 aux-scale times smaller than it. sprite ids are index + 1, 0 for no sprite\n");
+            return false;
         }
     }
-
-    mapFile.close();
+    if(!writePath.empty())
+    {
+        Generated_Level level;
+        Uint64 start = SDL_GetPerformanceCounter();
+        generateLevel(glevelGen, level);
+        double ms = (SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency();
+        printf("Generated %dx%d level, seed %llu, %u sprites in %.1fms\n", level.width, level.height, (unsigned long long)glevelGen.seed, (unsigned)level.sprites.size(), ms);
+        if(!writeLevelFile(level, writePath))
+            printf("Couldn't write %s\n", writePath.c_str());
+        return false;
+    }
+    return true;
 }
 
 void changeFOV(bool rel, double newFOV)
@@ -1651,6 +4333,7 @@ bool handleInput()
 {
     bool quit = false;
     int mouseXDist = 0, mouseYDist = 0;
+    int useCount = 0;
     SDL_GetRelativeMouseState(&mouseXDist,&mouseYDist);
 
     const Uint8 *currentKeyStates = SDL_GetKeyboardState(NULL);
@@ -1676,27 +4359,7 @@ bool handleInput()
                 {
                     if (e.button.button == SDL_BUTTON_RIGHT && e.button.type == SDL_MOUSEBUTTONDOWN)
                     {
-                        if(blockAheadDist < 1)
-                        {
-                            switch (leveldata[blockAheadX][blockAheadY].block_id)
-                            {
-                            case BLOCK_WALL:
-                                //standard wall;
-                                break;
-                            case BLOCK_PANEL:
-                                //exit panel;
-                                newlevel(false);
-                                break;
-                            case BLOCK_DOOR:
-                                //door;
-                                //changeBlock(&leveldata[blockAheadX][blockAheadY], 0);
-                                leveldata[blockAheadX][blockAheadY].timerOn = true;
-                                break;
-                            default:
-                                //likely, an error;
-                                break;
-                            }
-                        }
+                        useCount++; //sim thread decides what was used
                     }
                 }
                 break;
@@ -1758,30 +4421,45 @@ bool handleInput()
                         {
                             if (enableInput)
                             {
-                                if(blockAheadDist < 1)
-                                {
-                                    switch (leveldata[blockAheadX][blockAheadY].block_id)
-                                    {
-                                    case BLOCK_WALL:
-                                        //standard wall;
-                                        break;
-                                    case BLOCK_PANEL:
-                                        //exit panel;
-                                        newlevel(false);
-                                        break;
-                                    case BLOCK_DOOR:
-                                        //door;
-                                        //changeBlock(&leveldata[blockAheadX][blockAheadY], 0);
-                                        leveldata[blockAheadX][blockAheadY].timerOn = true;
-                                        break;
-                                    default:
-                                        //likely, an error;
-                                        break;
-                                    }
-                                }
+                                useCount++; //sim thread decides what was used
+                            }
+                            break;
+                        }
+                        case SDLK_m:
+                        {
+                            measureMemory();
+                            printMemoryReport(gmemory);
+                            break;
+                        }
+                        case SDLK_F1:
+                        {
+                            Uint64 start = SDL_GetPerformanceCounter();
+                            captureWorld(gworldSnapshot);
+                            printf("World saved in %.0fus\n", (SDL_GetPerformanceCounter() - start) * 1000000.0 / SDL_GetPerformanceFrequency());
+                            measureSnapshotMemory();
+                            break;
+                        }
+                        case SDLK_F2:
+                        {
+                            if(gworldSnapshot.geometry)
+                            {
+                                Uint64 start = SDL_GetPerformanceCounter();
+                                restoreWorld(gworldSnapshot);
+                                printf("World restored in %.0fus\n", (SDL_GetPerformanceCounter() - start) * 1000000.0 / SDL_GetPerformanceFrequency());
                             }
                             break;
                         }
+                        case SDLK_F3:
+                        {
+                            mipmapsOn = !(mipmapsOn);
+                            break;
+                        }
+                        case SDLK_F4:
+                        {
+                            lateLatchOn = !(lateLatchOn);
+                            printf("Late latch: %s\n", lateLatchOn ? "on" : "off");
+                            break;
+                        }
                         case SDLK_F5:
                         {
                             letterboxOn = !(letterboxOn);
@@ -1867,139 +4545,47 @@ bool handleInput()
         }
     }
     
-    moveSpeed = gDeltaTimer;
-    if(moveSpeed == 0)
-        moveSpeed = 1;
-    moveSpeed = moveSpeed /(double)SDL_GetPerformanceFrequency() * 4; //effectively convert to seconds by /1000, then mult by 4. value is grid squares / sec
-    double rotSpeed = moveSpeed/2; //the value is in radians/second
-    if (mouseXDist > 0)
-        rotSpeed *= mouseXDist * mouseSense;
-    else if (mouseXDist < 0)
-        rotSpeed *= mouseXDist * -mouseSense;
-    double oldDirX = dirX;
-    double oldPlaneX = planeX;
-    if (mouseYDist > 0 && vertLook > ( (-1.0)*gscreenHeight / 2)) // look down
-    {
-        vertLook -= mouseYDist*mouseVertSense;
-        if(vertLook < ( (-1.0)*gscreenHeight / 2))
-            vertLook = ( (-1.0)*gscreenHeight / 2);
-        calcFloorDist();
-        int tw, th;
-        SDL_QueryTexture(gskyTex, NULL, NULL, &tw, &th);
-        gskySrcRect.y = (int)std::round(((double)th/2.0 - (double)gskySrcRect.h/2.0) - ((double)vertLook * ((double)gskySrcRect.h/(double)gskyDestRect.h)));
-        if(gskySrcRect.y > th - gskySrcRect.h)
-             gskySrcRect.y = th - gskySrcRect.h;
-
-        gfloorRect.y = gscreenHeight / 2 + vertLook;
-        gfloorRect.h = gscreenHeight - gfloorRect.y;
-
-    }
-    else if (mouseYDist < 0 && vertLook < (gscreenHeight / 2)) //look up
+    //hand everything that moves the player over to the sim thread. it gets applied on the next tick
+    Uint64 inputTime = SDL_GetPerformanceCounter();
+    SDL_LockMutex(gsimInputLock);
+    Sim_Input oldInput = gsimInput;
+    gsimInput.forward = currentKeyStates[SDL_SCANCODE_W] || currentKeyStates[SDL_SCANCODE_UP];
+    gsimInput.back = currentKeyStates[SDL_SCANCODE_S] || currentKeyStates[SDL_SCANCODE_DOWN];
+    gsimInput.left = currentKeyStates[SDL_SCANCODE_A] || currentKeyStates[SDL_SCANCODE_LEFT];
+    gsimInput.right = currentKeyStates[SDL_SCANCODE_D] || currentKeyStates[SDL_SCANCODE_RIGHT];
+    gsimInput.turnLeft = currentKeyStates[SDL_SCANCODE_Q];
+    gsimInput.turnRight = currentKeyStates[SDL_SCANCODE_E];
+    gsimInput.sprint = currentKeyStates[SDL_SCANCODE_LSHIFT] || currentKeyStates[SDL_SCANCODE_RSHIFT];
+    gsimInput.crouch = currentKeyStates[SDL_SCANCODE_Z];
+    gsimInput.rise = currentKeyStates[SDL_SCANCODE_X];
+    gsimInput.mouseX += mouseXDist;
+    gsimInput.mouseY += mouseYDist;
+    gsimInput.mouseTotalX += mouseXDist;
+    gsimInput.mouseTotalY += mouseYDist;
+    gsimInput.useCount += useCount;
+    gsimInput.hFOV = hFOV;
+    gsimInput.mouseSense = mouseSense;
+    gsimInput.mouseVertSense = mouseVertSense;
+
+    //number anything new for latency tracking. held keys only count when they change
+    if(mouseXDist != 0 || mouseYDist != 0)
     {
-        vertLook -= mouseYDist*mouseVertSense;
-        if(vertLook > (gscreenHeight / 2))
-            vertLook = (gscreenHeight / 2);
-        calcFloorDist();
-        int tw, th;
-        SDL_QueryTexture(gskyTex, NULL, NULL, &tw, &th);
-        gskySrcRect.y = (int)std::round(((double)th/2.0 - (double)gskySrcRect.h/2.0) - ((double)vertLook * ((double)gskySrcRect.h/(double)gskyDestRect.h)));
-        if (gskySrcRect.y < 0)
-            gskySrcRect.y = 0;
-
-        gfloorRect.y = gscreenHeight / 2 + vertLook;
-        gfloorRect.h = gscreenHeight - gfloorRect.y;
+        gsimInput.inputSeq = ++ginputSeq;
+        latencyInputSeen(glookLatency, ginputSeq, inputTime);
     }
-    //when running forward or backward while strafing, your total displacement is effectively multplied by sqrt(2)
-    //so we're just dividing speed by sqrt(2) in this situation to limit total displacement to normal values
-    if (((currentKeyStates[SDL_SCANCODE_W] || currentKeyStates[SDL_SCANCODE_UP]) ^ (currentKeyStates[SDL_SCANCODE_S] || currentKeyStates[SDL_SCANCODE_DOWN]))
-       && ((currentKeyStates[SDL_SCANCODE_A] || currentKeyStates[SDL_SCANCODE_LEFT]) ^ (currentKeyStates[SDL_SCANCODE_D] || currentKeyStates[SDL_SCANCODE_RIGHT])))
+    if(useCount > 0 || oldInput.forward != gsimInput.forward || oldInput.back != gsimInput.back
+       || oldInput.left != gsimInput.left || oldInput.right != gsimInput.right
+       || oldInput.turnLeft != gsimInput.turnLeft || oldInput.turnRight != gsimInput.turnRight
+       || oldInput.sprint != gsimInput.sprint || oldInput.crouch != gsimInput.crouch || oldInput.rise != gsimInput.rise)
     {
-        moveSpeed *= 0.707;
+        gsimInput.inputSeq = ++ginputSeq;
+        latencyInputSeen(gmoveLatency, ginputSeq, inputTime);
     }
-    //sprint by holding shift
-    if (currentKeyStates[SDL_SCANCODE_LSHIFT] || currentKeyStates[SDL_SCANCODE_RSHIFT])
-    {     
-        moveSpeed *= 1.5;
-    }    
+    SDL_UnlockMutex(gsimInputLock);
+
     //Act on keypresses
     if (currentKeyStates[SDL_SCANCODE_ESCAPE]) //Pressed escape, close window
         quit = true;
-    double xComponent = (dirX / (std::abs(dirX)+std::abs(dirY)));
-    double yComponent = (dirY / (std::abs(dirX)+std::abs(dirY)));
-    if (currentKeyStates[SDL_SCANCODE_W] || currentKeyStates[SDL_SCANCODE_UP]) //move forward
-    {
-        // the 0.3 is to try to prevent the player from normally being right up on the wall and clipping through it on corners
-        // they still CAN, but they have to on purpose essentially
-        if (leveldata[int(posX + xComponent * (0.3))][int(posY)].solid == false)
-            if (leveldata[int(posX + xComponent * moveSpeed)][int(posY)].solid == false)
-                posX += (xComponent) * moveSpeed;
-        if (leveldata[int(posX)][int(posY + yComponent * (0.3))].solid == false)
-            if (leveldata[int(posX)][int(posY + yComponent * moveSpeed)].solid == false)
-                posY += yComponent * moveSpeed;
-    }
-    if (currentKeyStates[SDL_SCANCODE_S] || currentKeyStates[SDL_SCANCODE_DOWN]) //move backward
-    {
-        if (leveldata[int(posX - xComponent * (0.3))][int(posY)].solid == false)
-            if (leveldata[int(posX - xComponent * moveSpeed)][int(posY)].solid == false)
-                posX -= xComponent * moveSpeed;
-        if (leveldata[int(posX)][int(posY - yComponent * (0.3))].solid == false)
-            if (leveldata[int(posX)][int(posY - yComponent * moveSpeed)].solid == false)
-                posY -= yComponent * moveSpeed;
-    }
-    if (currentKeyStates[SDL_SCANCODE_A] || currentKeyStates[SDL_SCANCODE_LEFT]) //strafe left
-    {
-        // the 0.3 is to try to prevent the player from normally being right up on the wall and clipping through it on corners
-        // they still CAN, but they have to on purpose essentially
-        if (leveldata[int(posX - planeX * (0.3))][int(posY)].solid == false)
-            if (leveldata[int(posX - planeX * moveSpeed)][int(posY)].solid == false)
-                posX -= planeX * (moveSpeed);
-        if (leveldata[int(posX)][int(posY - planeY * (0.3))].solid == false)
-            if (leveldata[int(posX)][int(posY - planeY * moveSpeed)].solid == false)
-                posY -= planeY * (moveSpeed);
-    }
-    if (currentKeyStates[SDL_SCANCODE_D] || currentKeyStates[SDL_SCANCODE_RIGHT]) //strafe right
-    {
-        // the 0.3 is to try to prevent the player from normally being right up on the wall and clipping through it on corners
-        // they still CAN, but they have to on purpose essentially
-        if (leveldata[int(posX + planeX * (0.3))][int(posY)].solid == false)
-            if (leveldata[int(posX + planeX * moveSpeed)][int(posY)].solid == false)
-                posX += planeX * moveSpeed;
-        if (leveldata[int(posX)][int(posY + planeY * (0.3))].solid == false)
-            if (leveldata[int(posX)][int(posY + planeY * moveSpeed)].solid == false)
-                posY += planeY * moveSpeed;
-    }
-    if ((currentKeyStates[SDL_SCANCODE_Q] || mouseXDist < 0)&&currentKeyStates[SDL_SCANCODE_E]==false) //turn left
-    {
-        //redundant key checks prevent either key having priority
-        //naively checking only one at a time can result in screen skew due to use of "oldDirX" and "oldPlaneX"
-        //both camera direction and camera plane must be rotated
-        dirX = dirX * cos(-rotSpeed) - dirY * sin(-rotSpeed);
-        dirY = oldDirX * sin(-rotSpeed) + dirY * cos(-rotSpeed);
-        planeX = planeX * cos(-rotSpeed) - planeY * sin(-rotSpeed);
-        planeY = oldPlaneX * sin(-rotSpeed) + planeY * cos(-rotSpeed);
-    }
-    else if ((currentKeyStates[SDL_SCANCODE_E] || mouseXDist > 0)&& currentKeyStates[SDL_SCANCODE_Q]==false) //turn right
-    {
-        //both camera direction and camera plane must be rotated
-        dirX = dirX * cos(rotSpeed) - dirY * sin(rotSpeed);
-        dirY = oldDirX * sin(rotSpeed) + dirY * cos(rotSpeed);
-        planeX = planeX * cos(rotSpeed) - planeY * sin(rotSpeed);
-        planeY = oldPlaneX * sin(rotSpeed) + planeY * cos(rotSpeed);
-    }
-    if(currentKeyStates[SDL_SCANCODE_Z])
-    {
-        vertHeight -= (vertSpeed) * moveSpeed; //screen height corresponds to 1 absolute world unit
-        if(vertHeight < (-0.2))
-            vertHeight = (-0.2);
-        calcFloorDist();
-    }
-    else if(currentKeyStates[SDL_SCANCODE_X])
-    {
-        vertHeight += (vertSpeed) * moveSpeed;
-        if(vertHeight > (0.4))
-            vertHeight = (0.4);
-        calcFloorDist();
-    }
     
     return quit;
-}
\ No newline at end of file
+}
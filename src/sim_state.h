@@ -0,0 +1,79 @@
+#ifndef SIM_STATE_H
+#define SIM_STATE_H
+#include <SDL2/SDL.h>
+#include <vector>
+#include "blocktypes.h"
+#include "game_sprites.h"
+#include "flow_field.h"
+
+//everything needed to place the camera in the world. see the diagram above planeX/planeY in raycaster.cpp
+struct Camera_State{
+    double posX = 2;
+    double posY = 2; //position in world coordinates
+    double dirX = 1;
+    double dirY = 0; //view direction. length controls FOV
+    double planeX = 0;
+    double planeY = 1; //camera plane, always length 1
+    double vertLook = 0; //pixels to look up/down
+    double vertHeight = 0; //camera height offset
+};
+
+//player input gathered on the main thread and handed to the sim thread once per tick
+struct Sim_Input{
+    bool forward = false;
+    bool back = false;
+    bool left = false; //strafe
+    bool right = false;
+    bool turnLeft = false;
+    bool turnRight = false;
+    bool sprint = false;
+    bool crouch = false;
+    bool rise = false;
+    int mouseX = 0;
+    int mouseY = 0; //relative mouse motion accumulated since the last tick
+    Sint64 mouseTotalX = 0;
+    Sint64 mouseTotalY = 0; //all relative mouse motion ever read. the sim passes on how much of it it has applied
+    int useCount = 0; //"use" presses since the last tick
+    double hFOV = 90.0; //current horizontal FOV, sim keeps the dir vector length in sync with it
+    double mouseSense = 0.25; //look sensitivities, copied here because the main thread changes them
+    double mouseVertSense = 0.75;
+    Uint64 inputSeq = 0; //sequence number of the newest input merged in. used for latency tracking
+};
+
+//a door whose timer changed during a sim tick. the render side applies these to its own copy of the map
+struct Door_State{
+    int x = 0;
+    int y = 0;
+    double timer = 1.0;
+    bool timerOn = false;
+    bool visible = true;
+    bool solid = true;
+};
+
+//all state owned and stepped by the simulation
+struct Sim_World{
+    std::vector<std::vector<Map_Block>> level;
+    int width = 0;
+    int height = 0;
+    Camera_State cam;
+    std::vector<Game_Sprite> sprites;
+    std::vector<Door_State> changedDoors; //doors touched since the last publish
+    bool exitRequested = false; //player used an exit panel
+    Chaser_Crowd chasers; //sprites that move toward the player
+    Flow_Field flow; //paths to the player's cell for the chasers. only sized once there are chasers
+    Uint64 inputSeq = 0; //newest input applied to this world
+    Sint64 mouseTotalX = 0;
+    Sint64 mouseTotalY = 0; //Sim_Input mouse totals as of the newest input applied
+};
+
+//immutable copy of the sim state at the end of one tick. render interpolates between two of these
+struct Sim_Snapshot{
+    Uint64 tick = 0;
+    Uint64 time = 0; //performance counter time the tick was scheduled for
+    Uint64 inputSeq = 0; //newest input this tick reflects
+    Sint64 mouseTotalX = 0;
+    Sint64 mouseTotalY = 0; //mouse motion this tick's camera reflects, see Sim_Input
+    Camera_State cam;
+    std::vector<Game_Sprite> sprites;
+};
+#endif
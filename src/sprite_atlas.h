@@ -0,0 +1,133 @@
+#ifndef SPRITE_ATLAS_H
+#define SPRITE_ATLAS_H
+#include <SDL2/SDL.h>
+#include <vector>
+#include <algorithm>
+#include "texel_store.h"
+#include "game_sprites.h"
+
+//every sprite image packed into one texture so all sprites draw without switching textures.
+//each sprite type gets its own shelf: animation frames side by side, then the matching fog mask frames.
+//source images are horizontal strips of square frames. an image that isn't a whole number of squares is one frame
+struct Sprite_Atlas{
+    Texel_Image texels; //row major copy of the whole atlas
+    SDL_Texture *tex = NULL;
+    std::vector<SDL_Rect> firstFrame; //first animation frame of each sprite type
+    std::vector<SDL_Rect> firstMask; //first fog mask frame of each sprite type
+    std::vector<int> frameCount; //animation frames of each sprite type
+    std::vector<int> maskFrameCount; //fog mask frames of each sprite type. can be fewer than frameCount, down to one
+    double frameRate = 8.0; //animation frames per second
+};
+
+void packSpriteAtlas(Sprite_Atlas &atlas, const std::vector<Texel_Image> &images, const std::vector<Texel_Image> &masks)
+{
+    int atlasW = 1, atlasH = 0;
+    for(std::size_t i = 0; i < images.size(); i++)
+    {
+        atlasW = std::max(atlasW, images[i].w + masks[i].w);
+        atlasH += std::max(images[i].h, masks[i].h);
+    }
+    atlas.texels.w = atlasW;
+    atlas.texels.h = std::max(1, atlasH);
+    atlas.texels.layout = TEXELS_ROWS;
+    buildTexelIndex(atlas.texels);
+    atlas.texels.texels.assign(atlas.texels.w * atlas.texels.h, 0);
+    atlas.firstFrame.resize(images.size());
+    atlas.firstMask.resize(images.size());
+    atlas.frameCount.resize(images.size());
+    atlas.maskFrameCount.resize(images.size());
+
+    int shelfY = 0;
+    for(std::size_t i = 0; i < images.size(); i++)
+    {
+        const Texel_Image &image = images[i];
+        const Texel_Image &mask = masks[i];
+        int frames = (image.h > 0 && image.w > image.h && image.w % image.h == 0) ? image.w / image.h : 1;
+        int frameW = image.w / frames;
+        for(int y = 0; y < image.h; y++)
+            for(int x = 0; x < image.w; x++)
+                atlas.texels.texels[(shelfY + y) * atlasW + x] = texelAt(image, x, y);
+        for(int y = 0; y < mask.h; y++)
+            for(int x = 0; x < mask.w; x++)
+                atlas.texels.texels[(shelfY + y) * atlasW + image.w + x] = texelAt(mask, x, y);
+        atlas.firstFrame[i] = {0, shelfY, frameW, image.h};
+        atlas.firstMask[i] = {image.w, shelfY, std::min(frameW, mask.w), mask.h};
+        atlas.frameCount[i] = frames;
+        atlas.maskFrameCount[i] = std::max(1, atlas.firstMask[i].w > 0 ? mask.w / atlas.firstMask[i].w : 1);
+        shelfY += std::max(image.h, mask.h);
+    }
+}
+
+bool createAtlasTexture(Sprite_Atlas &atlas, SDL_Renderer *renderer)
+{
+    atlas.tex = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA32, SDL_TEXTUREACCESS_STATIC, atlas.texels.w, atlas.texels.h);
+    if(atlas.tex == NULL)
+        return false;
+    SDL_UpdateTexture(atlas.tex, NULL, &atlas.texels.texels[0], atlas.texels.w * sizeof(Uint32));
+    SDL_SetTextureBlendMode(atlas.tex, SDL_BLENDMODE_BLEND);
+    return true;
+}
+
+void setSpriteFrame(const Sprite_Atlas &atlas, Game_Sprite &sprite, int frame)
+{
+    sprite.totalFrames = atlas.frameCount[sprite.texID];
+    sprite.frame = frame % sprite.totalFrames;
+    sprite.image = atlas.firstFrame[sprite.texID];
+    sprite.image.x += sprite.frame * sprite.image.w;
+}
+
+//fog mask for whatever frame the sprite is showing. a mask with fewer frames holds its last one
+SDL_Rect spriteMaskRect(const Sprite_Atlas &atlas, const Game_Sprite &sprite)
+{
+    SDL_Rect mask = atlas.firstMask[sprite.texID];
+    mask.x += std::min(sprite.frame, atlas.maskFrameCount[sprite.texID] - 1) * mask.w;
+    return mask;
+}
+
+//advance every sprite's animation in one pass. frames of a type sit next to each other,
+//so moving to the next frame only slides the image rect along the shelf
+void animateSprites(const Sprite_Atlas &atlas, std::vector<Game_Sprite> &sprites, double dt)
+{
+    double frames = dt * atlas.frameRate;
+    for(std::size_t i = 0; i < sprites.size(); i++)
+    {
+        Game_Sprite &sprite = sprites[i];
+        if(sprite.totalFrames < 2)
+            continue;
+        sprite.frameTime += frames;
+        if(sprite.frameTime >= 1.0)
+        {
+            int advance = (int)sprite.frameTime;
+            sprite.frameTime -= advance;
+            sprite.frame = (sprite.frame + advance) % sprite.totalFrames;
+            sprite.image.x = atlas.firstFrame[sprite.texID].x + sprite.frame * sprite.image.w;
+        }
+    }
+}
+
+#if SDL_VERSION_ATLEAST(2,0,18)
+//queue one screen aligned quad showing src (atlas pixels) stretched over dest, trimmed to clip
+void addSpriteQuad(const Sprite_Atlas &atlas, std::vector<SDL_Vertex> &verts, std::vector<int> &indices, SDL_Rect dest, SDL_Rect clip, SDL_Rect src, SDL_Color color)
+{
+    SDL_Rect visible;
+    if(dest.w <= 0 || dest.h <= 0 || !SDL_IntersectRect(&dest, &clip, &visible))
+        return;
+    //sprites are never rotated, so texture coords just scale with how much of dest got trimmed
+    float u0 = (src.x + (visible.x - dest.x) * (float)src.w / dest.w) / atlas.texels.w;
+    float u1 = (src.x + (visible.x + visible.w - dest.x) * (float)src.w / dest.w) / atlas.texels.w;
+    float v0 = (src.y + (visible.y - dest.y) * (float)src.h / dest.h) / atlas.texels.h;
+    float v1 = (src.y + (visible.y + visible.h - dest.y) * (float)src.h / dest.h) / atlas.texels.h;
+    float x0 = visible.x, x1 = visible.x + visible.w;
+    float y0 = visible.y, y1 = visible.y + visible.h;
+
+    int first = verts.size();
+    verts.push_back(SDL_Vertex{{x0, y0}, color, {u0, v0}});
+    verts.push_back(SDL_Vertex{{x1, y0}, color, {u1, v0}});
+    verts.push_back(SDL_Vertex{{x1, y1}, color, {u1, v1}});
+    verts.push_back(SDL_Vertex{{x0, y1}, color, {u0, v1}});
+    int quad[6] = {0, 1, 2, 0, 2, 3};
+    for(int i = 0; i < 6; i++)
+        indices.push_back(first + quad[i]);
+}
+#endif
+#endif
@@ -0,0 +1,248 @@
+#ifndef TASK_GRAPH_H
+#define TASK_GRAPH_H
+#include <SDL2/SDL.h>
+#include <vector>
+#include <deque>
+#include <algorithm>
+
+//a frame's work as a small graph of tasks, each runnable once the tasks it depends on are done. every thread has
+//its own queue: tasks a thread makes ready go on the back of its own queue and it takes the newest one next, while
+//a thread with nothing left takes the oldest task off the front of someone else's. like Worker_Pool the calling
+//thread works too and runTaskGraph only returns when every task has finished
+
+struct Graph_Task{
+    void (*run)(void *data, int index) = NULL;
+    void *data = NULL;
+    int index = 0;
+    int dependencies = 0; //tasks that have to finish first
+    std::vector<int> dependents; //tasks waiting on this one
+    SDL_atomic_t waiting; //dependencies still running in the current run
+};
+
+struct Task_Graph{
+    std::vector<Graph_Task> tasks;
+    int count = 0; //tasks in use. the rest are kept so their dependents lists don't have to be allocated again
+};
+
+struct Task_Queue{
+    SDL_SpinLock lock = 0;
+    std::deque<int> tasks;
+};
+
+struct Task_Scheduler;
+
+struct Task_Worker{
+    Task_Scheduler *scheduler = NULL;
+    int queue = 0;
+};
+
+struct Task_Scheduler{
+    std::vector<SDL_Thread *> threads;
+    std::vector<Task_Worker> workers;
+    std::vector<Task_Queue> queues; //one per thread, queues[0] belongs to whoever calls runTaskGraph
+    SDL_mutex *lock = NULL;
+    SDL_cond *wake = NULL; //a new graph is ready, or quit
+    SDL_cond *idle = NULL; //a worker is done with the current graph
+    SDL_sem *ready = NULL; //posted once for every task made ready, and to let everyone go once the graph is done
+    Task_Graph *graph = NULL;
+    SDL_atomic_t remaining; //tasks not finished yet
+    SDL_atomic_t steals; //tasks taken from another thread's queue, how often the bands needed evening out
+    int busy = 0; //workers still inside the current graph
+    Uint64 batch = 0;
+    bool quit = false;
+};
+
+void clearTaskGraph(Task_Graph &graph)
+{
+    graph.count = 0;
+}
+
+int addGraphTask(Task_Graph &graph, void (*run)(void *data, int index), void *data, int index)
+{
+    if(graph.count == (int)graph.tasks.size())
+        graph.tasks.push_back(Graph_Task());
+    Graph_Task &task = graph.tasks[graph.count];
+    task.run = run;
+    task.data = data;
+    task.index = index;
+    task.dependencies = 0;
+    task.dependents.clear();
+    return graph.count++;
+}
+
+//after can't start until before has finished
+void addTaskDependency(Task_Graph &graph, int before, int after)
+{
+    graph.tasks[before].dependents.push_back(after);
+    graph.tasks[after].dependencies++;
+}
+
+void pushGraphTask(Task_Queue &queue, int task)
+{
+    SDL_AtomicLock(&queue.lock);
+    queue.tasks.push_back(task);
+    SDL_AtomicUnlock(&queue.lock);
+}
+
+//newest from our own queue, or else the oldest from anyone else's. -1 if every queue is empty
+int takeGraphTask(Task_Scheduler &scheduler, int own)
+{
+    int task = -1;
+    Task_Queue &queue = scheduler.queues[own];
+    SDL_AtomicLock(&queue.lock);
+    if(!queue.tasks.empty())
+    {
+        task = queue.tasks.back();
+        queue.tasks.pop_back();
+    }
+    SDL_AtomicUnlock(&queue.lock);
+    const int queueCount = scheduler.queues.size();
+    for(int i = 1; i < queueCount && task < 0; i++)
+    {
+        Task_Queue &victim = scheduler.queues[(own + i) % queueCount];
+        SDL_AtomicLock(&victim.lock);
+        if(!victim.tasks.empty())
+        {
+            task = victim.tasks.front();
+            victim.tasks.pop_front();
+            SDL_AtomicAdd(&scheduler.steals, 1);
+        }
+        SDL_AtomicUnlock(&victim.lock);
+    }
+    return task;
+}
+
+//run tasks until the whole graph is done, sleeping whenever there's nothing ready
+void drainTaskGraph(Task_Scheduler &scheduler, int own)
+{
+    Task_Graph &graph = *scheduler.graph;
+    while(SDL_AtomicGet(&scheduler.remaining) > 0)
+    {
+        int index = takeGraphTask(scheduler, own);
+        if(index < 0)
+        {
+            SDL_SemWait(scheduler.ready);
+            continue;
+        }
+        Graph_Task &task = graph.tasks[index];
+        task.run(task.data, task.index);
+        for(std::size_t i = 0; i < task.dependents.size(); i++)
+        {
+            int next = task.dependents[i];
+            if(SDL_AtomicAdd(&graph.tasks[next].waiting, -1) == 1)
+            {
+                pushGraphTask(scheduler.queues[own], next);
+                SDL_SemPost(scheduler.ready);
+            }
+        }
+        if(SDL_AtomicAdd(&scheduler.remaining, -1) == 1)
+        {
+            //that was the last one, wake everybody still waiting so they can leave
+            for(std::size_t i = 0; i < scheduler.queues.size(); i++)
+                SDL_SemPost(scheduler.ready);
+        }
+    }
+}
+
+int taskSchedulerThread(void *data)
+{
+    Task_Worker &worker = *(Task_Worker *)data;
+    Task_Scheduler &scheduler = *worker.scheduler;
+    Uint64 seen = 0;
+    SDL_LockMutex(scheduler.lock);
+    while(true)
+    {
+        while(!scheduler.quit && scheduler.batch == seen)
+            SDL_CondWait(scheduler.wake, scheduler.lock);
+        if(scheduler.quit)
+            break;
+        seen = scheduler.batch;
+        SDL_UnlockMutex(scheduler.lock);
+        drainTaskGraph(scheduler, worker.queue);
+        SDL_LockMutex(scheduler.lock);
+        scheduler.busy--;
+        SDL_CondSignal(scheduler.idle);
+    }
+    SDL_UnlockMutex(scheduler.lock);
+    return 0;
+}
+
+void startTaskScheduler(Task_Scheduler &scheduler, int threadCount)
+{
+    scheduler.lock = SDL_CreateMutex();
+    scheduler.wake = SDL_CreateCond();
+    scheduler.idle = SDL_CreateCond();
+    scheduler.ready = SDL_CreateSemaphore(0);
+    SDL_AtomicSet(&scheduler.remaining, 0);
+    SDL_AtomicSet(&scheduler.steals, 0);
+    //sized once up front, the threads keep pointers into these
+    threadCount = std::max(1, threadCount);
+    scheduler.queues.resize(threadCount);
+    scheduler.workers.resize(threadCount);
+    for(int i = 1; i < threadCount; i++) //the thread calling runTaskGraph is queue 0
+    {
+        scheduler.workers[i].scheduler = &scheduler;
+        scheduler.workers[i].queue = scheduler.threads.size() + 1;
+        SDL_Thread *thread = SDL_CreateThread(taskSchedulerThread, "task", &scheduler.workers[i]);
+        if(thread != NULL)
+            scheduler.threads.push_back(thread);
+    }
+    scheduler.queues.resize(scheduler.threads.size() + 1); //no queues for threads that didn't start
+}
+
+void runTaskGraph(Task_Scheduler &scheduler, Task_Graph &graph)
+{
+    if(graph.count == 0)
+        return;
+    SDL_LockMutex(scheduler.lock);
+    //the workers are all asleep between graphs, nothing touches the queues or the semaphore right now
+    while(SDL_SemTryWait(scheduler.ready) == 0)
+        ;
+    scheduler.graph = &graph;
+    SDL_AtomicSet(&scheduler.remaining, graph.count);
+    int roots = 0;
+    for(int i = 0; i < graph.count; i++)
+    {
+        SDL_AtomicSet(&graph.tasks[i].waiting, graph.tasks[i].dependencies);
+        if(graph.tasks[i].dependencies == 0)
+        {
+            //deal the starting tasks out so every thread has something of its own
+            scheduler.queues[roots % scheduler.queues.size()].tasks.push_back(i);
+            SDL_SemPost(scheduler.ready);
+            roots++;
+        }
+    }
+    scheduler.busy = scheduler.threads.size();
+    scheduler.batch++;
+    SDL_CondBroadcast(scheduler.wake);
+    SDL_UnlockMutex(scheduler.lock);
+
+    drainTaskGraph(scheduler, 0);
+
+    SDL_LockMutex(scheduler.lock);
+    while(scheduler.busy > 0)
+        SDL_CondWait(scheduler.idle, scheduler.lock);
+    scheduler.graph = NULL;
+    SDL_UnlockMutex(scheduler.lock);
+}
+
+void stopTaskScheduler(Task_Scheduler &scheduler)
+{
+    if(scheduler.lock == NULL)
+        return;
+    SDL_LockMutex(scheduler.lock);
+    scheduler.quit = true;
+    SDL_CondBroadcast(scheduler.wake);
+    SDL_UnlockMutex(scheduler.lock);
+    for(std::size_t i = 0; i < scheduler.threads.size(); i++)
+        SDL_WaitThread(scheduler.threads[i], NULL);
+    scheduler.threads.clear();
+    scheduler.queues.clear();
+    scheduler.workers.clear();
+    SDL_DestroySemaphore(scheduler.ready);
+    SDL_DestroyCond(scheduler.wake);
+    SDL_DestroyCond(scheduler.idle);
+    SDL_DestroyMutex(scheduler.lock);
+    scheduler.lock = NULL;
+}
+#endif
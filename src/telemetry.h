@@ -0,0 +1,266 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+#include <SDL2/SDL.h>
+#include <string>
+#include <algorithm>
+#include <cstddef>
+#include <string.h>
+#if !defined(_WIN32)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+#include <errno.h>
+#define TELEMETRY_SHM 1
+#else
+#define TELEMETRY_SHM 0
+#endif
+
+//live stats for monitors outside the process. the main thread copies one fixed layout block into POSIX shared
+//memory after every presented frame, so a monitor never has to talk to the engine and the engine never waits on it.
+//the block is guarded by a sequence lock: the writer makes sequence odd, writes, then makes it even again. a reader
+//copies the block and keeps it only if sequence was the same even number before and after. see telemetry_reader.cpp
+const Uint32 telemetryMagic = 0x4d544352; //"RCTM"
+const Uint32 telemetryVersion = 1;
+const int telemetryHistogramBuckets = 64; //frame times, 1ms wide. the last bucket counts every slower frame too
+const int telemetryNameSize = 48;
+const char telemetryPrefix[] = "/raycaster-"; //default segment names are this plus the pid
+
+//where each frame's time went. render runs on the frame thread at the same time as the main thread stages
+enum TELEMETRY_STAGE{
+    STAGE_RENDER, //renderFrame on the frame thread, rays to fog
+    STAGE_WAIT, //main thread waiting for the frame thread to finish
+    STAGE_INPUT, //input and picking up the sim's ticks
+    STAGE_PRESENT, //upload, draw, present
+    STAGE_FRAME, //whole main loop iteration
+    TELEMETRY_STAGE_COUNT
+};
+
+//every field is naturally aligned and the layout never changes within a version, so any process that includes
+//this header can read it
+struct Telemetry_Block{
+    Uint32 magic;
+    Uint32 version;
+    Uint32 size; //sizeof(Telemetry_Block) of the writer
+    SDL_atomic_t sequence;
+    Uint64 pid;
+    Uint64 frame; //frames presented
+    Uint64 simTick;
+    double uptime; //seconds since the segment was opened
+    double fps; //smoothed over about a second
+    double stageMs[TELEMETRY_STAGE_COUNT]; //last frame
+    double stageAvgMs[TELEMETRY_STAGE_COUNT]; //smoothed like fps
+    Uint64 frameHistogram[telemetryHistogramBuckets]; //every frame since the start
+    Uint64 raySteps; //DDA cells stepped through for the last frame, over every column
+    Uint32 rayColumns; //columns of the last frame
+    Uint32 maxRaySteps; //longest single ray of the last frame
+    Uint32 sprites; //sprites in the level
+    Uint32 spritesDrawn; //sprites in front of the camera last frame
+    Sint32 mapWidth;
+    Sint32 mapHeight;
+    Uint32 levelsLoaded;
+    Uint32 flags; //TELEMETRY_FLAG bits
+    char mapName[telemetryNameSize]; //always nul terminated
+    double posX;
+    double posY;
+    double dirX;
+    double dirY;
+    double hFOV;
+    double vertLook;
+    double vertHeight;
+};
+
+enum TELEMETRY_FLAG{
+    TELEMETRY_FOG = 1,
+    TELEMETRY_CEILING = 2,
+    TELEMETRY_VSYNC = 4,
+    TELEMETRY_PALETTE = 8
+};
+
+struct Telemetry_Writer{
+    Telemetry_Block *block = NULL; //the shared segment, NULL when telemetry is off
+    Telemetry_Block values; //filled in by the engine, copied into block by publishTelemetry
+    std::string name;
+    Uint64 start = 0;
+};
+
+inline std::string telemetryDefaultName(Uint64 pid)
+{
+    return telemetryPrefix + std::to_string((unsigned long long)pid);
+}
+
+const Telemetry_Block *mapTelemetry(const std::string &name);
+void unmapTelemetry(const Telemetry_Block *block);
+void publishTelemetry(Telemetry_Writer &writer);
+
+//is the process that wrote a block still running. a pid we may not signal still exists
+inline bool telemetryWriterAlive(Uint64 pid)
+{
+#if TELEMETRY_SHM
+    return pid != 0 && (kill((pid_t)pid, 0) == 0 || errno == EPERM);
+#else
+    return false;
+#endif
+}
+
+//this process's pid, 0 where there's no shared memory
+inline Uint64 telemetryProcessId()
+{
+#if TELEMETRY_SHM
+    return (Uint64)getpid();
+#else
+    return 0;
+#endif
+}
+
+//a segment by this name left behind by an engine that has exited without unlinking it. anything else there,
+//a running engine or some other program's segment, isn't stale
+bool telemetryStale(const std::string &name)
+{
+    const Telemetry_Block *block = mapTelemetry(name);
+    if(block == NULL)
+        return false;
+    //a block with our own pid was left by an earlier process that had it. in a container the engine tends to get
+    //the same pid every run, and kill() would call that one alive
+    bool stale = block->magic == telemetryMagic && (block->pid == telemetryProcessId() || !telemetryWriterAlive(block->pid));
+    unmapTelemetry(block);
+    return stale;
+}
+
+//create and map the segment. false if shared memory isn't available or the name is taken by something else.
+//a segment of ours whose engine has exited is taken over
+bool openTelemetry(Telemetry_Writer &writer, const std::string &name)
+{
+#if TELEMETRY_SHM
+    int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    if(fd < 0 && errno == EEXIST && telemetryStale(name))
+    {
+        shm_unlink(name.c_str());
+        fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    }
+    if(fd < 0)
+        return false;
+    if(ftruncate(fd, sizeof(Telemetry_Block)) != 0)
+    {
+        close(fd);
+        shm_unlink(name.c_str());
+        return false;
+    }
+    void *mapped = mmap(NULL, sizeof(Telemetry_Block), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd); //the mapping keeps the segment alive
+    if(mapped == MAP_FAILED)
+    {
+        shm_unlink(name.c_str());
+        return false;
+    }
+    writer.block = (Telemetry_Block *)mapped;
+    writer.name = name;
+    writer.start = SDL_GetPerformanceCounter();
+    memset(&writer.values, 0, sizeof(writer.values));
+    writer.values.magic = telemetryMagic;
+    writer.values.version = telemetryVersion;
+    writer.values.size = sizeof(Telemetry_Block);
+    writer.values.pid = getpid();
+    memset(writer.block, 0, sizeof(Telemetry_Block));
+    SDL_AtomicSet(&writer.block->sequence, 0);
+    publishTelemetry(writer); //magic and pid go in right away, so the segment is never mistaken for a stale one
+    return true;
+#else
+    return false;
+#endif
+}
+
+//count one frame time into the histogram and the smoothed averages
+void telemetryFrameTime(Telemetry_Writer &writer, const double stageMs[TELEMETRY_STAGE_COUNT])
+{
+    Telemetry_Block &values = writer.values;
+    const double smoothing = values.frame == 0 ? 1.0 : 0.05;
+    for(int stage = 0; stage < TELEMETRY_STAGE_COUNT; stage++)
+    {
+        values.stageMs[stage] = stageMs[stage];
+        values.stageAvgMs[stage] += (stageMs[stage] - values.stageAvgMs[stage]) * smoothing;
+    }
+    int bucket = (int)stageMs[STAGE_FRAME];
+    values.frameHistogram[std::max(0, std::min(bucket, telemetryHistogramBuckets - 1))]++;
+    values.fps = values.stageAvgMs[STAGE_FRAME] > 0 ? 1000.0 / values.stageAvgMs[STAGE_FRAME] : 0;
+    values.frame++;
+}
+
+//copy values into the segment. only ever called from one thread
+void publishTelemetry(Telemetry_Writer &writer)
+{
+    if(writer.block == NULL)
+        return;
+    writer.values.uptime = (SDL_GetPerformanceCounter() - writer.start) / (double)SDL_GetPerformanceFrequency();
+    int sequence = SDL_AtomicGet(&writer.block->sequence);
+    SDL_AtomicSet(&writer.block->sequence, sequence + 1);
+    SDL_MemoryBarrierRelease();
+    //everything but the sequence itself
+    Telemetry_Block &block = *writer.block;
+    block.magic = writer.values.magic;
+    block.version = writer.values.version;
+    block.size = writer.values.size;
+    const std::size_t bodyStart = offsetof(Telemetry_Block, pid);
+    memcpy((char *)&block + bodyStart, (const char *)&writer.values + bodyStart, sizeof(Telemetry_Block) - bodyStart);
+    SDL_MemoryBarrierRelease();
+    SDL_AtomicSet(&writer.block->sequence, sequence + 2);
+}
+
+void closeTelemetry(Telemetry_Writer &writer)
+{
+#if TELEMETRY_SHM
+    if(writer.block == NULL)
+        return;
+    munmap(writer.block, sizeof(Telemetry_Block));
+    shm_unlink(writer.name.c_str());
+    writer.block = NULL;
+#endif
+}
+
+//reader side. maps the segment read only, NULL if there isn't one by that name or it isn't ours
+const Telemetry_Block *mapTelemetry(const std::string &name)
+{
+#if TELEMETRY_SHM
+    int fd = shm_open(name.c_str(), O_RDONLY, 0);
+    if(fd < 0)
+        return NULL;
+    struct stat info;
+    void *mapped = MAP_FAILED;
+    if(fstat(fd, &info) == 0 && info.st_size >= (off_t)sizeof(Telemetry_Block))
+        mapped = mmap(NULL, sizeof(Telemetry_Block), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    return mapped == MAP_FAILED ? NULL : (const Telemetry_Block *)mapped;
+#else
+    return NULL;
+#endif
+}
+
+void unmapTelemetry(const Telemetry_Block *block)
+{
+#if TELEMETRY_SHM
+    if(block != NULL)
+        munmap((void *)block, sizeof(Telemetry_Block));
+#endif
+}
+
+//consistent copy of a mapped block. false if the engine kept writing through every try or it's another layout
+bool readTelemetry(const Telemetry_Block *block, Telemetry_Block &copy)
+{
+    for(int attempt = 0; attempt < 100; attempt++)
+    {
+        int before = SDL_AtomicGet((SDL_atomic_t *)&block->sequence);
+        if(before & 1)
+        {
+            SDL_Delay(0);
+            continue;
+        }
+        SDL_MemoryBarrierAcquire();
+        memcpy(&copy, (const void *)block, sizeof(Telemetry_Block));
+        SDL_MemoryBarrierAcquire();
+        if(SDL_AtomicGet((SDL_atomic_t *)&block->sequence) == before)
+            return copy.magic == telemetryMagic && copy.version == telemetryVersion && copy.size == sizeof(Telemetry_Block);
+    }
+    return false;
+}
+#endif
@@ -0,0 +1,184 @@
+//reads the shared memory telemetry raycaster publishes when started with --telemetry. built on its own:
+//  g++ -O2 telemetry_reader.cpp -o telemetry_reader `sdl2-config --cflags --libs` -lrt
+//it only maps the segments read only, so any number of readers can watch without the engine noticing
+#define SDL_MAIN_HANDLED
+#include <SDL2/SDL.h>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <dirent.h>
+#include "telemetry.h"
+
+std::vector<std::string> findSegments(int &stale); //every live raycaster segment on this host. linux keeps them in /dev/shm
+std::string segmentName(const std::string &arg); //pid or name from the command line to a segment name
+void printSummary(const std::string &name, const Telemetry_Block &block); //one line per instance
+void printDetail(const std::string &name, const Telemetry_Block &block); //everything in the block
+void printScrape(const std::string &name, const Telemetry_Block &block); //prometheus text format
+double histogramPercentile(const Telemetry_Block &block, double percentile); //frame time in ms, from the buckets
+bool readSegment(const std::string &name, Telemetry_Block &block);
+
+int main(int argc, char **argv)
+{
+    std::vector<std::string> names;
+    bool scrape = false;
+    int watchMs = 0;
+    for(int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if(arg == "--scrape")
+            scrape = true;
+        else if(arg == "--watch")
+            watchMs = (i + 1 < argc && argv[i + 1][0] != '-') ? std::max(10, atoi(argv[++i])) : 1000;
+        else if(arg[0] != '-')
+            names.push_back(segmentName(arg));
+        else
+        {
+            printf("Usage: telemetry_reader [pid | name]... [--scrape] [--watch [ms]]\n");
+            printf("  no pid or name reads every raycaster instance on this host\n");
+            printf("  --scrape  prometheus text format instead of a table\n");
+            printf("  --watch   print again every ms, 1000 by default\n");
+            return 1;
+        }
+    }
+    const bool everyInstance = names.empty();
+    do
+    {
+        int stale = 0;
+        if(everyInstance)
+            names = findSegments(stale);
+        if(names.empty())
+            printf("No raycaster telemetry found. start the game with --telemetry\n");
+        if(stale > 0 && !scrape)
+            printf("%d stale segment%s left by instances that exited, skipped\n", stale, stale == 1 ? "" : "s");
+        for(std::size_t i = 0; i < names.size(); i++)
+        {
+            Telemetry_Block block;
+            if(!readSegment(names[i], block))
+            {
+                if(!everyInstance)
+                    printf("%s: no readable telemetry\n", names[i].c_str());
+                continue;
+            }
+            if(!everyInstance && !scrape && !telemetryWriterAlive(block.pid))
+                printf("%s: pid %llu has exited, this is what it last published\n", names[i].c_str(), (unsigned long long)block.pid);
+            if(scrape)
+                printScrape(names[i], block);
+            else if(everyInstance)
+                printSummary(names[i], block);
+            else
+                printDetail(names[i], block);
+        }
+        fflush(stdout);
+        if(watchMs > 0)
+            SDL_Delay(watchMs);
+    } while(watchMs > 0);
+    return 0;
+}
+
+std::vector<std::string> findSegments(int &stale)
+{
+    std::vector<std::string> names;
+    const std::string prefix = telemetryPrefix + 1; //without the leading slash
+    DIR *dir = opendir("/dev/shm");
+    if(dir == NULL)
+        return names;
+    while(dirent *entry = readdir(dir))
+    {
+        std::string file = entry->d_name;
+        if(file.compare(0, prefix.size(), prefix) != 0)
+            continue;
+        if(telemetryStale("/" + file))
+            stale++;
+        else
+            names.push_back("/" + file);
+    }
+    closedir(dir);
+    return names;
+}
+
+std::string segmentName(const std::string &arg)
+{
+    if(arg.find_first_not_of("0123456789") == std::string::npos)
+        return telemetryDefaultName(strtoull(arg.c_str(), NULL, 10));
+    return arg[0] == '/' ? arg : "/" + arg;
+}
+
+bool readSegment(const std::string &name, Telemetry_Block &block)
+{
+    const Telemetry_Block *mapped = mapTelemetry(name);
+    if(mapped == NULL)
+        return false;
+    bool read = readTelemetry(mapped, block);
+    unmapTelemetry(mapped);
+    return read;
+}
+
+double histogramPercentile(const Telemetry_Block &block, double percentile)
+{
+    Uint64 total = 0;
+    for(int i = 0; i < telemetryHistogramBuckets; i++)
+        total += block.frameHistogram[i];
+    if(total == 0)
+        return 0;
+    Uint64 seen = 0, wanted = (Uint64)(total * percentile);
+    for(int i = 0; i < telemetryHistogramBuckets; i++)
+    {
+        seen += block.frameHistogram[i];
+        if(seen > wanted)
+            return i + 1; //upper edge of the bucket
+    }
+    return telemetryHistogramBuckets;
+}
+
+void printSummary(const std::string &name, const Telemetry_Block &block)
+{
+    printf("%-20s pid %-7llu %7.1f fps  p99 %3.0fms  render %5.2fms  present %5.2fms  %-20s frame %llu\n", name.c_str(),
+           (unsigned long long)block.pid, block.fps, histogramPercentile(block, 0.99), block.stageAvgMs[STAGE_RENDER],
+           block.stageAvgMs[STAGE_PRESENT], block.mapName, (unsigned long long)block.frame);
+}
+
+void printDetail(const std::string &name, const Telemetry_Block &block)
+{
+    const char *stages[TELEMETRY_STAGE_COUNT] = {"render", "wait", "input", "present", "frame"};
+    printf("%s: pid %llu, up %.0fs, frame %llu, sim tick %llu\n", name.c_str(), (unsigned long long)block.pid, block.uptime,
+           (unsigned long long)block.frame, (unsigned long long)block.simTick);
+    printf("  fps %.1f, frame time p50 %.0fms p90 %.0fms p99 %.0fms\n", block.fps, histogramPercentile(block, 0.5),
+           histogramPercentile(block, 0.9), histogramPercentile(block, 0.99));
+    for(int stage = 0; stage < TELEMETRY_STAGE_COUNT; stage++)
+        printf("  %-8s %6.2fms last, %6.2fms average\n", stages[stage], block.stageMs[stage], block.stageAvgMs[stage]);
+    printf("  rays: %u columns, %llu cells stepped, %.1f per column, longest %u\n", block.rayColumns, (unsigned long long)block.raySteps,
+           block.rayColumns > 0 ? (double)block.raySteps / block.rayColumns : 0.0, block.maxRaySteps);
+    printf("  sprites: %u drawn of %u\n", block.spritesDrawn, block.sprites);
+    printf("  map: %s, %dx%d, level %u%s%s%s%s\n", block.mapName, block.mapWidth, block.mapHeight, block.levelsLoaded,
+           block.flags & TELEMETRY_FOG ? ", fog" : "", block.flags & TELEMETRY_CEILING ? ", ceiling" : "",
+           block.flags & TELEMETRY_VSYNC ? ", vsync" : "", block.flags & TELEMETRY_PALETTE ? ", palette" : "");
+    printf("  camera: pos %.2f %.2f, dir %.3f %.3f, hFOV %.1f, look %.1f, height %.2f\n", block.posX, block.posY, block.dirX, block.dirY,
+           block.hFOV, block.vertLook, block.vertHeight);
+}
+
+void printScrape(const std::string &name, const Telemetry_Block &block)
+{
+    const char *stages[TELEMETRY_STAGE_COUNT] = {"render", "wait", "input", "present", "frame"};
+    std::string labels = "{segment=\"" + name + "\",pid=\"" + std::to_string((unsigned long long)block.pid) + "\"";
+    printf("raycaster_frames_total%s} %llu\n", labels.c_str(), (unsigned long long)block.frame);
+    printf("raycaster_uptime_seconds%s} %.3f\n", labels.c_str(), block.uptime);
+    printf("raycaster_fps%s} %.3f\n", labels.c_str(), block.fps);
+    for(int stage = 0; stage < TELEMETRY_STAGE_COUNT; stage++)
+        printf("raycaster_stage_ms%s,stage=\"%s\"} %.4f\n", labels.c_str(), stages[stage], block.stageAvgMs[stage]);
+    Uint64 count = 0;
+    for(int i = 0; i < telemetryHistogramBuckets; i++)
+    {
+        count += block.frameHistogram[i];
+        if(i < telemetryHistogramBuckets - 1)
+            printf("raycaster_frame_ms_bucket%s,le=\"%d\"} %llu\n", labels.c_str(), i + 1, (unsigned long long)count);
+    }
+    printf("raycaster_frame_ms_bucket%s,le=\"+Inf\"} %llu\n", labels.c_str(), (unsigned long long)count);
+    printf("raycaster_ray_steps%s} %llu\n", labels.c_str(), (unsigned long long)block.raySteps);
+    printf("raycaster_ray_steps_max%s} %u\n", labels.c_str(), block.maxRaySteps);
+    printf("raycaster_sprites%s} %u\n", labels.c_str(), block.sprites);
+    printf("raycaster_sprites_drawn%s} %u\n", labels.c_str(), block.spritesDrawn);
+    printf("raycaster_levels_loaded%s} %u\n", labels.c_str(), block.levelsLoaded);
+    printf("raycaster_camera%s,map=\"%s\",axis=\"x\"} %.3f\n", labels.c_str(), block.mapName, block.posX);
+    printf("raycaster_camera%s,map=\"%s\",axis=\"y\"} %.3f\n", labels.c_str(), block.mapName, block.posY);
+}
@@ -0,0 +1,192 @@
+#ifndef TEXEL_STORE_H
+#define TEXEL_STORE_H
+#include <SDL2/SDL.h>
+#include <vector>
+#include <algorithm>
+#include "memory_stats.h"
+
+//engine owned copies of image pixels, RGBA32. filled once when an image is loaded so the render loops
+//never have to lock or query an SDL texture. each image is laid out for the way it gets sampled
+//RGBA32 is R,G,B,A in memory, so where alpha lands in a Uint32 depends on byte order
+#if SDL_BYTEORDER == SDL_BIG_ENDIAN
+const Uint32 texelAlphaMask = 0x000000FF;
+#else
+const Uint32 texelAlphaMask = 0xFF000000;
+#endif
+
+enum TEXEL_LAYOUT{
+    TEXELS_ROWS, //plain row major. sprites
+    TEXELS_COLUMNS, //column major. walls are sampled one vertical column at a time
+    TEXELS_MORTON //z-order. floor and ceiling rows sweep across the texture at any angle
+};
+
+struct Texel_Image{
+    int w = 0;
+    int h = 0;
+    int layout = TEXELS_ROWS;
+    std::vector<Uint32> texels;
+    std::vector<Uint8> indices; //palette index of each texel, only filled for the 8 bit path. see palette.h
+    //texel (x,y) lives at texels[xIndex[x] + yIndex[y]] whatever the layout
+    std::vector<Uint32> xIndex;
+    std::vector<Uint32> yIndex;
+};
+
+//an image and its mip chain. levels[0] is full size, each level after is half the size of the one before
+//(rounded down, never below 1) down to 1x1. every level keeps the layout of the full size image
+struct Texel_Mips{
+    std::vector<Texel_Image> levels;
+};
+
+Uint64 texelBytes(const Texel_Image &image)
+{
+    return vectorBytes(image.texels) + vectorBytes(image.indices) + vectorBytes(image.xIndex) + vectorBytes(image.yIndex);
+}
+
+Uint64 texelBytes(const Texel_Mips &mips)
+{
+    Uint64 bytes = vectorBytes(mips.levels);
+    for(std::size_t i = 0; i < mips.levels.size(); i++)
+        bytes += texelBytes(mips.levels[i]);
+    return bytes;
+}
+
+bool isPowerOfTwo(int n)
+{
+    return n > 0 && (n & (n - 1)) == 0;
+}
+
+void buildTexelIndex(Texel_Image &image)
+{
+    image.xIndex.resize(image.w);
+    image.yIndex.resize(image.h);
+    if(image.layout == TEXELS_MORTON && !(isPowerOfTwo(image.w) && isPowerOfTwo(image.h)))
+        image.layout = TEXELS_ROWS; //z-order needs power of two sides
+
+    if(image.layout == TEXELS_COLUMNS)
+    {
+        for(int x = 0; x < image.w; x++)
+            image.xIndex[x] = x * image.h;
+        for(int y = 0; y < image.h; y++)
+            image.yIndex[y] = y;
+    }
+    else if(image.layout == TEXELS_MORTON)
+    {
+        //interleave the low bits of x and y. whichever side is longer keeps its extra high bits on top
+        int bits = 0;
+        while((1 << (bits + 1)) <= std::min(image.w, image.h))
+            bits++;
+        for(int x = 0; x < image.w; x++)
+        {
+            Uint32 index = 0;
+            for(int b = 0; b < bits; b++)
+                index |= ((x >> b) & 1) << (2 * b);
+            index |= (x >> bits) << (2 * bits);
+            image.xIndex[x] = index;
+        }
+        for(int y = 0; y < image.h; y++)
+        {
+            Uint32 index = 0;
+            for(int b = 0; b < bits; b++)
+                index |= ((y >> b) & 1) << (2 * b + 1);
+            index |= (y >> bits) << (2 * bits);
+            image.yIndex[y] = index;
+        }
+    }
+    else
+    {
+        for(int x = 0; x < image.w; x++)
+            image.xIndex[x] = x;
+        for(int y = 0; y < image.h; y++)
+            image.yIndex[y] = y * image.w;
+    }
+}
+
+//copy an RGBA32 surface into the store. colorKey pixels get alpha 0 when useKey is set
+void storeTexels(Texel_Image &image, SDL_Surface *surface, int layout, bool useKey = false, Uint32 colorKey = 0)
+{
+    image.w = surface->w;
+    image.h = surface->h;
+    image.layout = layout;
+    buildTexelIndex(image);
+    image.texels.resize(image.w * image.h);
+
+    SDL_LockSurface(surface);
+    for(int y = 0; y < image.h; y++)
+    {
+        const Uint32 *row = (const Uint32 *)((const Uint8 *)surface->pixels + y * surface->pitch);
+        for(int x = 0; x < image.w; x++)
+        {
+            Uint32 color = row[x];
+            if(useKey && (color & ~texelAlphaMask) == (colorKey & ~texelAlphaMask))
+                color &= ~texelAlphaMask;
+            image.texels[image.xIndex[x] + image.yIndex[y]] = color;
+        }
+    }
+    SDL_UnlockSurface(surface);
+}
+
+inline Uint32 texelAt(const Texel_Image &image, int x, int y)
+{
+    return image.texels[image.xIndex[x] + image.yIndex[y]];
+}
+
+//start of one texture column, only valid for TEXELS_COLUMNS images
+inline const Uint32 *texelColumn(const Texel_Image &image, int x)
+{
+    return &image.texels[image.xIndex[x]];
+}
+
+//box filter each level down from the one above it
+void buildMips(Texel_Mips &mips, const Texel_Image &base)
+{
+    mips.levels.assign(1, base);
+    while(mips.levels.back().w > 1 || mips.levels.back().h > 1)
+    {
+        const Texel_Image &src = mips.levels.back();
+        Texel_Image next;
+        next.w = std::max(1, src.w / 2);
+        next.h = std::max(1, src.h / 2);
+        next.layout = src.layout;
+        buildTexelIndex(next);
+        next.texels.resize(next.w * next.h);
+        for(int y = 0; y < next.h; y++)
+        {
+            int y0 = std::min(y * 2, src.h - 1), y1 = std::min(y * 2 + 1, src.h - 1);
+            for(int x = 0; x < next.w; x++)
+            {
+                int x0 = std::min(x * 2, src.w - 1), x1 = std::min(x * 2 + 1, src.w - 1);
+                Uint32 quad[4] = {texelAt(src, x0, y0), texelAt(src, x1, y0), texelAt(src, x0, y1), texelAt(src, x1, y1)};
+                //average each byte on its own so it doesn't matter which one is alpha
+                Uint32 color = 0;
+                for(int shift = 0; shift < 32; shift += 8)
+                {
+                    Uint32 sum = 0;
+                    for(int i = 0; i < 4; i++)
+                        sum += (quad[i] >> shift) & 0xFF;
+                    color |= ((sum + 2) / 4) << shift;
+                }
+                next.texels[next.xIndex[x] + next.yIndex[y]] = color;
+            }
+        }
+        mips.levels.push_back(next);
+    }
+}
+
+//pick the level where one texel step covers about one screen pixel. texelsPerPixel is measured on the full size image
+inline int mipLevel(const Texel_Mips &mips, double texelsPerPixel)
+{
+    int level = 0;
+    while(texelsPerPixel >= 2.0 && level + 1 < (int)mips.levels.size())
+    {
+        texelsPerPixel *= 0.5;
+        level++;
+    }
+    return level;
+}
+
+//half brightness, alpha untouched
+inline Uint32 texelDarken(Uint32 color)
+{
+    return ((color >> 1) & (0x7F7F7F7F & ~texelAlphaMask)) | (color & texelAlphaMask);
+}
+#endif
@@ -0,0 +1,122 @@
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+#include <SDL2/SDL.h>
+#include <vector>
+
+//fixed set of worker threads that run one job per index. the calling thread works too, and run
+//only returns when every index is finished
+struct Worker_Pool{
+    std::vector<SDL_Thread *> threads;
+    SDL_mutex *lock = NULL;
+    SDL_cond *wake = NULL; //a new batch of jobs is ready, or quit
+    SDL_cond *idle = NULL; //a worker finished its part of a batch
+    void (*job)(void *data, int index) = NULL;
+    void *data = NULL;
+    int jobCount = 0;
+    SDL_atomic_t nextJob;
+    int busy = 0; //workers still inside the current batch
+    Uint64 batch = 0; //bumped for every run so workers know there's new work
+    bool quit = false;
+};
+
+void workerPoolDrain(Worker_Pool &pool)
+{
+    int index;
+    while((index = SDL_AtomicAdd(&pool.nextJob, 1)) < pool.jobCount)
+        pool.job(pool.data, index);
+}
+
+int workerPoolThread(void *data)
+{
+    Worker_Pool &pool = *(Worker_Pool *)data;
+    Uint64 seen = 0;
+    SDL_LockMutex(pool.lock);
+    while(true)
+    {
+        while(!pool.quit && pool.batch == seen)
+            SDL_CondWait(pool.wake, pool.lock);
+        if(pool.quit)
+            break;
+        seen = pool.batch;
+        SDL_UnlockMutex(pool.lock);
+        workerPoolDrain(pool);
+        SDL_LockMutex(pool.lock);
+        pool.busy--;
+        SDL_CondSignal(pool.idle);
+    }
+    SDL_UnlockMutex(pool.lock);
+    return 0;
+}
+
+void startWorkerPool(Worker_Pool &pool, int threadCount)
+{
+    pool.lock = SDL_CreateMutex();
+    pool.wake = SDL_CreateCond();
+    pool.idle = SDL_CreateCond();
+    SDL_AtomicSet(&pool.nextJob, 0);
+    for(int i = 1; i < threadCount; i++) //the thread calling runWorkerPool or finishWorkerPool is the last worker
+    {
+        SDL_Thread *thread = SDL_CreateThread(workerPoolThread, "worker", &pool);
+        if(thread != NULL)
+            pool.threads.push_back(thread);
+    }
+}
+
+//hand a batch to the workers and return straight away, for callers with something else to do meanwhile.
+//finishWorkerPool must be called before the next batch. without worker threads nothing runs until then
+void beginWorkerPool(Worker_Pool &pool, void (*job)(void *data, int index), void *data, int jobCount)
+{
+    SDL_LockMutex(pool.lock);
+    pool.job = job;
+    pool.data = data;
+    pool.jobCount = jobCount;
+    SDL_AtomicSet(&pool.nextJob, 0);
+    pool.busy = pool.threads.size();
+    pool.batch++;
+    SDL_CondBroadcast(pool.wake);
+    SDL_UnlockMutex(pool.lock);
+}
+
+//true once every worker thread is done with the batch. always true without worker threads
+bool workerPoolIdle(Worker_Pool &pool)
+{
+    SDL_LockMutex(pool.lock);
+    bool idle = pool.busy == 0;
+    SDL_UnlockMutex(pool.lock);
+    return idle;
+}
+
+//work through whatever is left of the batch, then wait for the workers to finish theirs
+void finishWorkerPool(Worker_Pool &pool)
+{
+    workerPoolDrain(pool);
+
+    SDL_LockMutex(pool.lock);
+    while(pool.busy > 0)
+        SDL_CondWait(pool.idle, pool.lock);
+    SDL_UnlockMutex(pool.lock);
+}
+
+void runWorkerPool(Worker_Pool &pool, void (*job)(void *data, int index), void *data, int jobCount)
+{
+    beginWorkerPool(pool, job, data, jobCount);
+    finishWorkerPool(pool);
+}
+
+void stopWorkerPool(Worker_Pool &pool)
+{
+    if(pool.lock == NULL)
+        return;
+    SDL_LockMutex(pool.lock);
+    pool.quit = true;
+    SDL_CondBroadcast(pool.wake);
+    SDL_UnlockMutex(pool.lock);
+    for(std::size_t i = 0; i < pool.threads.size(); i++)
+        SDL_WaitThread(pool.threads[i], NULL);
+    pool.threads.clear();
+    SDL_DestroyCond(pool.wake);
+    SDL_DestroyCond(pool.idle);
+    SDL_DestroyMutex(pool.lock);
+    pool.lock = NULL;
+}
+#endif
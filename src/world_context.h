@@ -0,0 +1,56 @@
+#ifndef WORLD_CONTEXT_H
+#define WORLD_CONTEXT_H
+#include <SDL2/SDL.h>
+#include <vector>
+#include "sim_state.h"
+#include "frame_slot.h"
+#include "world_snapshot.h"
+#include "worker_pool.h"
+
+//many independent worlds in one process, for running agents. each world carries everything that changes while
+//it's stepped, its own frame buffers and the snapshot it resets to. textures, block types and settings stay shared
+//and read only, so any number of worlds can be stepped and rendered on different threads at once
+struct World_Context{
+    Sim_World world;
+    World_Snapshot start; //what the world resets to
+    Frame_Slot frame; //observation render buffers
+    double hFOV = 90.0;
+    bool ceilingOn = true; //observations have no sky behind them, so the ceiling stays on by default
+    Uint64 steps = 0; //steps since the last reset
+    bool done = false; //the last step reached an exit. the world has already been reset
+};
+
+struct World_Batch{
+    std::vector<World_Context> worlds;
+    int obsWidth = 0;
+    int obsHeight = 0;
+    std::vector<Uint32> observations; //RGBA32, world i starts at i * obsWidth * obsHeight
+    std::vector<Sim_Input> actions; //one per world, read by the next step
+    int ticksPerStep = 4; //sim ticks each action is held for
+    //optional aux outputs, laid out like observations at auxWidth x auxHeight per world. only requested channels are allocated
+    int auxChannels = 0; //AUX_CHANNEL bits
+    int auxScale = 1;
+    int auxWidth = 0;
+    int auxHeight = 0;
+    std::vector<float> columnDepth; //auxWidth per world
+    std::vector<float> depth;
+    std::vector<Uint32> surface;
+    std::vector<Uint32> spriteIds;
+    Worker_Pool pool;
+};
+
+//put a world back to its start snapshot. only the doors of the level need copying back
+void resetWorldContext(World_Context &context)
+{
+    const World_Snapshot &start = context.start;
+    restoreDoors(*start.geometry, start.doors, context.world.level);
+    context.world.cam = start.cam;
+    context.world.sprites = start.sprites;
+    attachChasers(context.world.chasers, context.world.sprites);
+    resetFlowField(context.world.flow, 0, 0);
+    context.world.changedDoors.clear();
+    context.world.exitRequested = false;
+    context.hFOV = start.hFOV;
+    context.steps = 0;
+}
+#endif
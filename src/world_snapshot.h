@@ -0,0 +1,62 @@
+#ifndef WORLD_SNAPSHOT_H
+#define WORLD_SNAPSHOT_H
+#include <SDL2/SDL.h>
+#include <vector>
+#include <memory>
+#include "blocktypes.h"
+#include "game_sprites.h"
+#include "sim_state.h"
+
+//in memory copy of the whole world so a session can be reset without going back to the map file.
+//doors are the only blocks that change during play, so the level itself is captured once and shared
+//by every snapshot of it, and each snapshot only keeps its own copy of the door blocks
+
+//a level as it was loaded. never modified once built, snapshots hold it through a shared_ptr
+struct Level_Geometry{
+    std::vector<std::vector<Map_Block>> blocks;
+    int width = 0;
+    int height = 0;
+    std::vector<int> doorCells; //x + y * width of every door block
+};
+
+struct World_Snapshot{
+    std::shared_ptr<const Level_Geometry> geometry;
+    std::vector<Map_Block> doors; //state of each geometry->doorCells block, same order
+    Camera_State cam;
+    double hFOV = 90.0;
+    std::vector<Game_Sprite> sprites;
+    bool fogOn = false;
+    double worldFog = 0.0;
+    double playerFog = 1.0;
+    double fogMultiplier = 1.0;
+    SDL_Color fogColor = {0,0,0,0};
+    bool ceilingOn = false;
+};
+
+std::shared_ptr<const Level_Geometry> buildLevelGeometry(const std::vector<std::vector<Map_Block>> &level, int width, int height)
+{
+    std::shared_ptr<Level_Geometry> geometry = std::make_shared<Level_Geometry>();
+    geometry->blocks = level;
+    geometry->width = width;
+    geometry->height = height;
+    for(int y = 0; y < height; y++)
+        for(int x = 0; x < width; x++)
+            if(level[x][y].isDoor)
+                geometry->doorCells.push_back(x + y * width);
+    return geometry;
+}
+
+void saveDoors(const Level_Geometry &geometry, const std::vector<std::vector<Map_Block>> &level, std::vector<Map_Block> &doors)
+{
+    doors.resize(geometry.doorCells.size());
+    for(std::size_t i = 0; i < doors.size(); i++)
+        doors[i] = level[geometry.doorCells[i] % geometry.width][geometry.doorCells[i] / geometry.width];
+}
+
+//level must already match geometry everywhere except the doors
+void restoreDoors(const Level_Geometry &geometry, const std::vector<Map_Block> &doors, std::vector<std::vector<Map_Block>> &level)
+{
+    for(std::size_t i = 0; i < doors.size(); i++)
+        level[geometry.doorCells[i] % geometry.width][geometry.doorCells[i] / geometry.width] = doors[i];
+}
+#endif